@@ -18,6 +18,16 @@ struct Options {
 	bool MEXflag = true; // Macros expanded
 	bool SEXflag = true; // Structured expanded
 	bool WARflag = true; // Show Warnings
+	bool PIPEflag = false; // Pipelined read / lex / assemble
+	bool RELAXflag = false; // Branch relaxation
+	bool EAOPTflag = false; // Effective address size optimization
+	bool PEEPflag = false; // Peephole optimizer
+	bool CHAINflag = false; // Structured branch chain collapsing
+	bool LOOPflag = false; // Structured loops tested at the bottom
+	bool UNROLLflag = false; // FOR loops with constant bounds unrolled
+	bool CYCLEflag = false; // Clock cycles listed
+	bool HOTflag = false; // Costliest loops and subroutines listed
+	bool ADVISEflag = false; // Performance advice listed
 
 	// editor ops
 	// font
@@ -0,0 +1,15 @@
+#ifndef ADVISE_H_
+#define ADVISE_H_
+
+#include <cstdio>
+#include "asm.h"
+
+int adviseStart();
+int advisePass();
+int adviseOperand(opDescriptor*);
+int adviseInst(int, int, const unsigned char*, int);
+int adviseLine();
+int adviseSummary();
+int adviseList(FILE*);
+
+#endif
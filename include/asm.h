@@ -68,6 +68,11 @@ const int NO_DBLOOP = 0x415;
 const int DBLOOP_EXPECTED = 0x416;
 const int BAD_BITFIELD = 0x417;
 const int ILLEGAL_SYMBOL = 0x418;
+const int NO_UNROLL = 0x419;
+const int ENDU_EXPECTED = 0x41A;
+const int NO_ENDR = 0x41B;
+const int ENDR_EXPECTED = 0x41C;
+const int CIRCULAR_EQU = 0x41D;
 
 const int EXCEPTION = 0x999;
 
@@ -97,6 +102,7 @@ const int REG_LIST_SPEC = 0x20B;
 const int INV_SHIFT_COUNT = 0x20C;
 const int INV_OPERATOR = 0x20D;
 const int FAIL_ERROR = 0x20E;        // user defined
+const int INV_UNROLL_BUDGET = 0x20F;
 
 /* Warnings */
 const int WARNING = 0x100;
@@ -122,6 +128,11 @@ const int SEVERITY = 0xF00;
 // ck: the previous line was causing errors when placed inside if-else
 #define NEWERROR(var, code)      var = ((code & SEVERITY) > var) ? code : var
 
+/* Tokenizer definitions */
+
+const int MAXT = 128;           // maximum number of tokens
+const int MAX_SIZE = 512;       // maximun size of input line
+
 /* Symbol table definitions */
 
 const int SIGCHARS = 33;        // significant characters in symbol
@@ -174,7 +185,7 @@ typedef struct {
 
 /* Structure for the instruction table */
 typedef struct {
-	char *mnemonic; /* Mnemonic */
+	const char *mnemonic; /* Mnemonic */
 	flavor *flavorPtr; /* Pointer to flavor list */
 	char flavorCount; /* Number of flavors in flavor list */
 	bool parseFlag; /* Should assemble() parse the operands? */
@@ -9,9 +9,13 @@ char *skipSpace(char *);
 int processFile(void);
 int assemble(char *, int*);
 int createCode(char *, int*);
+bool instStart(char*, char*, int*);
+int instCode(instruction*, char, char*, char*, char*, int*);
+int instBuild(instruction*, char, opDescriptor*, opDescriptor*, int*);
 char* fieldParse(char *p, opDescriptor *d, int *errorPtr);
 int pickMask(int, flavor*, int*);
-int tokenize(char *, char*, char*[], char*);
+int tokenize(char *, const char*, char*[], char*);
+int tokenizeEnds(char *, const char*, char*[], char*, char*[]);
 
 
 #endif
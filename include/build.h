@@ -29,6 +29,7 @@ int twoReg(int, int, opDescriptor*, opDescriptor*, int*);
 int oneReg(int, int, opDescriptor*, opDescriptor*, int*);
 int moveUSP(int, int, opDescriptor*, opDescriptor*, int*);
 int link_ins(int, int, opDescriptor*, opDescriptor*, int*);
+int instSize(flavor*, int, int, opDescriptor*, opDescriptor*);
 
 
 #endif
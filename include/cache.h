@@ -0,0 +1,16 @@
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include "asm.h"
+
+int cacheStart(int);
+int cacheClear();
+bool cacheReplay(char*, int*);
+int cacheBuild(flavor*, int, int, opDescriptor*, opDescriptor*, int*);
+bool cacheWord(int, int);
+bool cacheBadMode();
+int cacheNoReplay();
+int cacheUse(const char*);
+int cacheEncode();
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef CHAIN_H_
+#define CHAIN_H_
+
+#include <cstdio>
+#include <string>
+#include "asm.h"
+
+int chainStart();
+int chainPass();
+int chainDefine(const char*, int);
+int chainFlow(flavor*, int);
+std::string chainTarget(const std::string&, const std::string&);
+int chainBranch(const std::string&, const std::string&);
+bool chainNext(bool);
+int chainList(FILE*);
+
+#endif
@@ -6,5 +6,6 @@
 int output(int, int);
 int effAddr(opDescriptor*);
 int extWords(opDescriptor*, int, int*);
+int extSize(opDescriptor*, int);
 
 #endif
@@ -0,0 +1,16 @@
+#ifndef CYCLES_H_
+#define CYCLES_H_
+
+#include <cstdio>
+
+int cycleStart();
+int cyclePass();
+int cycleLine();
+int cycleCode();
+int cycleWord(int, int);
+int cycleLabel(const char*, int);
+const char* cycleField(bool);
+int cycleList(FILE*);
+int cycleCount(const unsigned char*, int, int*);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef DEPEND_H_
+#define DEPEND_H_
+
+const char DEP_LOC[] = "*";     // name used for the location counter
+
+int depClear();
+int depBeginLine();
+int depEndLine(int);
+int depDefine(const char*);
+int depUse(const char*, bool);
+int depUseLoc();
+int depObject(int, int, int);
+int depInstruction();
+int depDirective(const char*);
+int depInclude(const char*);
+int depFinish(const char*);
+bool depAssemble(const char*);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef DISASM_H_
+#define DISASM_H_
+
+#include <cstdio>
+#include "asm.h"
+
+const int DISASM_TEXT = 80;     // longest instruction text, with the null
+
+int disasmStart();
+int disasmInst(const unsigned char*, int, int, char*);
+int disasmModes(const unsigned char*, int, const flavor**, int*, int*, int*);
+int disasmImage(FILE*, const unsigned char*, int, int);
+int disasmSRec(char*, FILE*);
+
+#endif
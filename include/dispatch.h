@@ -0,0 +1,10 @@
+#ifndef DISPATCH_H_
+#define DISPATCH_H_
+
+#include "asm.h"
+
+int dispatchDest(instruction*);
+int dispatchSource(instruction*, int);
+int dispatchBoth(instruction*, int, int);
+
+#endif
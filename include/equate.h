@@ -0,0 +1,15 @@
+#ifndef EQUATE_H_
+#define EQUATE_H_
+
+#include "asm.h"
+
+int equStart();
+int equPass();
+bool equRecord(char*, char*, char*, bool);
+bool equLazy(char*, int*);
+symbolDef* equResolve(char*);
+bool equBackRef(char*, symbolDef*);
+int equRefuse();
+bool equNext(bool);
+
+#endif
@@ -5,5 +5,6 @@ char* eval(char*, int*, bool*, int*);
 char* evalNumber(char*, int*, bool*, int*);
 int precedence(char);
 int doOp(int, int, char, int*);
+int evalStart();
 
 #endif
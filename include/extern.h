@@ -38,8 +38,9 @@ const int32_t LINE_LENGTH = 256;
 #include <string>
 #include <stack>
 #include <vector>
+#include "structured.h"
 extern std::stack<int, std::vector<int> > stcStack;
 extern std::stack<char, std::vector<char> > dbStack;
-extern std::stack<std::string, std::vector<std::string> > forStack;
+extern std::stack<stcInst, std::vector<stcInst> > forStack;
 
 #endif /* EXTERN_H_ */
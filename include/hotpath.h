@@ -0,0 +1,13 @@
+#ifndef HOTPATH_H_
+#define HOTPATH_H_
+
+#include <cstdio>
+
+int hotStart();
+int hotPass();
+int hotInst(int, const unsigned char*, int, int, int, bool);
+int hotLabel(const char*, int);
+int hotTrips(long long);
+int hotList(FILE*);
+
+#endif
@@ -3,5 +3,8 @@
 
 int macro(int, char*, char*, int*);
 int asmMacro(int, char*, char*, int*);
+bool macroRead(char*);
+int macroStart();
+int macroPass();
 
 #endif
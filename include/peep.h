@@ -0,0 +1,13 @@
+#ifndef PEEP_H_
+#define PEEP_H_
+
+#include <cstdio>
+#include "asm.h"
+
+int peepStart();
+int peepPass();
+bool peepBuild(flavor*, int, int, opDescriptor*, opDescriptor*, int*);
+bool peepNext(bool);
+int peepList(FILE*);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+#include <cstdio>
+#include "asm.h"
+
+/* Line classes found by the pipeline lexer */
+const int LEX_OTHER = 0;        // label, instruction or directive
+const int LEX_COMMENT = 1;      // comment line
+const int LEX_COND = 2;         // conditional assembly directive
+
+/* A source line after strcap() and tokenizeEnds() */
+struct lexLine {
+	char line[256];               // source line
+	char capLine[256];            // line from strcap()
+	char tokens[MAX_SIZE];        // tokens from tokenizeEnds()
+	short tokOff[MAXT];           // token offsets in tokens, -1 if empty
+	short endOff[MAXT];           // token end offsets in capLine, -1 if none
+	int lexClass;                 // LEX_OTHER, LEX_COMMENT or LEX_COND
+	bool eof;
+};
+
+int pipeStart(FILE*);
+int pipeStop();
+bool pipeRead(char*);
+bool pipeDirect();
+bool pipeLexed(char*, char*, int*);
+void pipeLex(lexLine*);
+int pipeReplay(const lexLine*);
+int pipeClass(const char*);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef RELAX_H_
+#define RELAX_H_
+
+#include <cstdio>
+#include "asm.h"
+
+int relaxStart();
+int relaxPass();
+int relaxLine();
+int relaxDefine(const char*, int);
+bool relaxValue(const char*, int*);
+bool relaxBranch(int);
+int relaxOperands(flavor*, opDescriptor*, opDescriptor*, int*);
+bool relaxNext(bool);
+int relaxForget();
+int relaxList(FILE*);
+
+#endif
@@ -8,11 +8,26 @@
 #include <cctype>
 #include <cstring>
 
+#include <vector>
+
+// A line of structured code: a label, or an instruction with its size
+// and operands as they are written in the source. size is the size
+// code and the tab after it, ".B\t", or "\t" if there is none.
+struct stcInst {
+	std::string label;
+	std::string mnemonic;
+	std::string size;
+	std::string source;
+	std::string dest;
+};
+
 std::string getBcc(std::string cc, int mode, int orx);
 
-void outCmpBcc(char *size, char *op1, char *cc, char *op2, char *op3,
-		std::string label, int &error);
-void assembleStc(const char *line);
+void outCmpBcc(char *token[], char *last, std::string label, int &error,
+		int orx = -1, std::vector<stcInst> *code = NULL);
+stcInst stcOp(const std::string &mnemonic, const std::string &size,
+		const std::string &source, const std::string &dest = "");
+void assembleStc(const stcInst &inst);
 std::string IntToHex(uint32_t value, int length);
 int asmStructure(int, char*, char*, int*);
 
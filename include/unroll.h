@@ -0,0 +1,21 @@
+#ifndef UNROLL_H_
+#define UNROLL_H_
+
+const int UNROLL_MACRO = 1;       // unrollEnter() readers
+const int UNROLL_INCLUDE = 2;
+
+int unrollStart();
+int unrollPass();
+bool unrollCount(char *[], int, long long&);
+bool unrollFor(char *[], int, int*);
+int unrollBlock(char *[], int, int*);
+bool unrollRead(char*);
+bool unrollActive();
+int unrollEnter(int);
+int unrollLeave();
+int rept(int, char*, char*, int*);
+int irp(int, char*, char*, int*);
+int irpc(int, char*, char*, int*);
+int endr(int, char*, char*, int*);
+
+#endif
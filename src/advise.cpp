@@ -0,0 +1,375 @@
+/***********************************************************************
+ *
+ *		ADVISE.CPP
+ *		Performance Advice for 68000 Assembler
+ *
+ *    Function: adviseInst()
+ *		With OPT ADVISE, cycleFlush() passes each instruction
+ *		output in pass 2 to this function, which looks for
+ *		slower forms than needed:
+ *
+ *		 MULU #2^n,Dn          SWAP Dn, CLR.W Dn, SWAP Dn, LSL.L #n,Dn
+ *		 DIVU #2^n,Dn          LSR.L #n,Dn  (if the remainder is not used)
+ *		 MOVE.L #n,Dn          MOVEQ #n,Dn  (-128 <= n <= 127)
+ *		 ADDI/SUBI #n,<ea>     ADDQ/SUBQ #n,<ea>  (1 <= n <= 8)
+ *		 ADD/SUB #n,Dn         ADDQ/SUBQ #n,Dn  (1 <= n <= 8)
+ *		 CLR <mem>             MOVE Dn,<mem>  (Dn holding 0)
+ *		 LSL/ASL #1,Dn         ADD Dn,Dn
+ *
+ *		and for a word or long operand at an odd absolute
+ *		address, which the 68000 takes as an address error. As
+ *		DC and DS align word and long data, this is usually a
+ *		label on byte data used as a word or long. The words of
+ *		the faster form are timed by cycleCount() to give the
+ *		clock cycles saved. The instructions looked at are the
+ *		ones output, and a rewrite by OPT PEEP is not flagged
+ *		again.
+ *
+ *		build.cpp already picks MOVEQ, ADDQ and SUBQ for an
+ *		immediate known when the instruction is built, and
+ *		#n.L asks for the long form, so these forms are only
+ *		advised for an immediate that is a forward reference.
+ *		adviseOperand() is called by cacheBuild() for every
+ *		instruction built in pass 2 and notes the address of
+ *		the ones whose immediate source is.
+ *
+ *		adviseLine()
+ *		Called by assemble() and assembleStc() after
+ *		cycleLine(). Writes the advice on the code of the line
+ *		above to the listing, after it. Only the first
+ *		ADVISE_LIMIT of each kind are written, and shown in the
+ *		message window with the line number as errors are.
+ *
+ *		adviseSummary()
+ *		Called at the end of pass 2. Shows the number of
+ *		instructions flagged and the cycles they would save in
+ *		the message window.
+ *
+ *		adviseList()
+ *		Writes the number of each kind of advice and the
+ *		cycles it would save to the listing.
+ *
+ ************************************************************************/
+
+#include <cstdio>
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+#include "../include/asm.h"
+#include "../include/LogCtrl.h"
+#include "../include/cycles.h"
+#include "../include/disasm.h"
+#include "../include/listing.h"
+#include "../include/advise.h"
+
+extern bool pass2;
+extern thread_local int loc;
+extern bool ADVISEflag;         // true lists faster forms of instructions
+extern LogCtrl *logWindow;      // message window
+
+const int ADVISE_LIMIT = 5;       // advice of each kind listed
+
+const int ADVISE_MULU = 0;        // kinds of advice
+const int ADVISE_DIVU = 1;
+const int ADVISE_MOVEQ = 2;
+const int ADVISE_QUICK = 3;
+const int ADVISE_CLR = 4;
+const int ADVISE_SHIFT = 5;
+const int ADVISE_ODD = 6;
+const int ADVISE_KINDS = 7;
+
+static const char *adviseText[ADVISE_KINDS] = {
+	"MULU #2^n,Dn -> SWAP, CLR.W, SWAP, LSL.L #n,Dn",
+	"DIVU #2^n,Dn -> LSR.L #n,Dn if the remainder is not used",
+	"MOVE.L #n,Dn -> MOVEQ #n,Dn",
+	"ADD/SUB #n -> ADDQ/SUBQ #n",
+	"CLR <mem> -> MOVE Dn,<mem> from a register holding 0",
+	"LSL/ASL #1,Dn -> ADD Dn,Dn",
+	"Word or long operand at an odd address (address error)" };
+
+static int adviseCount[ADVISE_KINDS];        // advice of each kind in pass 2
+static int adviseCycles[ADVISE_KINDS];       //   and the cycles it saves
+static std::vector<std::string> adviseQueue; // advice not yet listed
+static std::set<int> adviseForward;          // instructions with a forward #n
+static bool adviseFlag;                      // ADVISEflag at start of assembly
+
+//------------------------------------------------------------
+// Called at the start of an assembly
+int adviseStart() {
+	adviseFlag = ADVISEflag;
+	return (NORMAL);
+}
+
+// Called at the start of each pass
+int advisePass() {
+	ADVISEflag = adviseFlag;
+	for (int k = 0; k < ADVISE_KINDS; k++)
+		adviseCount[k] = adviseCycles[k] = 0;
+	adviseQueue.clear();
+	adviseForward.clear();
+	return (NORMAL);
+}
+
+// Show text in the message window
+static void adviseMessage(const char *text) {
+	if (logWindow)
+		logWindow->logMsg(text);
+}
+
+// Big endian word at code
+static int adviseWord(const unsigned char *code) {
+	return ((code[0] << 8) | code[1]);
+}
+
+// Put a word at code
+static void advisePut(unsigned char *code, int word) {
+	code[0] = (word >> 8) & 0xFF;
+	code[1] = word & 0xFF;
+}
+
+// Most clock cycles of the words of faster, or 0 if they have no timing
+static int adviseTime(const unsigned char *code, int length) {
+	int pos = 0;
+	int total = 0;
+	int cycles;
+	int n;
+
+	while (pos < length) {
+		cycles = cycleCount(code + pos, length - pos, &n);
+		if (cycles < 0)
+			return (0);
+		total += cycles;
+		pos += n;
+	}
+	return (total);
+}
+
+// Note advice of kind on source line with the cycles saved by replacing
+// the instruction at code by faster
+static int adviseNote(int kind, int line, const unsigned char *code,
+		int length, const unsigned char *faster, int fastLength) {
+	char text[128];
+	char message[160];
+	int before;
+	int after;
+	int saved = 0;
+
+	if (faster) {
+		before = adviseTime(code, length);
+		after = adviseTime(faster, fastLength);
+		if (!before || !after || after >= before)
+			return (NORMAL);
+		saved = before - after;
+	}
+	adviseCount[kind]++;
+	adviseCycles[kind] += saved;
+	if (adviseCount[kind] > ADVISE_LIMIT)
+		return (NORMAL);
+	if (faster)
+		sprintf(text, "ADVICE: %s saves %d clock cycles", adviseText[kind], saved);
+	else
+		sprintf(text, "ADVICE: %s", adviseText[kind]);
+	sprintf(message, "Line %d %s", line, text);
+	adviseMessage(message);
+	adviseQueue.push_back(std::string(text) + "\n");
+	return (NORMAL);
+}
+
+// Returns n if value is 2^n with 1 <= n <= 8, otherwise 0
+static int advisePower(int value) {
+	for (int n = 1; n <= 8; n++)
+		if (value == (1 << n))
+			return (n);
+	return (0);
+}
+
+// true if the word or long operand of the instruction at code is at an
+// odd absolute address
+static bool adviseOdd(const unsigned char *code, int length) {
+	const flavor *flavorPtr;
+	int size;
+	int source;
+	int dest;
+	int word = adviseWord(code);
+
+	if ((word & 0xFB80) == 0x4880 || (word & 0xF1C0) == 0x41C0
+			|| (word & 0xFFC0) == 0x4840 || (word & 0xFF80) == 0x4E80)
+		return (false);                   // MOVEM, LEA, PEA, JMP and JSR
+	disasmModes(code, length, &flavorPtr, &size, &source, &dest);
+	if (!flavorPtr || (size != WORD_SIZE && size != LONG_SIZE))
+		return (false);
+	if ((source & AbsShort) && length >= 4 && (code[3] & 1))
+		return (true);                    // extension of the source is first
+	if ((source & AbsLong) && length >= 6 && (code[5] & 1))
+		return (true);
+	return ((dest & (AbsShort | AbsLong)) && (code[length - 1] & 1));
+}
+
+//------------------------------------------------------------
+// Called by cacheBuild() for each instruction built in pass 2
+int adviseOperand(opDescriptor *source) {
+	if (pass2 && ADVISEflag && source->mode == IMMEDIATE && !source->backRef)
+		adviseForward.insert(loc);
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Called by cycleFlush() for each instruction output in pass 2 at addr
+// from source line
+int adviseInst(int addr, int line, const unsigned char *code, int length) {
+	unsigned char faster[16];
+	int word;
+	int reg;
+	int size;
+	int n;
+
+	if (!pass2 || !ADVISEflag || length < 2 || length > 10)
+		return (NORMAL);
+	word = adviseWord(code);
+	reg = (word >> 9) & 7;
+	size = (word >> 6) & 3;               // 0 byte, 1 word, 2 long
+
+	// MULU #2^n,Dn
+	if ((word & 0xF1FF) == 0xC0FC && length == 4
+			&& (n = advisePower(adviseWord(code + 2))) != 0) {
+		advisePut(faster, 0x4840 | reg);    // SWAP Dn
+		advisePut(faster + 2, 0x4240 | reg);  // CLR.W Dn
+		advisePut(faster + 4, 0x4840 | reg);  // SWAP Dn
+		advisePut(faster + 6, 0xE188 | ((n & 7) << 9) | reg); // LSL.L #n,Dn
+		return (adviseNote(ADVISE_MULU, line, code, length, faster, 8));
+	}
+
+	// DIVU #2^n,Dn
+	if ((word & 0xF1FF) == 0x80FC && length == 4
+			&& (n = advisePower(adviseWord(code + 2))) != 0) {
+		advisePut(faster, 0xE088 | ((n & 7) << 9) | reg); // LSR.L #n,Dn
+		return (adviseNote(ADVISE_DIVU, line, code, length, faster, 2));
+	}
+
+	// MOVE.L #n,Dn
+	if ((word & 0xF1FF) == 0x203C && length == 6 && adviseForward.count(addr)
+			&& code[2] == code[3]
+			&& (code[2] == 0x00 || code[2] == 0xFF) && code[3] == code[4]
+			&& ((code[5] ^ code[2]) & 0x80) == 0) {  // n sign extended from a byte
+		advisePut(faster, 0x7000 | (reg << 9) | code[5]); // MOVEQ #n,Dn
+		return (adviseNote(ADVISE_MOVEQ, line, code, length, faster, 2));
+	}
+
+	// ADDI/SUBI #n,<ea>
+	if (((word & 0xFF00) == 0x0600 || (word & 0xFF00) == 0x0400) && size != 3
+			&& adviseForward.count(addr)) {
+		int bytes = (size == 2) ? 4 : 2;    // immediate
+		n = (length < 2 + bytes) ? 0 :
+				(size == 2) ? (adviseWord(code + 2) << 16) | adviseWord(code + 4) :
+				(size == 1) ? adviseWord(code + 2) : code[3];
+		if (n >= 1 && n <= 8) {
+			advisePut(faster, 0x5000 | ((n & 7) << 9) | ((word & 0x0200) ? 0 : 0x0100)
+					| (word & 0x00FF));       // ADDQ/SUBQ #n,<ea>
+			for (int i = 2 + bytes; i < length; i++)
+				faster[i - bytes] = code[i];
+			return (adviseNote(ADVISE_QUICK, line, code, length, faster, length - bytes));
+		}
+	}
+
+	// ADD/SUB #n,Dn
+	if (((word & 0xF000) == 0xD000 || (word & 0xF000) == 0x9000)
+			&& (word & 0x013F) == 0x003C && size != 3
+			&& adviseForward.count(addr)) {
+		n = (size == 2 && length == 6) ? (adviseWord(code + 2) << 16) | adviseWord(code + 4) :
+				(size == 1 && length == 4) ? adviseWord(code + 2) :
+				(size == 0 && length == 4) ? code[3] : 0;
+		if (n >= 1 && n <= 8) {
+			advisePut(faster, 0x5000 | ((n & 7) << 9) | ((word & 0x4000) ? 0 : 0x0100)
+					| (size << 6) | reg);      // ADDQ/SUBQ #n,Dn
+			return (adviseNote(ADVISE_QUICK, line, code, length, faster, 2));
+		}
+	}
+
+	// CLR <mem>
+	if ((word & 0xFF00) == 0x4200 && size != 3 && (word & 0x0038) >= 0x0010) {
+		advisePut(faster, (((size == 0) ? 1 : (size == 1) ? 3 : 2) << 12)
+				| ((word & 7) << 9) | ((word & 0x0038) << 3)); // MOVE Dn,<mem>
+		for (int i = 2; i < length; i++)
+			faster[i] = code[i];
+		return (adviseNote(ADVISE_CLR, line, code, length, faster, length));
+	}
+
+	// LSL/ASL #1,Dn
+	if (((word & 0xFF38) == 0xE308 || (word & 0xFF38) == 0xE300) && size != 3) {
+		advisePut(faster, 0xD000 | ((word & 7) << 9) | (size << 6) | (word & 7));
+		return (adviseNote(ADVISE_SHIFT, line, code, length, faster, 2));  // ADD Dn,Dn
+	}
+
+	if (adviseOdd(code, length))
+		return (adviseNote(ADVISE_ODD, line, code, length, NULL, 0));
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Called after cycleLine(). Lists the advice on the line above.
+int adviseLine() {
+	if (!pass2)
+		return (NORMAL);
+	for (size_t i = 0; i < adviseQueue.size(); i++)
+		listText(adviseQueue[i].c_str());
+	adviseQueue.clear();
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Called at the end of pass 2. Shows the advice given in the message
+// window.
+int adviseSummary() {
+	char message[160];
+	int count = 0;
+	int shown = 0;
+	int cycles = 0;
+
+	for (int k = 0; k < ADVISE_KINDS; k++) {
+		count += adviseCount[k];
+		shown += std::min(adviseCount[k], ADVISE_LIMIT);
+		cycles += adviseCycles[k];
+	}
+	if (!count)
+		return (NORMAL);
+	sprintf(message, "Advice: %d instruction%s flagged, %d clock cycles could be saved",
+			count, (count != 1) ? "s" : "", cycles);
+	adviseMessage(message);
+	if (count > shown) {
+		sprintf(message, "Advice: %d more not shown, see the listing",
+				count - shown);
+		adviseMessage(message);
+	}
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Write the advice of each kind to the listing file
+int adviseList(FILE *listFile) {
+	int count = 0;
+	int cycles = 0;
+
+	for (size_t i = 0; i < adviseQueue.size(); i++)
+		fputs(adviseQueue[i].c_str(), listFile);
+	adviseQueue.clear();
+	for (int k = 0; k < ADVISE_KINDS; k++) {
+		count += adviseCount[k];
+		cycles += adviseCycles[k];
+	}
+	if (!ADVISEflag && !count)
+		return (NORMAL);
+	fprintf(listFile, "Advice: %d instruction%s flagged, %d clock cycles could be saved\n",
+			count, (count != 1) ? "s" : "", cycles);
+	if (!count)
+		return (NORMAL);
+	fprintf(listFile, "\n\nPERFORMANCE ADVICE INFORMATION\n");
+	fprintf(listFile, "Count  Listed  Cycles  Advice\n");
+	fprintf(listFile, "-----------------------------------------------\n");
+	for (int k = 0; k < ADVISE_KINDS; k++)
+		if (adviseCount[k])
+			fprintf(listFile, "%5d  %6d  %6d  %s\n", adviseCount[k],
+					std::min(adviseCount[k], ADVISE_LIMIT), adviseCycles[k],
+					adviseText[k]);
+	return (NORMAL);
+}
@@ -9,7 +9,8 @@
  *		assembled. The routine also makes sure that errors are
  *		printed on the screen and listed in the listing file
  *		and keeps track of the error counts and the line
- *		number.
+ *		number. OPT PEEP, CHAIN and RELAX and forward EQUs may
+ *		repeat pass 1, up to PASS1_REPEATS times in all.
  *
  *		assemble()
  *		Assembles one line of assembly code. The line argument
@@ -22,12 +23,24 @@
  *		this search is successful and the parseFlag for that
  *		instruction is TRUE, it defines the label and parses
  *		the source and destination operands of the instruction
- *		(if appropriate) and searches the flavor list for the
- *		instruction, calling the proper routine if a match is
- *		found. If parseFlag is FALSE, it passes pointers to the
+ *		(if appropriate) and looks up the flavor for the
+ *		addressing modes with dispatchSource() and
+ *		dispatchBoth(), calling the proper routine if a match
+ *		is found. If parseFlag is FALSE, it passes pointers to the
  *		label and operands to the specified routine for
  *		processing.
  *
+ *		instCode()
+ *		Builds an instruction once its instruction table entry
+ *		and size are known. It is the part of createCode() that
+ *		follows the table lookup.
+ *
+ *		instStart(), instBuild()
+ *		The two halves of instCode() around the parsing of the
+ *		operands. assembleStc() calls them for the instructions
+ *		of structured code, whose table entry, size and operands
+ *		are known without a source line to look them up in.
+ *
  *	 Usage: processFile()
  *
  *		assemble(line, errorPtr)
@@ -82,18 +95,31 @@
 #include "../include/asm.h"
 #include "../include/assemble.h"
 #include "../include/build.h"
+#include "../include/cache.h"
+#include "../include/chain.h"
+#include "../include/cycles.h"
+#include "../include/hotpath.h"
+#include "../include/advise.h"
+#include "../include/unroll.h"
+#include "../include/depend.h"
+#include "../include/dispatch.h"
 #include "../include/error.h"
 #include "../include/eval.h"
 #include "../include/instlook.h"
 #include "../include/opparse.h"
+#include "../include/pipeline.h"
+#include "../include/peep.h"
+#include "../include/relax.h"
 #include "../include/listing.h"
+#include "../include/macro.h"
+#include "../include/equate.h"
 #include "../include/object.h"
 #include "../include/symbol.h"
 
-extern int loc;		// The assembler's location counter
+extern thread_local int loc;		// The assembler's location counter
 extern int sectionLoc[16];     // section locations
 extern int sectI;              // current section
-extern int offsetMode;         // True when processing Offset directive
+extern bool offsetMode;        // True when processing Offset directive
 extern bool showEqual;         // true to display equal after address in listing
 extern char pass;		// pass counter
 extern bool pass2;		// Flag set during second pass
@@ -139,18 +165,18 @@ extern unsigned int stcLabelW;  // structured while label number
 extern unsigned int stcLabelR;  // structured repeat label number
 extern unsigned int stcLabelF;  // structured for label number
 extern unsigned int stcLabelD;  // structured dbloop label number
+extern bool LOOPflag;           // true tests structured loops at the bottom
 
 bool skipList;                  // true to skip listing line
 bool skipCond;                  // true conditionally skips lines
 bool printCond;                 // true to print condition on listing line
 bool skipCreateCode;  // true to skip calling createCode during macro processing
 
-const int MAXT = 128;           // maximum number of tokens
-const int MAX_SIZE = 512;       // maximun size of input line
 char *token[MAXT];              // pointers to tokens
 char tokens[MAX_SIZE];          // place tokens here
 char *tokenEnd[MAXT];           // where tokens end in source line
 int nestLevel = 0;              // nesting level of conditional directives
+const int PASS1_REPEATS = 16;   // most pass 1 runs after the first
 
 extern bool mapROM;             // memory map flags
 extern bool mapRead;
@@ -166,6 +192,13 @@ int assembleFile(const char *fileName, const char *tempName, const char *workNam
 //	int i;
 
 	try {
+		// if only plain instruction lines changed since the last assembly
+		// of this file, re-encode just those lines
+		if (depAssemble(fileName))
+			return (NORMAL);
+		clearSymbols();               // clear symbols from last assembly
+		depClear();
+
 		tmpFile = fopen(tempName, "w+");
 		if (!tmpFile) {
 //			wxMessageBox(wxT("Error creating temp file."), wxT("Error"));
@@ -195,6 +228,7 @@ int assembleFile(const char *fileName, const char *tempName, const char *workNam
 
 		// Assemble the file
 		processFile();
+		cacheClear();
 
 		// Close files and print error and warning counts
 		fclose(inFile);
@@ -203,7 +237,8 @@ int assembleFile(const char *fileName, const char *tempName, const char *workNam
 		if (objFlag)
 			finishObj();
 
-		clearSymbols();               //ck clear symbol table memory
+		// symbols are kept until the next assembly for depAssemble()
+		depFinish(fileName);
 
 		// clear stacks used in structured assembly
 		while (stcStack.empty() == false)
@@ -278,6 +313,9 @@ char* skipSpace(char *p) {
 // does 2 passes from here
 int processFile() {
 	int error;
+	bool loopFlag = LOOPflag;     // OPT LOOP at start of assembly
+	int repeats = 0;              // pass 1 runs after the first
+	bool last;
 
 	try {
 		offsetMode = false;         // clear flags
@@ -290,6 +328,16 @@ int processFile() {
 		mapRead = false;
 		mapProtected = false;
 		mapInvalid = false;
+		relaxStart();               // branch sizes for OPT RELAX
+		peepStart();                // rewrites for OPT PEEP
+		chainStart();               // structured branches for OPT CHAIN
+		unrollStart();              // OPT UNROLL
+		macroStart();               // macro expansions kept for later calls
+		evalStart();                // compiled expressions
+		equStart();                 // EQU dependency graph
+		cycleStart();               // OPT CYCLES
+		hotStart();                 // OPT HOT
+		adviseStart();              // OPT ADVISE
 
 		for (pass = 0; pass < 2; pass++) {
 			globalLabel[0] = '\0';    // for local labels
@@ -300,10 +348,21 @@ int processFile() {
 			stcLabelF = 0x20000000;   // structured for label number
 			stcLabelR = 0x30000000;   // structured repeat label number
 			stcLabelD = 0x40000000;   // structured dbloop label number
+			LOOPflag = loopFlag;      // OPT LOOP applies to the same loops in every pass
 			includeNestLevel = 0;     // count nested include directives
 			includeFile[0] = '\0';    // name of current include file
 
 			loc = 0;
+			cacheStart(pass);         // pass 1 encodings replayed in pass 2
+			relaxPass();
+			peepPass();
+			chainPass();
+			unrollPass();
+			macroPass();
+			equPass();
+			cyclePass();
+			hotPass();
+			advisePass();
 			for (int i = 0; i < 16; i++)  // clear section locations
 				sectionLoc[i] = 0;
 			sectI = 0;                // current section
@@ -313,18 +372,43 @@ int processFile() {
 			endFlag = false;
 			errorCount = warningCount = 0;
 			skipCond = false;  // true conditionally skips lines in code
-			while (!endFlag && fgets(line, 256, inFile)) {
+			pipeStart(inFile);        // if PIPEflag read and lex on other threads
+			while (!endFlag && pipeRead(line)) {
 				error = OK;
 				continuation = false;
 				skipList = false;
 				printCond = false; // true to print condition on listing line
 				skipCreateCode = false;
 
+				if (pass2)
+					depBeginLine();           // record line dependencies
 				assemble(line, &error);     // assemble one line of code
+				if (pass2)
+					depEndLine(error);
 
 				lineNum++;
 			}
-			if (!pass2) {
+			last = (repeats >= PASS1_REPEATS); // pass 2 follows this pass 1
+			if (!pass2 && peepNext(last)) { // if OPT PEEP made an instruction longer
+				relaxForget();
+				clearSymbols();         // repeat pass 1 with the new sizes
+				repeats++;
+				pass--;
+			} else if (!pass2 && chainNext(last)) { // if OPT CHAIN changed structured branches
+				relaxForget();
+				clearSymbols();         // repeat pass 1 with the new branches
+				repeats++;
+				pass--;
+			} else if (!pass2 && relaxNext(last)) { // if OPT RELAX shortened a branch
+				clearSymbols();         // repeat pass 1 with the new sizes
+				repeats++;
+				pass--;
+			} else if (!pass2 && equNext(last)) { // if a directive needs an EQU defined below
+				clearSymbols();         // repeat pass 1 with the EQUs found
+				repeats++;
+				pass--;
+			} else if (!pass2) {
+				cacheEncode();          // encode resolved instructions
 				pass2 = true;
 				//    ************************************************************
 				//    ********************  STARTING PASS 2  *********************
@@ -335,10 +419,13 @@ int processFile() {
 					warningCount++;
 					printError(listFile, error, lineNum);
 				}
+				adviseSummary();        // OPT ADVISE in the message window
 			}
+			pipeStop();
 			rewind(inFile);
 		}
 	} catch (...) {
+		pipeStop();
 		sprintf(buffer, "ERROR: An exception occurred in routine 'processFile'. \n");
 		printError(NULL, EXCEPTION, 0);
 		return (0);
@@ -355,16 +442,34 @@ int assemble(char *line, int *errorPtr) {
 	char capLine[256];
 	char *p;
 	bool comment;                   // true when line is comment
+	int lexClass;                   // line class from the pipeline lexer
 	try {
+		cycleLine();                  // OPT CYCLES times the code of this line
+		adviseLine();                 // OPT ADVISE on the code of the line above
+		// a line skipped by conditional assembly is only looked at for
+		// IFxx and ENDC
+		if (skipCond && !printCond && *errorPtr == OK) {
+			lexClass = pipeClass(line);
+			if (lexClass == LEX_COMMENT && pass2 && listFlag) {
+				listLoc();
+				listLine(line, lineIdent);
+			}
+			if (lexClass != LEX_COND)
+				return (NORMAL);
+		}
 		if (pass2 && listFlag)
 			listLoc();
-		strcap(capLine, line);
-		p = skipSpace(capLine);      // skip leading white space
-		tokenize(capLine, ", \t\n", token, tokens); // tokenize line
-		if (*p == '*' || *p == ';')         // if comment
-			comment = true;
-		else
-			comment = false;
+		if (pipeLexed(line, capLine, &lexClass)) { // if already lexed
+			comment = (lexClass == LEX_COMMENT);
+		} else {
+			strcap(capLine, line);
+			p = skipSpace(capLine);      // skip leading white space
+			tokenize(capLine, ", \t\n", token, tokens); // tokenize line
+			if (*p == '*' || *p == ';')         // if comment
+				comment = true;
+			else
+				comment = false;
+		}
 
 		if (comment)                                // if comment
 			if (pass2 && listFlag) {
@@ -564,17 +669,10 @@ int assemble(char *line, int *errorPtr) {
 // create machine code for instruction
 int createCode(char *capLine, int *errorPtr) {
 	instruction *tablePtr;
-	flavor *flavorPtr;
-	opDescriptor source;
-	opDescriptor dest;
 	char *p;
 	char *start;
 	char label[SIGCHARS + 1];
 	char size;
-	char f;
-	bool sourceParsed;
-	bool destParsed;
-	unsigned short mask;
 	unsigned short i;
 
 	p = start = skipSpace(capLine);  // skip leading spaces and tabs
@@ -612,91 +710,9 @@ int createCode(char *capLine, int *errorPtr) {
 			return (NORMAL);
 		p = skipSpace(p);
 		if (tablePtr->parseFlag) {
-			// Move location counter to a word boundary and fix
-			//   the listing before assembling an instruction
-			if (loc & 1) {
-				loc++;
-				listLoc();
-			}
-			if (*label)
-				define(label, loc, pass2, true, errorPtr);
-			if (*errorPtr > SEVERE)
-				return (NORMAL);
-			sourceParsed = destParsed = false;
-			flavorPtr = tablePtr->flavorPtr;
-			for (f = 0; (f < tablePtr->flavorCount); f++, flavorPtr++) {
-				if (!sourceParsed && flavorPtr->source) {
-					p = opParse(p, &source, errorPtr);   // parse source
-					if (*errorPtr > SEVERE)
-						return (NORMAL);
-
-					if (flavorPtr && flavorPtr->exec == bitField) { // if bitField instruction
-						p = skipSpace(p); // skip spaces after source operand
-						if (*p != ',') { // if not Dn,addr{offset:width}
-							p = fieldParse(p, &source, errorPtr); // parse {offset:width}
-							if (*errorPtr > SEVERE)
-								return (NORMAL);
-						}
-					}
-					sourceParsed = true;
-				}
-				if (!destParsed && flavorPtr->dest) { // if destination needs parsing
-					p = skipSpace(p); // skip spaces after source operand
-					if (*p != ',') {
-						NEWERROR(*errorPtr, COMMA_EXPECTED);
-						return (NORMAL);
-					}
-					p++;                   // skip over comma
-					p = skipSpace(p); // skip spaces before destination operand
-					p = opParse(p, &dest, errorPtr); // parse destination
-					if (*errorPtr > SEVERE)
-						return (NORMAL);
-
-					if (flavorPtr && flavorPtr->exec == bitField && flavorPtr->source == DnDirect) // if bitField instruction Dn,addr{offset:width}
-							{
-						p = skipSpace(p); // skip spaces after destination operand
-						if (*p != '{') {
-							NEWERROR(*errorPtr, BAD_BITFIELD);
-							return (NORMAL);
-						}
-						p = fieldParse(p, &dest, errorPtr);
-						if (*errorPtr > SEVERE)
-							return (NORMAL);
-					}
-
-					if (!isspace(*p) && *p) { // if next character is not whitespace
-						NEWERROR(*errorPtr, SYNTAX);
-						return (NORMAL);
-					}
-					destParsed = true;
-				}
-				if (!flavorPtr->source) {
-					mask = pickMask(size, flavorPtr, errorPtr);
-					// The following line calls the function defined for the current
-					// instruction as a flavor in instTable[]
-					(*flavorPtr->exec)(mask, size, &source, &dest, errorPtr);
-					return (NORMAL);
-				} else if ((source.mode & flavorPtr->source) && !flavorPtr->dest) {
-					if (*p != '{' && !isspace(*p) && *p) {
-						NEWERROR(*errorPtr, SYNTAX);
-						return (NORMAL);
-					}
-					mask = pickMask(size, flavorPtr, errorPtr);
-					// The following line calls the function defined for the current
-					// instruction as a flavor in instTable[]
-					(*flavorPtr->exec)(mask, size, &source, &dest, errorPtr);
-					return (NORMAL);
-				} else if (source.mode & flavorPtr->source && (dest.mode & flavorPtr->dest)) {
-					mask = pickMask(size, flavorPtr, errorPtr);
-					// The following line calls the function defined for the current
-					// instruction as a flavor in instTable[]
-
-					(*flavorPtr->exec)(mask, size, &source, &dest, errorPtr);
-					return (NORMAL);
-				}
-			}
-			NEWERROR(*errorPtr, INV_ADDR_MODE);
+			return (instCode(tablePtr, size, label, p, capLine, errorPtr));
 		} else {
+			depDirective(tablePtr->mnemonic);
 			// The following line calls the function defined for the current
 			// instruction as a flavor in instTable[]
 			(*tablePtr->exec)(size, label, p, errorPtr);
@@ -706,6 +722,143 @@ int createCode(char *capLine, int *errorPtr) {
 	return (NORMAL);
 }
 
+//-------------------------------------------------------
+// start an instruction: align it, define its label and replay it from
+// the code cache. capLine is the whole line for the code cache.
+// Returns true if there is nothing left to build.
+bool instStart(char *label, char *capLine, int *errorPtr) {
+	depInstruction();
+	// Move location counter to a word boundary and fix
+	//   the listing before assembling an instruction
+	if (loc & 1) {
+		loc++;
+		listLoc();
+	}
+	if (*label)
+		define(label, loc, pass2, true, errorPtr);
+	if (*errorPtr > SEVERE)
+		return (true);
+	cycleCode();                    // OPT CYCLES times the words output
+	if (cacheReplay(capLine, errorPtr)) // if encoded in pass 1
+		return (true);
+	relaxLine();
+	return (false);
+}
+
+//-------------------------------------------------------
+// build an instruction found in the instruction table. p points to the
+// operands, capLine is the whole line for the code cache.
+int instCode(instruction *tablePtr, char size, char *label, char *p,
+		char *capLine, int *errorPtr) {
+	flavor *flavorPtr;
+	opDescriptor source;
+	opDescriptor dest;
+	int f;
+	int destAt;
+	int sourceMode;
+	unsigned short mask;
+
+	if (instStart(label, capLine, errorPtr))
+		return (NORMAL);
+	sourceMode = 0;
+	flavorPtr = tablePtr->flavorPtr;
+	if (tablePtr->flavorCount && flavorPtr->source) {
+		p = opParse(p, &source, errorPtr);   // parse source
+		if (*errorPtr > SEVERE)
+			return (NORMAL);
+
+		if (flavorPtr->exec == bitField) { // if bitField instruction
+			p = skipSpace(p); // skip spaces after source operand
+			if (*p != ',') { // if not Dn,addr{offset:width}
+				p = fieldParse(p, &source, errorPtr); // parse {offset:width}
+				if (*errorPtr > SEVERE)
+					return (NORMAL);
+			}
+		}
+		sourceMode = source.mode;
+	}
+	// flavor that matches before the destination is needed
+	f = dispatchSource(tablePtr, sourceMode);
+	destAt = dispatchDest(tablePtr);
+	if (f < 0 && destAt < tablePtr->flavorCount) { // if destination needs parsing
+		flavorPtr = tablePtr->flavorPtr + destAt;
+		p = skipSpace(p); // skip spaces after source operand
+		if (*p != ',') {
+			NEWERROR(*errorPtr, COMMA_EXPECTED);
+			return (NORMAL);
+		}
+		p++;                   // skip over comma
+		p = skipSpace(p); // skip spaces before destination operand
+		p = opParse(p, &dest, errorPtr); // parse destination
+		if (*errorPtr > SEVERE)
+			return (NORMAL);
+
+		if (flavorPtr->exec == bitField && flavorPtr->source == DnDirect) // if bitField instruction Dn,addr{offset:width}
+				{
+			p = skipSpace(p); // skip spaces after destination operand
+			if (*p != '{') {
+				NEWERROR(*errorPtr, BAD_BITFIELD);
+				return (NORMAL);
+			}
+			p = fieldParse(p, &dest, errorPtr);
+			if (*errorPtr > SEVERE)
+				return (NORMAL);
+		}
+
+		if (!isspace(*p) && *p) { // if next character is not whitespace
+			NEWERROR(*errorPtr, SYNTAX);
+			return (NORMAL);
+		}
+		f = dispatchBoth(tablePtr, sourceMode, dest.mode);
+	}
+	if (f < 0) {
+		NEWERROR(*errorPtr, INV_ADDR_MODE);
+		return (NORMAL);
+	}
+	flavorPtr = tablePtr->flavorPtr + f;
+	if (flavorPtr->source && !flavorPtr->dest && *p != '{' && !isspace(*p)
+			&& *p) {
+		NEWERROR(*errorPtr, SYNTAX);
+		return (NORMAL);
+	}
+	mask = pickMask(size, flavorPtr, errorPtr);
+	// The following line calls the function defined for the current
+	// instruction as a flavor in instTable[]
+	cacheBuild(flavorPtr, mask, size, &source, &dest, errorPtr);
+	return (NORMAL);
+}
+
+//-------------------------------------------------------
+// build an instruction from operands that are already parsed, after
+// instStart(). dest is NULL if the instruction has one operand.
+int instBuild(instruction *tablePtr, char size, opDescriptor *source,
+		opDescriptor *dest, int *errorPtr) {
+	flavor *flavorPtr;
+	opDescriptor none = { };
+	int f;
+	unsigned short mask;
+
+	f = dispatchSource(tablePtr, source->mode);
+	if (f < 0 && dest)
+		f = dispatchBoth(tablePtr, source->mode, dest->mode);
+	else if (f < 0 && dispatchDest(tablePtr) < tablePtr->flavorCount) {
+		NEWERROR(*errorPtr, COMMA_EXPECTED);
+		return (NORMAL);
+	}
+	if (f < 0) {
+		NEWERROR(*errorPtr, INV_ADDR_MODE);
+		return (NORMAL);
+	}
+	flavorPtr = tablePtr->flavorPtr + f;
+	if (dest && !flavorPtr->dest) {
+		NEWERROR(*errorPtr, SYNTAX);
+		return (NORMAL);
+	}
+	mask = pickMask(size, flavorPtr, errorPtr);
+	cacheBuild(flavorPtr, mask, size, source, dest ? dest : &none, errorPtr);
+	return (NORMAL);
+}
+
 //-------------------------------------------------------
 // parse {offset:width}
 char* fieldParse(char *p, opDescriptor *d, int *errorPtr) {
@@ -813,7 +966,13 @@ int pickMask(int size, flavor *flavorPtr, int *errorPtr) {
 //      token[] = pointers to tokens
 //      tokens = new string full of tokens
 // Returns number of tokens extracted.
-int tokenize(char *instr, char *delim, char *token[], char *tokens) {
+int tokenize(char *instr, const char *delim, char *token[], char *tokens) {
+	return (tokenizeEnds(instr, delim, token, tokens, tokenEnd));
+}
+
+// Same as tokenize() but saves the token end positions in ends[]
+// instead of tokenEnd[]. Safe to call from the pipeline lexer thread.
+int tokenizeEnds(char *instr, const char *delim, char *token[], char *tokens, char *ends[]) {
 	int i;
 	int size;
 	int tokN = 0;
@@ -827,7 +986,7 @@ int tokenize(char *instr, char *delim, char *token[], char *tokens) {
 	// clear token pointers
 	for (i = 0; i < MAXT; i++) {
 		token[i] = empty;       // this makes the pointer point to empty
-		tokenEnd[i] = NULL;         // clear positions
+		ends[i] = NULL;             // clear positions
 	}
 
 	start = instr;
@@ -865,7 +1024,7 @@ int tokenize(char *instr, char *delim, char *token[], char *tokens) {
 			}
 
 			tokens[size++] = '\0';                    // terminate
-			tokenEnd[tokN] = instr; // save token end position in source line
+			ends[tokN] = instr;     // save token end position in source line
 			if (*instr && (!dotDelimiter || *instr != '.')) // if not . delimiter
 				instr++;                               // skip delimiter
 			tokCount++;                               // count tokens
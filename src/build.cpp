@@ -34,6 +34,14 @@
  *		argument is used to return a status via the standard
  *		mechanism.
  *
+ *		The classes whose instruction word is the mask, an
+ *		effective address and possibly a field in bits 9-11,
+ *		followed by the extension words of the operands, are
+ *		built by instances of encodeEA(). Its template arguments
+ *		choose the operand of the effective address, the bits
+ *		9-11 field and the operands with extension words, so each
+ *		builder is compiled without testing its class.
+ *
  *      Author: Paul McKee
  *		ECE492    North Carolina State University
  *
@@ -48,10 +56,53 @@
 #include "../include/asm.h"
 #include "../include/build.h"
 #include "../include/codegen.h"
+#include "../include/relax.h"
 
-extern int loc;
+extern thread_local int loc;
 extern bool pass2;
 
+const int ENC_NONE = 0;         // encodeEA() operands
+const int ENC_SOURCE = 1;
+const int ENC_DEST = 2;
+const int ENC_BOTH = 3;         // extension words of source, then dest
+const int ENC_QUICK = 4;        // bits 9-11 from source->data, 8 as 0
+
+/**********************************************************************
+ *
+ *	Function encodeEA builds one word of mask, the effective address
+ *	of operand EA and the bits 9-11 field REG (the register of an
+ *	operand or ENC_QUICK), then the extension words of the operands
+ *	in EXT.
+ *
+ ***********************************************************************/
+
+template<int EA, int REG, int EXT>
+static inline int encodeEA(int mask, int size, opDescriptor *source,
+		opDescriptor *dest, int *errorPtr) {
+	int word;
+
+	if (pass2) {
+		word = mask | effAddr((EA == ENC_SOURCE) ? source : dest);
+		if constexpr (REG == ENC_SOURCE)
+			word |= source->reg << 9;
+		else if constexpr (REG == ENC_DEST)
+			word |= dest->reg << 9;
+		else if constexpr (REG == ENC_QUICK)
+			word |= (source->data & 7) << 9;
+		output(word, WORD_SIZE);
+		if constexpr (REG == ENC_QUICK)
+			if (source->data < 1 || source->data > 8)
+				NEWERROR(*errorPtr, INV_QUICK_CONST);
+	}
+	loc += 2;
+	if constexpr ((EXT & ENC_SOURCE) != 0)
+		extWords(source, size, errorPtr);
+	if constexpr ((EXT & ENC_DEST) != 0)
+		extWords(dest, size, errorPtr);
+
+	return (NORMAL);
+}
+
 /**********************************************************************
  *
  *	Function move builds the MOVE and MOVEA instructions
@@ -130,12 +181,8 @@ int zeroOp(int mask, int size, opDescriptor *source, opDescriptor *dest,
 
 int oneOp(int mask, int size, opDescriptor *source, opDescriptor *dest,
 		int *errorPtr) {
-	if (pass2)
-		output((int) (mask | effAddr(source)), WORD_SIZE);
-	loc += 2;
-	extWords(source, size, errorPtr);
-
-	return (NORMAL);
+	return (encodeEA<ENC_SOURCE, ENC_NONE, ENC_SOURCE>(mask, size, source,
+			dest, errorPtr));
 }
 
 /**********************************************************************
@@ -186,13 +233,8 @@ int arithReg(int mask, int size, opDescriptor *source, opDescriptor *dest,
 		}
 	}
 	// Otherwise assemble as an ordinary instruction
-	if (pass2) {
-		output((int) (mask | effAddr(source) | (dest->reg << 9)), WORD_SIZE);
-	}
-	loc += 2;
-	extWords(source, size, errorPtr);
-
-	return (NORMAL);
+	return (encodeEA<ENC_SOURCE, ENC_DEST, ENC_SOURCE>(mask, size, source,
+			dest, errorPtr));
 }
 
 /**********************************************************************
@@ -212,12 +254,8 @@ int arithReg(int mask, int size, opDescriptor *source, opDescriptor *dest,
 
 int arithAddr(int mask, int size, opDescriptor *source, opDescriptor *dest,
 		int *errorPtr) {
-	if (pass2)
-		output((int) (mask | effAddr(dest) | (source->reg << 9)), WORD_SIZE);
-	loc += 2;
-	extWords(dest, size, errorPtr);
-
-	return (NORMAL);
+	return (encodeEA<ENC_DEST, ENC_SOURCE, ENC_DEST>(mask, size, source, dest,
+			errorPtr));
 }
 
 //---------------------------------------------------------------------
@@ -301,14 +339,8 @@ int immedInst(int mask, int size, opDescriptor *source, opDescriptor *dest,
 		}
 	}
 	// Otherwise assemble as an ordinary instruction
-	if (pass2) {
-		output((int) (mask | effAddr(dest)), WORD_SIZE);
-	}
-	loc += 2;
-	extWords(source, size, errorPtr);
-	extWords(dest, size, errorPtr);
-
-	return (NORMAL);
+	return (encodeEA<ENC_DEST, ENC_NONE, ENC_BOTH>(mask, size, source, dest,
+			errorPtr));
 }
 
 /**********************************************************************
@@ -321,16 +353,8 @@ int immedInst(int mask, int size, opDescriptor *source, opDescriptor *dest,
 
 int quickMath(int mask, int size, opDescriptor *source, opDescriptor *dest,
 		int *errorPtr) {
-	if (pass2) {
-		output((int) (mask | effAddr(dest) | ((source->data & 7) << 9)),
-				WORD_SIZE);
-		if (source->data < 1 || source->data > 8)
-			NEWERROR(*errorPtr, INV_QUICK_CONST);
-	}
-	loc += 2;
-	extWords(dest, size, errorPtr);
-
-	return (NORMAL);
+	return (encodeEA<ENC_DEST, ENC_QUICK, ENC_DEST>(mask, size, source, dest,
+			errorPtr));
 }
 
 /**********************************************************************
@@ -415,12 +439,8 @@ int moves(int mask, int size, opDescriptor *source, opDescriptor *dest,
 
 int moveReg(int mask, int size, opDescriptor *source, opDescriptor *dest,
 		int *errorPtr) {
-	if (pass2)
-		output((int) (mask | effAddr(dest)), WORD_SIZE);
-	loc += 2;
-	extWords(dest, size, errorPtr);
-
-	return (NORMAL);
+	return (encodeEA<ENC_DEST, ENC_NONE, ENC_DEST>(mask, size, source, dest,
+			errorPtr));
 }
 
 /**********************************************************************
@@ -527,6 +547,8 @@ int branch(int mask, int size, opDescriptor *source, opDescriptor *dest,
 			|| (size != LONG_SIZE && size != WORD_SIZE && source->backRef
 					&& disp >= -128 && disp <= 127 && disp))
 		shortDisp = true;
+	else if (size != LONG_SIZE && size != WORD_SIZE && !source->backRef)
+		shortDisp = relaxBranch(source->data);  // forward branch made short
 	if (pass2) {
 		if (shortDisp) {
 			output((int) (mask | (disp & 0xFF)), WORD_SIZE);
@@ -658,12 +680,8 @@ int dbcc(int mask, int size, opDescriptor *source, opDescriptor *dest,
 
 int scc(int mask, int size, opDescriptor *source, opDescriptor *dest,
 		int *errorPtr) {
-	if (pass2)
-		output((int) (mask | effAddr(source)), WORD_SIZE);
-	loc += 2;
-	extWords(source, size, errorPtr);
-
-	return (NORMAL);
+	return (encodeEA<ENC_SOURCE, ENC_NONE, ENC_SOURCE>(mask, size, source,
+			dest, errorPtr));
 }
 
 /**********************************************************************
@@ -804,3 +822,74 @@ int link_ins(int mask, int size, opDescriptor *source, opDescriptor *dest,
 
 	return (NORMAL);
 }
+
+/**********************************************************************
+ *
+ *	Function instSize returns the number of bytes the builder of a
+ *	flavor will generate, using only the size code, the addressing
+ *	modes and, for the quick forms and branches, the operand value.
+ *	It is used in pass 1, where the builders only advance loc, and
+ *	must agree with the pass 2 output of every builder above.
+ *
+ ***********************************************************************/
+
+int instSize(flavor *flavorPtr, int mask, int size, opDescriptor *source,
+		opDescriptor *dest) {
+	int (*exec)(int, int, opDescriptor*, opDescriptor*, int*);
+	unsigned short type;
+	int disp;
+
+	exec = flavorPtr->exec;
+	if (exec == move) {
+		if (source->mode == IMMEDIATE && source->backRef && source->size == 0
+				&& size == LONG_SIZE && dest->mode == DnDirect
+				&& source->data >= -128 && source->data <= 127)
+			return (2);                       // MOVEQ
+		return (2 + extSize(source, size) + extSize(dest, size));
+	}
+	if (exec == oneOp || exec == scc)
+		return (2 + extSize(source, size));
+	if (exec == arithReg) {
+		type = mask & 0xF000;
+		if ((type == 0xD000 || type == 0x9000)  // if ADDA or SUBA
+		&& source->mode == IMMEDIATE && size != BYTE_SIZE
+				&& (source->backRef && source->data >= 1 && source->data <= 8)
+				&& source->size == 0)
+			return (2 + extSize(dest, size));   // ADDQ or SUBQ
+		return (2 + extSize(source, size));
+	}
+	if (exec == arithAddr || exec == moveReg || exec == quickMath)
+		return (2 + extSize(dest, size));
+	if (exec == immedInst) {
+		type = mask & 0xFF00;
+		if ((type == 0x0600 || type == 0x0400)
+				&& (source->backRef && source->data >= 1 && source->data <= 8)
+				&& source->size == 0)
+			return (2 + extSize(dest, size));   // ADDQ or SUBQ
+		return (2 + extSize(source, size) + extSize(dest, size));
+	}
+	if (exec == bitField)
+		return (4 + extSize(((mask & 0x0700) == BFINS) ? dest : source, size));
+	if (exec == moves)
+		return (4 + extSize((source->mode & (DnDirect | AnDirect)) ? dest : source,
+				size));
+	if (exec == staticBit)
+		return (4 + extSize(dest, size));
+	if (exec == branch) {
+		disp = source->data - loc - 2;
+		if (((size == SHORT_SIZE) || (size == BYTE_SIZE))
+				|| (size != LONG_SIZE && size != WORD_SIZE && source->backRef
+						&& disp >= -128 && disp <= 127 && disp))
+			return (2);
+		if (size != LONG_SIZE && size != WORD_SIZE && !source->backRef
+				&& relaxBranch(source->data))
+			return (2);
+		return (4);
+	}
+	if (exec == movep || exec == movec || exec == immedToCCR
+			|| exec == immedWord || exec == dbcc || exec == link_ins)
+		return (4);
+
+	// zeroOp, trap, moveq, shiftReg, exg, twoReg, oneReg, moveUSP
+	return (2);
+}
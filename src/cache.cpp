@@ -0,0 +1,335 @@
+/***********************************************************************
+ *
+ *		CACHE.CPP
+ *		Pass 1 Encoding Cache for 68000 Assembler
+ *
+ *    Function: cacheBuild()
+ *		Calls the builder of a flavor. During pass 1, when every
+ *		operand of the instruction is a register or a backwards
+ *		reference, the encoding cannot change in pass 2, so the
+ *		instruction is recorded as a job for cacheEncode(), which
+ *		runs the builder as in pass 2 and keeps the words it
+ *		outputs in a compact store.
+ *		Other instructions are only sized in pass 1 by
+ *		instSize(), without running the builder.
+ *
+ *		cacheReplay()
+ *		Called by createCode() for every instruction before the
+ *		operands are parsed. In pass 2, if the instruction was
+ *		encoded during pass 1 at the same address, the kept words
+ *		are output again and the instruction needs no parsing.
+ *		The symbols its operands used in pass 1 are passed on to
+ *		depUse(), as parsing them in pass 2 would.
+ *
+ *		cacheEncode()
+ *		Called between the passes. Pass 1 only records the
+ *		resolved instructions as jobs; this function encodes the
+ *		jobs in address ordered chunks, one chunk per processor,
+ *		into per-chunk buffers that are then merged in order into
+ *		the store. Everything order sensitive (SET symbols,
+ *		macros, includes, structured code, conditionals) was
+ *		already resolved by the sequential pass 1, so the jobs
+ *		are independent. Small job lists are encoded sequentially.
+ *		Only this encoding is parallel; pass 2 still runs on the
+ *		assembler thread, replaying the kept words and assembling
+ *		every other line in order.
+ *
+ *		cacheBadMode()
+ *		Called by effAddr() and extWords() for an invalid
+ *		addressing mode. While a job is encoded the mode is
+ *		recorded and the job is not kept, so pass 2 assembles
+ *		the line and reports the error on the assembler thread.
+ *
+ *		Instructions are matched between the passes by their
+ *		sequence number in the pass, checked against the address
+ *		and a hash of the source line.
+ *
+ ************************************************************************/
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <thread>
+#include "../include/asm.h"
+#include "../include/advise.h"
+#include "../include/build.h"
+#include "../include/codegen.h"
+#include "../include/cache.h"
+#include "../include/chain.h"
+#include "../include/depend.h"
+#include "../include/peep.h"
+#include "../include/relax.h"
+
+extern thread_local int loc;
+extern bool pass2;
+
+struct cacheEntry {
+	unsigned int hash;            // hash of the source line
+	int loc;                      // address of the instruction
+	int start;                    // index of the first word in cacheData
+	int count;                    // number of words, -1 if not kept
+	int error;                    // error code from the builder
+	int useStart;                 // first symbol used in cacheUses
+	int useCount;
+};
+
+static std::vector<cacheEntry> cacheLines;  // one entry per instruction
+static std::vector<int> cacheData;          // kept instruction words
+static std::vector<char> cacheSize;         // size of each kept word
+static std::vector<std::string> cacheUses;  // symbols used by the operands
+static unsigned int cacheSeq;               // instruction sequence number
+static int cacheOpen = -1;                  // entry whose operands are parsed
+static bool noReplay;                       // true if line must not be kept
+
+struct cacheJob {
+	unsigned int line;            // index in cacheLines
+	flavor *flavorPtr;
+	int mask;
+	int size;
+	opDescriptor source;
+	opDescriptor dest;
+	int loc;                      // address of the instruction
+	int bytes;                    // size from instSize()
+	int start;                    // first word in the chunk buffer
+	int count;                    // number of words, -1 if not kept
+	int error;
+};
+
+struct cacheChunk {
+	std::vector<int> data;
+	std::vector<char> size;
+	bool badMode;                 // the job met an invalid addressing mode
+};
+
+static std::vector<cacheJob> cacheJobs;     // resolved instructions of pass 1
+static thread_local cacheChunk *chunk = NULL; // words output by this thread
+
+const size_t CACHE_CHUNK = 256;   // fewest jobs worth a thread of their own
+
+const int CACHE_RESOLVED = DnDirect | AnDirect | AnInd | AnIndPost | AnIndPre
+		| SRDirect | CCRDirect | USPDirect | SFCDirect | DFCDirect | VBRDirect;
+
+//------------------------------------------------------------
+// Called at the start of each pass
+int cacheStart(int pass) {
+	if (pass == 0)
+		cacheClear();
+	cacheSeq = 0;
+	return (NORMAL);
+}
+
+int cacheClear() {
+	cacheLines.clear();
+	cacheData.clear();
+	cacheSize.clear();
+	cacheJobs.clear();
+	cacheUses.clear();
+	cacheSeq = 0;
+	cacheOpen = -1;
+	return (NORMAL);
+}
+
+// Called from evalNumber() when a SET symbol is used. Its value at this
+// line in pass 2 may differ from the value seen in pass 1.
+int cacheNoReplay() {
+	noReplay = true;
+	return (NORMAL);
+}
+
+// Called from evalNumber() for every symbol used in pass 1
+int cacheUse(const char *name) {
+	if (!pass2 && cacheOpen >= 0) {
+		cacheUses.push_back(name);
+		cacheLines[cacheOpen].useCount++;
+	}
+	return (NORMAL);
+}
+
+// Called from output(). Returns true if the word was kept.
+bool cacheWord(int data, int size) {
+	if (!chunk)
+		return (false);
+	chunk->data.push_back(data);
+	chunk->size.push_back(size);
+	return (true);
+}
+
+// Called for an invalid addressing mode. Returns true if a job is being
+// encoded, which then is left for pass 2 to report.
+bool cacheBadMode() {
+	if (!chunk)
+		return (false);
+	chunk->badMode = true;
+	return (true);
+}
+
+static unsigned int cacheHash(const char *s) {
+	unsigned int h = 2166136261u;
+	while (*s) {
+		h ^= (unsigned char) *s++;
+		h *= 16777619u;
+	}
+	return (h);
+}
+
+//------------------------------------------------------------
+// Pre: loc is word aligned and the label has been defined
+// Returns true if the kept pass 1 encoding was output
+bool cacheReplay(char *capLine, int *errorPtr) {
+	unsigned int seq = cacheSeq++;
+	noReplay = false;
+
+	if (!pass2) {
+		cacheEntry entry;
+		entry.hash = cacheHash(capLine);
+		entry.loc = loc;
+		entry.start = 0;
+		entry.count = -1;
+		entry.error = OK;
+		entry.useStart = cacheUses.size();
+		entry.useCount = 0;
+		cacheOpen = -1;
+		if (seq == cacheLines.size()) {
+			cacheLines.push_back(entry);
+			cacheOpen = seq;
+		}
+		return (false);
+	}
+
+	if (seq >= cacheLines.size())
+		return (false);
+	cacheEntry *entry = &cacheLines[seq];
+	if (entry->count < 0 || entry->loc != loc || entry->hash != cacheHash(capLine))
+		return (false);
+	for (int i = entry->start; i < entry->start + entry->count; i++) {
+		output(cacheData[i], cacheSize[i]);
+		loc += cacheSize[i];
+	}
+	for (int i = entry->useStart; i < entry->useStart + entry->useCount; i++)
+		depUse(cacheUses[i].c_str(), false);
+	NEWERROR(*errorPtr, entry->error);
+	return (true);
+}
+
+//------------------------------------------------------------
+// Call the builder for the selected flavor
+int cacheBuild(flavor *flavorPtr, int mask, int size, opDescriptor *source,
+		opDescriptor *dest, int *errorPtr) {
+	bool resolved;
+
+	cacheOpen = -1;                                   // operands are parsed
+	if (flavorPtr->source)
+		adviseOperand(source);                          // OPT ADVISE forward #n
+	chainFlow(flavorPtr, mask);                       // OPT CHAIN reachability
+	relaxOperands(flavorPtr, source, dest, errorPtr); // OPT EAOPT shorter modes
+	if (peepBuild(flavorPtr, mask, size, source, dest, errorPtr)) // OPT PEEP
+		return (NORMAL);
+	resolved = !pass2 && !noReplay && *errorPtr == OK && cacheSeq > 0
+			&& cacheSeq == cacheLines.size();
+	if (resolved && flavorPtr->source)
+		resolved = (source->mode & CACHE_RESOLVED) || source->backRef;
+	if (resolved && flavorPtr->dest)
+		resolved = (dest->mode & CACHE_RESOLVED) || dest->backRef;
+	if (!resolved) {
+		if (pass2)
+			return ((*flavorPtr->exec)(mask, size, source, dest, errorPtr));
+		loc += instSize(flavorPtr, mask, size, source, dest); // pass 1 only sizes
+		return (NORMAL);
+	}
+
+	// record the instruction for cacheEncode()
+	cacheJob job;
+	job.line = cacheSeq - 1;
+	job.flavorPtr = flavorPtr;
+	job.mask = mask;
+	job.size = size;
+	job.source = *source;
+	job.dest = *dest;
+	job.loc = loc;
+	job.bytes = instSize(flavorPtr, mask, size, source, dest);
+	job.start = 0;
+	job.count = -1;
+	job.error = OK;
+	cacheJobs.push_back(job);
+	loc += job.bytes;
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Encode jobs first through last-1 into c. Runs on a worker thread,
+// which has its own loc.
+static void cacheEncodeChunk(cacheChunk *c, size_t first, size_t last) {
+	chunk = c;
+	for (size_t i = first; i < last; i++) {
+		cacheJob *job = &cacheJobs[i];
+		int error = OK;
+		job->start = c->data.size();
+		c->badMode = false;
+		loc = job->loc;
+		(*job->flavorPtr->exec)(job->mask, job->size, &job->source, &job->dest,
+				&error);
+		job->count = c->data.size() - job->start;
+		job->error = error;
+		if (c->badMode || loc != job->loc + job->bytes) { // disagrees with pass 1
+			c->data.resize(job->start);
+			c->size.resize(job->start);
+			job->count = -1;
+		}
+	}
+	chunk = NULL;
+}
+
+// Called after pass 1, encodes the recorded jobs for replay in pass 2
+int cacheEncode() {
+	size_t jobs = cacheJobs.size();
+	size_t threads = std::thread::hardware_concurrency();
+	int locSave = loc;
+	bool pass2Save = pass2;
+
+	try {
+		if (jobs == 0)
+			return (NORMAL);
+		if (threads > jobs / CACHE_CHUNK)
+			threads = jobs / CACHE_CHUNK;
+		if (threads < 1)
+			threads = 1;
+
+		std::vector<cacheChunk> chunks(threads);
+		pass2 = true;             // builders output as in pass 2
+		if (threads == 1)
+			cacheEncodeChunk(&chunks[0], 0, jobs);
+		else {
+			std::vector<std::thread> workers;
+			for (size_t t = 0; t < threads; t++)
+				workers.emplace_back(cacheEncodeChunk, &chunks[t],
+						jobs * t / threads, jobs * (t + 1) / threads);
+			for (size_t t = 0; t < threads; t++)
+				workers[t].join();
+		}
+		pass2 = pass2Save;
+		loc = locSave;
+
+		// merge the chunks in address order
+		for (size_t t = 0; t < threads; t++) {
+			int base = cacheData.size();
+			cacheData.insert(cacheData.end(), chunks[t].data.begin(), chunks[t].data.end());
+			cacheSize.insert(cacheSize.end(), chunks[t].size.begin(), chunks[t].size.end());
+			for (size_t i = jobs * t / threads; i < jobs * (t + 1) / threads; i++) {
+				cacheEntry *entry = &cacheLines[cacheJobs[i].line];
+				entry->start = base + cacheJobs[i].start;
+				entry->count = cacheJobs[i].count;
+				entry->error = cacheJobs[i].error;
+			}
+		}
+		cacheJobs.clear();
+	} catch (...) {
+		// leave every line to be assembled in pass 2
+		pass2 = pass2Save;
+		loc = locSave;
+		for (size_t i = 0; i < cacheLines.size(); i++)
+			cacheLines[i].count = -1;
+		cacheJobs.clear();
+		return (MILD_ERROR);
+	}
+	return (NORMAL);
+}
@@ -0,0 +1,234 @@
+/***********************************************************************
+ *
+ *		CHAIN.CPP
+ *		Branch Chain Collapsing for Structured Code
+ *
+ *    Function: chainBranch()
+ *		Called by asmStructure() for every BRA of structured code
+ *		(ELSE, ENDW and FOR). With OPT CHAIN, pass 1 notes the
+ *		structured labels defined right before the BRA, with no
+ *		instruction between, as another name for its target. It
+ *		also notes a BRA that cannot be reached because it
+ *		follows BRA, JMP, RTS, RTE or RTR with no label between,
+ *		and a BRA to the instruction right after it. The next
+ *		pass leaves these out of the code. A BRA after RTS with
+ *		structured labels in front of it is kept, as a branch
+ *		to those labels still needs it.
+ *
+ *		chainTarget()
+ *		Called for the target label of every structured BRA and
+ *		Bcc. With OPT CHAIN a label noted as another name is
+ *		replaced by the label it stands for, so the branch goes
+ *		straight to its final destination. A branch with .S or
+ *		.L is not changed, the size was chosen for its target.
+ *
+ *		Structured code is generated the same way in every pass,
+ *		so branches are matched between passes by their sequence
+ *		number and labels by name. The notes of one pass 1 are
+ *		used in the next pass; while a pass 1 finds new ones
+ *		chainNext() repeats pass 1 with them.
+ *
+ *		chainList()
+ *		Writes the number of branches changed to the listing.
+ *
+ ************************************************************************/
+
+#include <cctype>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "../include/asm.h"
+#include "../include/build.h"
+#include "../include/structured.h"
+#include "../include/chain.h"
+
+extern thread_local int loc;
+extern bool pass2;
+extern bool CHAINflag;          // true collapses structured branch chains
+
+struct chainNotes {
+	std::map<std::string, std::string> alias; // label -> target of the BRA at it
+	std::set<unsigned int> dead;              // BRA left out, by sequence number
+};
+
+static chainNotes chainUsed;                  // notes from the previous pass 1
+static chainNotes chainFound;                 // notes including this pass 1
+static std::vector<std::string> chainLabels;  // structured labels not yet followed
+static int chainLabelLoc;                     //   by an instruction, at this address
+static bool chainJump;                        // no way to reach loc from above
+static std::string chainBraTarget;            // last structured BRA, if it was
+static int chainBraEnd;                       //   the last instruction
+static unsigned int chainBraSeq;
+static unsigned int chainSeq;                 // structured BRA sequence number
+static int chainPasses;                       // pass 1 runs
+static int chainRetargeted;                   // branches changed in pass 2
+static int chainRemoved;                      // branches left out in pass 2
+static bool chainFlag;                        // CHAINflag at start of assembly
+
+const int CHAIN_PASSES = 8;       // most pass 1 runs for one assembly
+const int CHAIN_DEPTH = 16;       // longest chain followed
+
+//------------------------------------------------------------
+// Called at the start of an assembly
+int chainStart() {
+	chainUsed.alias.clear();
+	chainUsed.dead.clear();
+	chainFound = chainUsed;
+	chainPasses = 0;
+	chainFlag = CHAINflag;
+	return (NORMAL);
+}
+
+// Called at the start of each pass
+int chainPass() {
+	if (!pass2)
+		chainPasses++;
+	CHAINflag = chainFlag;
+	chainLabels.clear();
+	chainJump = false;
+	chainBraTarget.clear();
+	chainSeq = 0;
+	chainRetargeted = 0;
+	chainRemoved = 0;
+	return (NORMAL);
+}
+
+// Returns the label in upper case, as define() sees it
+static std::string chainName(const std::string &label) {
+	std::string name = label;
+
+	for (size_t i = 0; i < name.size(); i++)
+		name[i] = toupper(name[i]);
+	return (name);
+}
+
+// true if sym is a label made by asmStructure(), _0X followed by 8 digits
+static bool chainLabel(const char *sym) {
+	return (sym[0] == '_' && sym[1] == '0' && toupper(sym[2]) == 'X'
+			&& strlen(sym) == 11);
+}
+
+//------------------------------------------------------------
+// Called from define() in pass 1
+int chainDefine(const char *sym, int value) {
+	if (!CHAINflag)
+		return (NORMAL);
+	if (!chainLabel(sym)) {           // a label may be the target of any branch
+		chainJump = false;
+		return (NORMAL);
+	}
+	if (chainBraTarget == sym && chainBraEnd == value) {
+		chainFound.dead.insert(chainBraSeq);   // BRA to the next instruction
+		chainJump = false;              // so the code falls through to here
+	}
+	if (!chainLabels.empty() && chainLabelLoc != value)
+		chainJump = false;              // data between the labels
+	if (chainLabels.empty() || chainLabelLoc != value)
+		chainLabels.clear();
+	chainLabels.push_back(sym);
+	chainLabelLoc = value;
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Called by cacheBuild() for every instruction
+int chainFlow(flavor *flavorPtr, int mask) {
+	int (*exec)(int, int, opDescriptor*, opDescriptor*, int*);
+
+	if (pass2)
+		return (NORMAL);
+	exec = flavorPtr->exec;
+	chainLabels.clear();
+	chainBraTarget.clear();
+	chainJump = (exec == branch && mask == 0x6000)           // BRA
+			|| (exec == oneOp && mask == 0x4EC0)                 // JMP
+			|| (exec == zeroOp && (mask == 0x4E75 || mask == 0x4E73
+					|| mask == 0x4E77));                           // RTS RTE RTR
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Returns the final destination of a branch of structured code
+std::string chainTarget(const std::string &extent, const std::string &label) {
+	std::string name = chainName(label);
+	std::map<std::string, std::string>::iterator it;
+	int depth;
+
+	if (!CHAINflag || extent != "\t")
+		return (label);
+	for (depth = 0; depth < CHAIN_DEPTH; depth++) {
+		it = chainUsed.alias.find(name);
+		if (it == chainUsed.alias.end())
+			break;
+		name = it->second;
+		if (name == chainName(label))  // branch to itself
+			return (label);
+	}
+	if (depth == 0 || depth == CHAIN_DEPTH)
+		return (label);
+	if (pass2)
+		chainRetargeted++;
+	return (name);
+}
+
+//------------------------------------------------------------
+// Assemble BRA<extent> label for structured code, unless it can be
+// left out
+int chainBranch(const std::string &extent, const std::string &label) {
+	unsigned int seq = chainSeq++;
+	std::string target;
+
+	if (CHAINflag && !pass2) {
+		if (!chainLabels.empty() && chainLabelLoc != loc)
+			chainJump = false;            // data between the labels and here
+		else
+			for (size_t i = 0; i < chainLabels.size(); i++)
+				if (chainLabels[i] != chainName(label))  // not a loop to itself
+					chainFound.alias.insert(
+							std::make_pair(chainLabels[i], chainName(label)));
+		if (chainJump && chainLabels.empty())
+			chainFound.dead.insert(seq);  // cannot be reached
+	}
+	if (CHAINflag && chainUsed.dead.count(seq)) {
+		chainLabels.clear();
+		if (pass2)
+			chainRemoved++;
+		return (NORMAL);
+	}
+	target = chainTarget(extent, label);
+	assembleStc(stcOp("BRA", extent, target));
+	if (CHAINflag && !pass2) {
+		chainBraTarget = chainName(target);
+		chainBraEnd = loc;
+		chainBraSeq = seq;
+	}
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Called at the end of pass 1. Returns true to repeat pass 1 with the
+// notes found in this pass, unless last says pass 2 follows this pass.
+bool chainNext(bool last) {
+	if (chainFound.alias.size() == chainUsed.alias.size()
+			&& chainFound.dead.size() == chainUsed.dead.size())
+		return (false);
+	if (last || chainPasses >= CHAIN_PASSES) {
+		chainFound = chainUsed;         // pass 2 uses the notes of this pass
+		return (false);
+	}
+	chainUsed = chainFound;
+	return (true);
+}
+
+//------------------------------------------------------------
+// Write the number of branches changed to the listing file
+int chainList(FILE *listFile) {
+	if (!CHAINflag && !chainRetargeted && !chainRemoved)
+		return (NORMAL);
+	fprintf(listFile,
+			"Branch chains: %d structured branch%s retargeted, %d removed\n",
+			chainRetargeted, (chainRetargeted != 1) ? "es" : "", chainRemoved);
+	return (NORMAL);
+}
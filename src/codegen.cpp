@@ -21,7 +21,9 @@
  *		addressing mode is determined by the field of the
  *		opDescriptor which is pointed to by the operand
  *		argument. The lower 3 bits of the output contain the
- *		register code and the upper 3 bits the mode code.
+ *		register code and the upper 3 bits the mode code. The
+ *		code is taken from a table indexed by the bit number of
+ *		the mode.
  *
  *		extWords()
  *		Computes and outputs (using output()) the extension
@@ -32,6 +34,11 @@
  *		the size argument. The errorPtr argument is used to
  *		return an error code by the standard mechanism.
  *
+ *		extSize()
+ *		Returns the number of bytes of extension words that
+ *		extWords() would output for the operand, without
+ *		computing them. Used for pass 1 instruction sizing.
+ *
  *	 Usage: output(data, size)
  *		int data, size;
  *
@@ -42,6 +49,10 @@
  *		opDescriptor *op;
  *		int size, *errorPtr;
  *
+ *		extSize(op, size)
+ *		opDescriptor *op;
+ *		int size;
+ *
  *      Author: Paul McKee
  *		ECE492    North Carolina State University
  *
@@ -54,62 +65,54 @@
  ************************************************************************/
 
 #include <stdio.h>
+#include <bit>
 #include "../include/asm.h"
 #include "../include/listing.h"
 #include "../include/object.h"
+#include "../include/depend.h"
+#include "../include/cache.h"
+#include "../include/cycles.h"
 
-extern int loc;
+extern thread_local int loc;
 extern bool pass2;
 
 extern bool listFlag;	// True if a listing is desired
 extern bool objFlag;	// True if an object code file is desired
 extern char buffer[256];  //ck used to form messages for display in windows
 
+// Effective address fields and extension word bytes of the addressing
+// modes, indexed by the bit number of the mode (DnDirect is 0). The
+// first EA_REG_MODES take the register number in the low 3 bits.
+const int EA_MODES = 12;
+const int EA_REG_MODES = 7;
+const int EA_NO_EXT = DnDirect | AnDirect | AnInd | AnIndPost | AnIndPre;
+
+static const int eaCode[EA_MODES] = { 0x00, 0x08, 0x10, 0x18, 0x20, 0x28,
+		0x30, 0x38, 0x39, 0x3A, 0x3B, 0x3C };
+static const char eaExtSize[EA_MODES] = { 0, 0, 0, 0, 0, 2, 2, 2, 4, 2, 2,
+		2 };
+
 int output(int data, int size) {
+	if (cacheWord(data, size))    // pass 1 encoding kept for pass 2
+		return (NORMAL);
 	if (listFlag)
 		listObj(data, size);
+	cycleWord(data, size);        // OPT CYCLES
 	if (objFlag)
 		outputObj(loc, data, size);
+	if (pass2)
+		depObject(loc, data, size);
 	return (NORMAL);
 }
 
 int effAddr(opDescriptor *operand) {
-	if (operand->mode == DnDirect)
-		return (0x00 | operand->reg);
-
-	if (operand->mode == AnDirect)
-		return (0x08 | operand->reg);
-
-	if (operand->mode == AnInd)
-		return (0x10 | operand->reg);
-
-	if (operand->mode == AnIndPost)
-		return (0x18 | operand->reg);
-
-	if (operand->mode == AnIndPre)
-		return (0x20 | operand->reg);
-
-	if (operand->mode == AnIndDisp)
-		return (0x28 | operand->reg);
+	int n = std::countr_zero((unsigned int) operand->mode);
 
-	if (operand->mode == AnIndIndex)
-		return (0x30 | operand->reg);
-
-	if (operand->mode == AbsShort)
-		return (0x38);
-
-	if (operand->mode == AbsLong)
-		return (0x39);
-
-	if (operand->mode == PCDisp)
-		return (0x3A);
-
-	if (operand->mode == PCIndex)
-		return (0x3B);
-
-	if (operand->mode == IMMEDIATE)
-		return (0x3C);
+	if (n < EA_MODES && operand->mode == 1 << n)
+		return ((n < EA_REG_MODES) ? (eaCode[n] | operand->reg) : eaCode[n]);
 
+	if (cacheBadMode())           // encoding a job, pass 2 reports it
+		return (0);
 //	sprintf(buffer, "INVALID EFFECTIVE ADDRESSING MODE!\n");
 //	Application->MessageBox(buffer, "Error", MB_OK);
 	wxMessageBox("INVALID EFFECTIVE ADDRESSING MODE!", wxT("Error"));
@@ -121,12 +124,9 @@ int effAddr(opDescriptor *operand) {
 int extWords(opDescriptor *op, int size, int *errorPtr) {
 	int disp;
 
-	if (op->mode == DnDirect || op->mode == AnDirect || op->mode == AnInd
-			|| op->mode == AnIndPost || op->mode == AnIndPre) {
-		;
-	}
-
-	else if (op->mode == AnIndDisp || op->mode == PCDisp) {
+	if (op->mode & EA_NO_EXT)     // no extension words
+		return (NORMAL);
+	if (op->mode == AnIndDisp || op->mode == PCDisp) {
 		if (pass2) {
 			disp = op->data;
 			if (op->mode == PCDisp)
@@ -185,6 +185,8 @@ int extWords(opDescriptor *op, int size, int *errorPtr) {
 			loc += 4;
 		}
 	} else {
+		if (cacheBadMode())         // encoding a job, pass 2 reports it
+			return (MILD_ERROR);
 //		sprintf(buffer, "INVALID EFFECTIVE ADDRESSING MODE!\n");
 //		Application->MessageBox(buffer, "Error", MB_OK);
 		wxMessageBox("INVALID EFFECTIVE ADDRESSING MODE!", wxT("Error"));
@@ -193,3 +195,14 @@ int extWords(opDescriptor *op, int size, int *errorPtr) {
 
 	return (NORMAL);
 }
+
+int extSize(opDescriptor *op, int size) {
+	int n = std::countr_zero((unsigned int) op->mode);
+
+	if (n >= EA_MODES || op->mode != 1 << n)
+		return (0);
+	if (op->mode == IMMEDIATE && size && size != WORD_SIZE
+			&& size != BYTE_SIZE)
+		return ((size == LONG_SIZE) ? 4 : 0);
+	return (eaExtSize[n]);
+}
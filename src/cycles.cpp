@@ -0,0 +1,730 @@
+/***********************************************************************
+ *
+ *		CYCLES.CPP
+ *		68000 Cycle Counts for the Listing
+ *
+ *    Function: cycleLine(), cycleCode(), cycleWord()
+ *		With OPT CYCLES, pass 2 keeps the words output for
+ *		each instruction. cycleLine() is called by assemble()
+ *		and assembleStc() at the start of every line and
+ *		cycleCode() by instCode() and movem() before an
+ *		instruction is output, so data output by directives is
+ *		never timed.
+ *
+ *		cycleField()
+ *		Called by listLine(). The instructions of the line are
+ *		decoded from their words with disasmModes(), which
+ *		gives the flavor, size and addressing modes, and timed
+ *		from the tables of the MC68000 user's manual. The
+ *		column shows clock cycles and bus reads and writes as
+ *		cycles(reads/writes). Timing that depends on the data
+ *		or the branch taken is shown as a range: Bcc taken or
+ *		not, DBcc looping, true or expired, a shift by a
+ *		register, Scc, MULU/MULS and DIVU/DIVS. The bus counts
+ *		of a range are those of its longest case. MULU and
+ *		MULS with an immediate source are timed from its bits.
+ *		Instructions with no 68000 timing, such as the bit
+ *		field instructions, add "?" to the column. A line cut
+ *		by OPT CEX shows the column on its last listing line.
+ *
+ *		With OPT HOT each instruction timed is passed on to
+ *		hotInst() with its address, and with OPT ADVISE to
+ *		adviseInst(), whether or not the column is listed.
+ *
+ *		cycleCount()
+ *		Returns the most clock cycles of one instruction, for
+ *		timing the faster forms suggested by OPT ADVISE.
+ *
+ *		cycleLabel()
+ *		Called by define() in pass 2. A global label on code
+ *		starts a new subtotal; local labels and the labels of
+ *		structured code count toward the label above them.
+ *		With OPT HOT the label is passed on to hotLabel().
+ *
+ *		cycleList()
+ *		Writes the subtotal of each label to the listing. The
+ *		subtotals add each instruction once, as if the code
+ *		ran straight through.
+ *
+ ************************************************************************/
+
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <bit>
+#include <string>
+#include <vector>
+#include "../include/asm.h"
+#include "../include/build.h"
+#include "../include/disasm.h"
+#include "../include/cycles.h"
+#include "../include/hotpath.h"
+#include "../include/advise.h"
+
+extern thread_local int loc;
+extern bool pass2;
+extern bool CYCLEflag;          // true lists clock cycles of instructions
+extern bool HOTflag;            // true ranks the costliest loops and subroutines
+extern bool ADVISEflag;         // true lists faster forms of instructions
+extern int lineNumL68;          // listing line number
+extern int lineNum;             // source line number
+
+struct cycleTime {
+	int low;                      // clock cycles, fewest
+	int high;                     //   and most
+	int reads;                    // bus read cycles
+	int writes;                   // bus write cycles
+};
+
+struct cycleCost {
+	unsigned char cycles;
+	unsigned char reads;
+	unsigned char writes;
+};
+
+struct cycleTotal {
+	std::string label;            // global label, empty for code above the first
+	int line;                     // listing line number of the label
+	int loc;                      // address of the label
+	int count;                    // instructions timed
+	int untimed;                  // instructions with no timing
+	cycleTime time;
+};
+
+// Tables indexed by the bit number of the addressing mode (DnDirect is
+// 0, IMMEDIATE is 11)
+const int CYCLE_MODES = 12;
+
+// Effective address calculation, byte and word, then long
+static const cycleCost cycleEATable[2][CYCLE_MODES] = {
+	{ { 0, 0, 0 }, { 0, 0, 0 }, { 4, 1, 0 }, { 4, 1, 0 }, { 6, 1, 0 },
+	  { 8, 2, 0 }, { 10, 2, 0 }, { 8, 2, 0 }, { 12, 3, 0 }, { 8, 2, 0 },
+	  { 10, 2, 0 }, { 4, 1, 0 } },
+	{ { 0, 0, 0 }, { 0, 0, 0 }, { 8, 2, 0 }, { 8, 2, 0 }, { 10, 2, 0 },
+	  { 12, 3, 0 }, { 14, 3, 0 }, { 12, 3, 0 }, { 16, 4, 0 }, { 12, 3, 0 },
+	  { 14, 3, 0 }, { 8, 2, 0 } } };
+
+// MOVE destination, byte and word, then long
+static const cycleCost cycleMoveTable[2][CYCLE_MODES] = {
+	{ { 0, 0, 0 }, { 0, 0, 0 }, { 4, 0, 1 }, { 4, 0, 1 }, { 4, 0, 1 },
+	  { 8, 1, 1 }, { 10, 1, 1 }, { 8, 1, 1 }, { 12, 2, 1 } },
+	{ { 0, 0, 0 }, { 0, 0, 0 }, { 8, 0, 2 }, { 8, 0, 2 }, { 8, 0, 2 },
+	  { 12, 1, 2 }, { 14, 1, 2 }, { 12, 1, 2 }, { 16, 2, 2 } } };
+
+// JMP, JSR, LEA and PEA by control addressing mode
+static const cycleCost cycleJmpTable[CYCLE_MODES] = { { 0, 0, 0 },
+	{ 0, 0, 0 }, { 8, 2, 0 }, { 0, 0, 0 }, { 0, 0, 0 }, { 10, 2, 0 },
+	{ 14, 3, 0 }, { 10, 2, 0 }, { 12, 3, 0 }, { 10, 2, 0 }, { 14, 3, 0 } };
+static const cycleCost cycleJsrTable[CYCLE_MODES] = { { 0, 0, 0 },
+	{ 0, 0, 0 }, { 16, 2, 2 }, { 0, 0, 0 }, { 0, 0, 0 }, { 18, 2, 2 },
+	{ 22, 2, 2 }, { 18, 2, 2 }, { 20, 3, 2 }, { 18, 2, 2 }, { 22, 2, 2 } };
+static const cycleCost cycleLeaTable[CYCLE_MODES] = { { 0, 0, 0 },
+	{ 0, 0, 0 }, { 4, 1, 0 }, { 0, 0, 0 }, { 0, 0, 0 }, { 8, 2, 0 },
+	{ 12, 2, 0 }, { 8, 2, 0 }, { 12, 3, 0 }, { 8, 2, 0 }, { 12, 2, 0 } };
+static const cycleCost cyclePeaTable[CYCLE_MODES] = { { 0, 0, 0 },
+	{ 0, 0, 0 }, { 12, 1, 2 }, { 0, 0, 0 }, { 0, 0, 0 }, { 16, 2, 2 },
+	{ 20, 2, 2 }, { 16, 2, 2 }, { 20, 3, 2 }, { 16, 2, 2 }, { 20, 2, 2 } };
+
+// MOVEM memory to registers, then registers to memory, before the
+// registers moved
+static const cycleCost cycleMovemTable[2][CYCLE_MODES] = {
+	{ { 0, 0, 0 }, { 0, 0, 0 }, { 12, 3, 0 }, { 12, 3, 0 }, { 0, 0, 0 },
+	  { 16, 4, 0 }, { 18, 4, 0 }, { 16, 4, 0 }, { 20, 5, 0 }, { 16, 4, 0 },
+	  { 18, 4, 0 } },
+	{ { 0, 0, 0 }, { 0, 0, 0 }, { 8, 2, 0 }, { 0, 0, 0 }, { 8, 2, 0 },
+	  { 12, 3, 0 }, { 14, 3, 0 }, { 12, 3, 0 }, { 16, 4, 0 } } };
+
+// Extension bytes of the MOVEM effective address
+static const char cycleMovemExt[CYCLE_MODES] = { 0, 0, 0, 0, 0, 2, 2, 2, 4,
+		2, 2 };
+
+static std::vector<unsigned char> cycleBytes;  // instructions not yet timed
+static std::vector<cycleTotal> cycleTotals;    // subtotals by label in pass 2
+static cycleTime cycleLineTime;                // code of the listing line
+static int cycleLineCount;                     //   instructions timed
+static int cycleLineUntimed;                   //   instructions with no timing
+static bool cycleInCode;                       // words output are instructions
+static int cycleLoc;                           //   from this address
+static int cycleCodeLine;                      //   on this listing line
+static int cycleSourceLine;                    //   of this source line
+static bool cycleFlag;                         // CYCLEflag at start of assembly
+static char cycleText[48];                     // listing column
+
+//------------------------------------------------------------
+// Called at the start of an assembly
+int cycleStart() {
+	cycleTotals.clear();
+	cycleFlag = CYCLEflag;
+	return (NORMAL);
+}
+
+// Called at the start of each pass
+int cyclePass() {
+	CYCLEflag = cycleFlag;
+	cycleBytes.clear();
+	cycleTotals.clear();
+	cycleLineTime = cycleTime();
+	cycleLineCount = cycleLineUntimed = 0;
+	cycleInCode = false;
+	return (NORMAL);
+}
+
+// Returns the table index of an addressing mode, or -1
+static int cycleIndex(int mode) {
+	int n = std::countr_zero((unsigned int) mode);
+
+	if (n < CYCLE_MODES && mode == 1 << n)
+		return (n);
+	return (-1);
+}
+
+// Add a time that does not depend on the data. The functions that add
+// a time return true, so the instruction is timed.
+static bool cycleAdd(cycleTime &t, int cycles, int reads, int writes) {
+	t.low += cycles;
+	t.high += cycles;
+	t.reads += reads;
+	t.writes += writes;
+	return (true);
+}
+
+// Add a range of cycles
+static bool cycleRange(cycleTime &t, int low, int high, int reads, int writes) {
+	t.low += low;
+	t.high += high;
+	t.reads += reads;
+	t.writes += writes;
+	return (true);
+}
+
+// Add an entry of a table indexed by addressing mode. Returns false if
+// the mode is not in the table.
+static bool cycleTable(cycleTime &t, const cycleCost *table, int mode) {
+	int n = cycleIndex(mode);
+
+	if (n < 0)
+		return (false);
+	return (cycleAdd(t, table[n].cycles, table[n].reads, table[n].writes));
+}
+
+// Add the effective address calculation of an operand
+static bool cycleEA(cycleTime &t, int mode, int size) {
+	return (cycleTable(t, cycleEATable[size == LONG_SIZE], mode));
+}
+
+// Returns the word at code
+static int cycleWordAt(const unsigned char *code) {
+	return ((code[0] << 8) | code[1]);
+}
+
+// true for a data or address register
+static bool cycleReg(int mode) {
+	return (mode == DnDirect || mode == AnDirect);
+}
+
+// Time the single operand forms built by oneOp()
+static bool cycleOneOp(cycleTime &t, int word, int size, int ea) {
+	bool isLong = (size == LONG_SIZE);
+
+	switch (word & 0xFFC0) {
+	case 0x4EC0:                    // JMP
+		return (cycleTable(t, cycleJmpTable, ea));
+	case 0x4E80:                    // JSR
+		return (cycleTable(t, cycleJsrTable, ea));
+	case 0x4840:                    // PEA
+		return (cycleTable(t, cyclePeaTable, ea));
+	case 0x44C0:                    // MOVE <ea>,CCR
+	case 0x46C0:                    // MOVE <ea>,SR
+		cycleAdd(t, 12, 2, 0);
+		return (cycleEA(t, ea, WORD_SIZE));
+	case 0x4AC0:                    // TAS
+		if (ea == DnDirect)
+			return (cycleAdd(t, 4, 1, 0));
+		cycleAdd(t, 10, 1, 1);
+		return (cycleEA(t, ea, BYTE_SIZE));
+	case 0x4800:                    // NBCD
+		if (ea == DnDirect)
+			return (cycleAdd(t, 6, 1, 0));
+		cycleAdd(t, 8, 1, 1);
+		return (cycleEA(t, ea, BYTE_SIZE));
+	}
+	if ((word & 0xF000) == 0xE000) {  // shift or rotate memory
+		cycleAdd(t, 8, 1, 1);
+		return (cycleEA(t, ea, WORD_SIZE));
+	}
+	if ((word & 0xFF00) == 0x4A00) {  // TST
+		cycleAdd(t, 4, 1, 0);
+		return (cycleEA(t, ea, size));
+	}
+	if (ea == DnDirect)             // CLR, NEG, NEGX, NOT
+		return (cycleAdd(t, (isLong) ? 6 : 4, 1, 0));
+	if (isLong)
+		cycleAdd(t, 12, 1, 2);
+	else
+		cycleAdd(t, 8, 1, 1);
+	return (cycleEA(t, ea, size));
+}
+
+// Time the <ea>,Dn and <ea>,An forms built by arithReg()
+static bool cycleArithReg(cycleTime &t, const unsigned char *code, int word,
+		int size, int ea) {
+	bool isLong = (size == LONG_SIZE);
+	bool fast = cycleReg(ea) || ea == IMMEDIATE;
+	int data;
+
+	switch (word & 0xF1C0) {
+	case 0x41C0:                    // LEA
+		return (cycleTable(t, cycleLeaTable, ea));
+	case 0x4180:                    // CHK
+		cycleAdd(t, 10, 1, 0);
+		return (cycleEA(t, ea, WORD_SIZE));
+	case 0xC0C0:                    // MULU
+	case 0xC1C0:                    // MULS
+		if (ea == IMMEDIATE) {        // 2 cycles for each 1, or each 01 or 10
+			data = cycleWordAt(code + 2);
+			if (word & 0x0100)
+				data = (data ^ (data << 1)) & 0xFFFF;
+			cycleAdd(t, 38 + 2 * std::popcount((unsigned int) data), 1, 0);
+		} else
+			cycleRange(t, 38, 70, 1, 0);
+		return (cycleEA(t, ea, WORD_SIZE));
+	case 0x80C0:                    // DIVU
+		cycleRange(t, 76, 140, 1, 0);
+		return (cycleEA(t, ea, WORD_SIZE));
+	case 0x81C0:                    // DIVS
+		cycleRange(t, 120, 158, 1, 0);
+		return (cycleEA(t, ea, WORD_SIZE));
+	}
+	if ((word & 0x00C0) == 0x00C0) {  // ADDA, SUBA, CMPA
+		if ((word & 0xF000) == 0xB000)
+			cycleAdd(t, 6, 1, 0);
+		else if (!isLong)
+			cycleAdd(t, 8, 1, 0);
+		else
+			cycleAdd(t, (fast) ? 8 : 6, 1, 0);
+	} else if (!isLong)             // ADD, SUB, AND, OR, CMP
+		cycleAdd(t, 4, 1, 0);
+	else if ((word & 0xF000) == 0xB000)
+		cycleAdd(t, 6, 1, 0);
+	else
+		cycleAdd(t, (fast) ? 8 : 6, 1, 0);
+	return (cycleEA(t, ea, size));
+}
+
+// Time the Dn,<ea> forms built by arithAddr()
+static bool cycleArithAddr(cycleTime &t, int word, int size, int ea) {
+	bool isLong = (size == LONG_SIZE);
+
+	if ((word & 0xF000) == 0x0000) {  // BTST, BCHG, BCLR, BSET Dn,<ea>
+		switch (word & 0x01C0) {
+		case 0x0100:
+			if (ea == DnDirect)
+				return (cycleAdd(t, 6, 1, 0));
+			cycleAdd(t, 4, 1, 0);
+			break;
+		case 0x0180:
+			if (ea == DnDirect)
+				return (cycleAdd(t, 10, 1, 0));
+			cycleAdd(t, 8, 1, 1);
+			break;
+		default:
+			if (ea == DnDirect)
+				return (cycleAdd(t, 8, 1, 0));
+			cycleAdd(t, 8, 1, 1);
+		}
+		return (cycleEA(t, ea, BYTE_SIZE));
+	}
+	if (ea == DnDirect)             // EOR Dn,Dn
+		return (cycleAdd(t, (isLong) ? 8 : 4, 1, 0));
+	if (isLong)
+		cycleAdd(t, 12, 1, 2);
+	else
+		cycleAdd(t, 8, 1, 1);
+	return (cycleEA(t, ea, size));
+}
+
+// Time the #<data>,<ea> forms built by immedInst() and staticBit()
+static bool cycleImmed(cycleTime &t, bool bit, int word, int size, int ea) {
+	bool isLong = (size == LONG_SIZE);
+
+	if (bit) {                      // BTST, BCHG, BCLR, BSET #n,<ea>
+		switch (word & 0x00C0) {
+		case 0x0000:
+			if (ea == DnDirect)
+				return (cycleAdd(t, 10, 2, 0));
+			cycleAdd(t, 8, 2, 0);
+			break;
+		case 0x0080:
+			if (ea == DnDirect)
+				return (cycleAdd(t, 14, 2, 0));
+			cycleAdd(t, 12, 2, 1);
+			break;
+		default:
+			if (ea == DnDirect)
+				return (cycleAdd(t, 12, 2, 0));
+			cycleAdd(t, 12, 2, 1);
+		}
+		return (cycleEA(t, ea, BYTE_SIZE));
+	}
+	if ((word & 0xFF00) == 0x0C00) {  // CMPI
+		if (ea == DnDirect)
+			return (cycleAdd(t, (isLong) ? 14 : 8, (isLong) ? 3 : 2, 0));
+		cycleAdd(t, (isLong) ? 12 : 8, (isLong) ? 3 : 2, 0);
+		return (cycleEA(t, ea, size));
+	}
+	if (ea == DnDirect)
+		return (cycleAdd(t, (isLong) ? 16 : 8, (isLong) ? 3 : 2, 0));
+	if (isLong)
+		cycleAdd(t, 20, 3, 2);
+	else
+		cycleAdd(t, 12, 2, 1);
+	return (cycleEA(t, ea, size));
+}
+
+// Time the forms built by the other builders
+static bool cycleOther(cycleTime &t, const flavor *flavorPtr, int word,
+		int size, int source, int dest) {
+	bool isLong = (size == LONG_SIZE);
+	int n;
+
+	if (flavorPtr->exec == quickMath) {
+		if (dest == AnDirect)
+			return (cycleAdd(t, 8, 1, 0));
+		if (dest == DnDirect)
+			return (cycleAdd(t, (isLong) ? 8 : 4, 1, 0));
+		if (isLong)
+			cycleAdd(t, 12, 1, 2);
+		else
+			cycleAdd(t, 8, 1, 1);
+		return (cycleEA(t, dest, size));
+	}
+	if (flavorPtr->exec == branch) {
+		switch (word & 0xFF00) {
+		case 0x6000:                  // BRA
+			return (cycleAdd(t, 10, 2, 0));
+		case 0x6100:                  // BSR
+			return (cycleAdd(t, 18, 2, 2));
+		}
+		if (word & 0xFF)              // .S: not taken 8, taken 10
+			return (cycleRange(t, 8, 10, 2, 0));
+		return (cycleRange(t, 10, 12, 2, 0));  // .W: taken 10, not taken 12
+	}
+	if (flavorPtr->exec == dbcc)    // looping, cc true, expired
+		return (cycleRange(t, 10, 14, 3, 0));
+	if (flavorPtr->exec == scc) {
+		if (source == DnDirect)       // false, true
+			return (cycleRange(t, 4, 6, 1, 0));
+		cycleAdd(t, 8, 1, 1);
+		return (cycleEA(t, source, BYTE_SIZE));
+	}
+	if (flavorPtr->exec == shiftReg) {
+		n = (isLong) ? 8 : 6;
+		if (word & 0x0020)            // count in a register, 0 to 63
+			return (cycleRange(t, n, n + 2 * 63, 1, 0));
+		n += 2 * (((word >> 9) & 7) ? (word >> 9) & 7 : 8);
+		return (cycleAdd(t, n, 1, 0));
+	}
+	if (flavorPtr->exec == twoReg) {
+		switch (word & 0xF000) {
+		case 0xB000:                  // CMPM
+			return (cycleAdd(t, (isLong) ? 20 : 12, (isLong) ? 5 : 3, 0));
+		case 0xC000:                  // ABCD
+		case 0x8000:                  // SBCD
+			if (source == DnDirect)
+				return (cycleAdd(t, 6, 1, 0));
+			return (cycleAdd(t, 18, 3, 1));
+		}
+		if (source == DnDirect)       // ADDX, SUBX
+			return (cycleAdd(t, (isLong) ? 8 : 4, 1, 0));
+		if (isLong)
+			return (cycleAdd(t, 30, 5, 2));
+		return (cycleAdd(t, 18, 3, 1));
+	}
+	if (flavorPtr->exec == movep) {
+		if (word & 0x0080)            // register to memory
+			return (cycleAdd(t, (isLong) ? 24 : 16, 2, (isLong) ? 4 : 2));
+		return (cycleAdd(t, (isLong) ? 24 : 16, (isLong) ? 6 : 4, 0));
+	}
+	if (flavorPtr->exec == moveReg) {  // MOVE SR,<ea>
+		if (dest == DnDirect)
+			return (cycleAdd(t, 6, 1, 0));
+		cycleAdd(t, 8, 1, 1);
+		return (cycleEA(t, dest, WORD_SIZE));
+	}
+	if (flavorPtr->exec == zeroOp) {
+		switch (word) {
+		case 0x4E70:                  // RESET
+			return (cycleAdd(t, 132, 1, 0));
+		case 0x4E73:                  // RTE
+		case 0x4E77:                  // RTR
+			return (cycleAdd(t, 20, 5, 0));
+		case 0x4E75:                  // RTS
+			return (cycleAdd(t, 16, 4, 0));
+		case 0x4AFC:                  // ILLEGAL
+			return (cycleAdd(t, 34, 4, 3));
+		}
+		return (cycleAdd(t, 4, 1, 0));  // NOP, TRAPV
+	}
+	if (flavorPtr->exec == immedToCCR || flavorPtr->exec == immedWord) {
+		if (word == 0x4E72)           // STOP
+			return (cycleAdd(t, 4, 0, 0));
+		return (cycleAdd(t, 20, 3, 0));
+	}
+	if (flavorPtr->exec == oneReg) {
+		if ((word & 0xFFF8) == 0x4E58)  // UNLK
+			return (cycleAdd(t, 12, 3, 0));
+		return (cycleAdd(t, 4, 1, 0));  // SWAP, EXT
+	}
+	if (flavorPtr->exec == trap)
+		return (cycleAdd(t, 34, 4, 3));
+	if (flavorPtr->exec == link_ins)
+		return (cycleAdd(t, 16, 2, 2));
+	if (flavorPtr->exec == exg)
+		return (cycleAdd(t, 6, 1, 0));
+	if (flavorPtr->exec == moveq || flavorPtr->exec == moveUSP)
+		return (cycleAdd(t, 4, 1, 0));
+	return (false);                   // no 68000 timing
+}
+
+// Time MOVEM, which has no flavor list. Returns its length in bytes.
+static int cycleMovem(const unsigned char *code, int length, cycleTime &t,
+		bool &timed) {
+	int word = cycleWordAt(code);
+	bool toRegs = (word & 0x0400);
+	bool isLong = (word & 0x0040);
+	int mode = (word >> 3) & 7;
+	int ea = (mode < 7) ? 1 << mode : 0x80 << (word & 7);
+	int n = cycleIndex(ea);
+	int regs;
+
+	timed = false;
+	if (n < 0 || length < 4 + cycleMovemExt[n])
+		return (2);
+	regs = std::popcount((unsigned int) cycleWordAt(code + 2));
+	cycleTable(t, cycleMovemTable[!toRegs], ea);
+	if (toRegs)
+		cycleAdd(t, regs * ((isLong) ? 8 : 4), regs * ((isLong) ? 2 : 1), 0);
+	else
+		cycleAdd(t, regs * ((isLong) ? 8 : 4), 0, regs * ((isLong) ? 2 : 1));
+	timed = true;
+	return (4 + cycleMovemExt[n]);
+}
+
+// Time the instruction at code. Returns its length in bytes.
+static int cycleInst(const unsigned char *code, int length, cycleTime &t,
+		bool &timed) {
+	const flavor *flavorPtr;
+	int size;
+	int source;
+	int dest;
+	int word;
+	int n;
+
+	t = cycleTime();
+	timed = false;
+	if (length < 2)
+		return (length);
+	word = cycleWordAt(code);
+	if ((word & 0xFB80) == 0x4880 && (word & 0x0038) >= 0x0010)
+		return (cycleMovem(code, length, t, timed));
+	n = disasmModes(code, length, &flavorPtr, &size, &source, &dest);
+	if (!flavorPtr)
+		return (n);
+	if (flavorPtr->exec == move) {
+		cycleAdd(t, 4, 1, 0);
+		cycleEA(t, source, size);
+		timed = cycleTable(t, cycleMoveTable[size == LONG_SIZE], dest);
+	} else if (flavorPtr->exec == oneOp)
+		timed = cycleOneOp(t, word, size, source);
+	else if (flavorPtr->exec == arithReg)
+		timed = cycleArithReg(t, code, word, size, source);
+	else if (flavorPtr->exec == arithAddr)
+		timed = cycleArithAddr(t, word, size, dest);
+	else if (flavorPtr->exec == immedInst || flavorPtr->exec == staticBit)
+		timed = cycleImmed(t, flavorPtr->exec == staticBit, word, size, dest);
+	else
+		timed = cycleOther(t, flavorPtr, word, size, source, dest);
+	return (n);
+}
+
+// Add time b to a
+static int cycleSum(cycleTime &a, const cycleTime &b) {
+	cycleRange(a, b.low, b.high, b.reads, b.writes);
+	return (NORMAL);
+}
+
+// Time the instructions output since the last call
+static int cycleFlush() {
+	cycleTime t;
+	bool timed;
+	size_t pos = 0;
+	int n;
+
+	while (pos < cycleBytes.size()) {
+		n = cycleInst(&cycleBytes[pos], cycleBytes.size() - pos, t, timed);
+		hotInst(cycleLoc + pos, &cycleBytes[pos], n, cycleCodeLine, t.high, timed);
+		adviseInst(cycleLoc + pos, cycleSourceLine, &cycleBytes[pos], n);
+		pos += n;
+		if (!CYCLEflag)
+			continue;
+		cycleTotal &total = cycleTotals.back();
+		if (timed) {
+			cycleSum(cycleLineTime, t);
+			cycleSum(total.time, t);
+			cycleLineCount++;
+			total.count++;
+		} else {
+			cycleLineUntimed++;
+			total.untimed++;
+		}
+	}
+	cycleBytes.clear();
+	return (NORMAL);
+}
+
+// Write a time as cycles(reads/writes), with "+?" when some
+// instructions have no timing
+static char* cycleFormat(char *text, const cycleTime &t, int count,
+		int untimed) {
+	if (!count)
+		strcpy(text, "?");
+	else if (t.low == t.high)
+		sprintf(text, "%d(%d/%d)%s", t.low, t.reads, t.writes,
+				(untimed) ? "+?" : "");
+	else
+		sprintf(text, "%d-%d(%d/%d)%s", t.low, t.high, t.reads, t.writes,
+				(untimed) ? "+?" : "");
+	return (text);
+}
+
+//------------------------------------------------------------
+// Returns the most clock cycles of the instruction at code, or -1 if it
+// has no timing, and its length in bytes in *lengthPtr
+int cycleCount(const unsigned char *code, int length, int *lengthPtr) {
+	cycleTime t;
+	bool timed;
+
+	*lengthPtr = cycleInst(code, length, t, timed);
+	return ((timed) ? t.high : -1);
+}
+
+//------------------------------------------------------------
+// Called by assemble() at the start of each line
+int cycleLine() {
+	if (!pass2)
+		return (NORMAL);
+	cycleFlush();
+	cycleLineTime = cycleTime();
+	cycleLineCount = cycleLineUntimed = 0;
+	cycleInCode = false;
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Called before an instruction is output
+int cycleCode() {
+	cycleTotal total;
+
+	if (!pass2 || (!CYCLEflag && !HOTflag && !ADVISEflag))
+		return (NORMAL);
+	cycleFlush();
+	cycleInCode = true;
+	cycleLoc = loc;
+	cycleCodeLine = lineNumL68;
+	cycleSourceLine = lineNum;
+	if (CYCLEflag && cycleTotals.empty()) {  // code above the first label
+		total.line = lineNumL68;
+		total.loc = loc;
+		total.count = total.untimed = 0;
+		total.time = cycleTime();
+		cycleTotals.push_back(total);
+	}
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Called from output() in pass 2
+int cycleWord(int data, int size) {
+	if (!cycleInCode || (!CYCLEflag && !HOTflag && !ADVISEflag))
+		return (NORMAL);
+	for (int shift = (size - 1) * 8; shift >= 0; shift -= 8)
+		cycleBytes.push_back((data >> shift) & 0xFF);
+	return (NORMAL);
+}
+
+// true for a label made by structured code, _0X and 8 hex digits
+static bool cycleStructured(const char *sym) {
+	if (strncmp(sym, "_0X", 3) || strlen(sym) != 11)
+		return (false);
+	for (int i = 3; i < 11; i++)
+		if (!isxdigit(sym[i]))
+			return (false);
+	return (true);
+}
+
+//------------------------------------------------------------
+// Called by define() in pass 2
+int cycleLabel(const char *sym, int value) {
+	cycleTotal total;
+
+	if (!pass2 || *sym == '.' || strchr(sym, ':') || value != loc
+			|| cycleStructured(sym))
+		return (NORMAL);
+	hotLabel(sym, value);
+	if (!CYCLEflag)
+		return (NORMAL);
+	cycleFlush();
+	total.label = sym;
+	total.line = lineNumL68;
+	total.loc = loc;
+	total.count = total.untimed = 0;
+	total.time = cycleTime();
+	cycleTotals.push_back(total);
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Called by listLine(). Returns the cycle column of the line, empty if
+// there is no code. split is true when OPT CEX continues the line.
+const char* cycleField(bool split) {
+	if (split)
+		return ("");
+	cycleFlush();
+	if (!cycleLineCount && !cycleLineUntimed)
+		return ("");
+	return (cycleFormat(cycleText, cycleLineTime, cycleLineCount,
+			cycleLineUntimed));
+}
+
+//------------------------------------------------------------
+// Write the subtotal of each label to the listing
+int cycleList(FILE *listFile) {
+	cycleTime sum = cycleTime();
+	int count = 0;
+	int untimed = 0;
+	char text[48];
+
+	cycleFlush();
+	if (cycleTotals.empty())
+		return (NORMAL);
+	for (size_t i = 0; i < cycleTotals.size(); i++) {
+		cycleSum(sum, cycleTotals[i].time);
+		count += cycleTotals[i].count;
+		untimed += cycleTotals[i].untimed;
+	}
+	fprintf(listFile, "Cycles: %d instruction%s timed, %s clock cycles\n",
+			count, (count != 1) ? "s" : "", cycleFormat(text, sum, count, untimed));
+	fprintf(listFile, "\n\nCYCLE COUNT INFORMATION\n");
+	fprintf(listFile, "Line    Address   Count  Cycles(R/W)       Label\n");
+	fprintf(listFile, "-----------------------------------------------\n");
+	for (size_t i = 0; i < cycleTotals.size(); i++) {
+		cycleTotal &total = cycleTotals[i];
+		if (!total.count && !total.untimed)
+			continue;
+		fprintf(listFile, "%6d  %08X  %5d  %-16s  %s\n", total.line, total.loc,
+				total.count + total.untimed,
+				cycleFormat(text, total.time, total.count, total.untimed),
+				(total.label.empty()) ? "*" : total.label.c_str());
+	}
+	return (NORMAL);
+}
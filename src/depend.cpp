@@ -0,0 +1,652 @@
+/***********************************************************************
+ *
+ *		DEPEND.CPP
+ *		Line Dependency Tracking for 68000 Assembler
+ *
+ *    Function: depBeginLine(), depEndLine()
+ *		Called by processFile() around each source line during
+ *		pass 2. Every line gets a record holding the source
+ *		line span it consumed, the address range it produced,
+ *		the symbols it defined and used, its object output and
+ *		the position of its text in the listing file.
+ *
+ *		depAssemble()
+ *		Called by assembleFile() before a full assembly. If the
+ *		same source, the same included files and the same
+ *		options were assembled last time, the changed lines are
+ *		found by comparing line hashes and re-encoded. A line
+ *		that grows or shrinks moves the lines after it and the
+ *		labels they define. Every line that uses a label whose
+ *		value changed is re-encoded too, as is every moved line
+ *		that uses a symbol or the location counter (* or a PC
+ *		relative operand), until no value changes. The listing
+ *		is patched in place and the saved object output is
+ *		written to the S-Record file opened by the caller, also
+ *		when no line changed. A line that has to be
+ *		re-encoded or moved must be an instruction, a label or
+ *		DC, DCB, DS or END; in every other case the function
+ *		returns false and a full assembly is done.
+ *
+ ************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include "../include/asm.h"
+#include "../include/assemble.h"
+#include "../include/cache.h"
+#include "../include/object.h"
+#include "../include/symbol.h"
+#include "../include/depend.h"
+#include "../include/relax.h"
+
+extern thread_local int loc;
+extern bool pass2;
+extern bool offsetMode;
+extern bool continuation;
+extern bool objFlag;
+extern char line[256];
+extern int lineNum;
+extern int lineNumL68;
+extern char globalLabel[SIGCHARS + 1];
+extern int errorCount;
+extern int warningCount;
+extern unsigned int startAddress;
+extern FILE *listFile;
+extern bool createdL68;         // true when L68 (listing) file is created
+extern char listName[256];      // name of listing file
+extern bool listFlag;           // option flags that change the output
+extern bool CEXflag;
+extern bool BITflag;
+extern bool CREflag;
+extern bool MEXflag;
+extern bool SEXflag;
+extern bool WARflag;
+extern bool LOOPflag;
+extern bool UNROLLflag;
+extern int unrollBudget;
+extern bool RELAXflag;          // true shortens forward branches
+extern bool EAOPTflag;          // true picks the shortest addressing modes
+extern bool PEEPflag;           // true replaces slow instruction forms
+extern bool CHAINflag;          // true collapses structured branch chains
+extern bool CYCLEflag;          // true lists clock cycles of instructions
+extern bool HOTflag;            // true ranks the costliest loops and subroutines
+extern bool ADVISEflag;         // true lists faster forms of instructions
+
+extern bool skipList;           // true to skip listing line
+extern bool skipCond;           // true conditionally skips lines
+extern bool printCond;          // true to print condition on listing line
+extern bool skipCreateCode;     // true to skip calling createCode
+extern int nestLevel;           // nesting level of conditional directives
+
+struct objData {
+	int addr;
+	int data;
+	int size;
+};
+
+struct lineDep {
+	int first;                    // first source line of this record
+	int last;                     // last source line (macro definitions span lines)
+	int startLoc;                 // loc before the line
+	int endLoc;                   // loc after the line
+	int error;                    // error code from assemble()
+	int instCount;                // instructions assembled for this line
+	int dirCount;                 // directives executed for this line
+	bool fixed;                   // a directive other than DC, DCB, DS or END
+	bool blocked;                 // line depends on conditional assembly state
+	bool setUse;                  // line uses a SET symbol
+	long listStart;               // listing file offset of line text
+	long listEnd;
+	int listLine;                 // first listing line number
+	int listCount;                // number of listing lines written
+	char globalLabel[SIGCHARS + 1]; // for local labels
+	std::vector<std::string> defs;  // symbols defined by the line
+	std::vector<std::string> uses;  // symbols used by the line
+	std::vector<objData> obj;       // object output of the line
+};
+
+static std::vector<lineDep> depLines;   // records from last pass 2
+static std::vector<unsigned int> depHash; // hash of each source line
+static std::string depFile;             // source file of the records
+static long depListSize;                // size of listing file
+static std::string depKey;              // options of the records
+static std::vector<std::string> depIncludes; // files included in pass 2
+static std::vector<std::pair<std::string, unsigned int> > depFiles; // and their hashes
+static int depErrors;                   // error and warning counts
+static int depWarnings;
+static bool depValid = false;           // records describe a full assembly
+static bool depReplay = false;          // true while re-encoding a line
+static lineDep depScratch;              // record of a re-encoded line
+static lineDep *cur = NULL;             // record of the current line
+
+const int DEP_ROUNDS = 4;         // most passes over the records for one edit
+
+//------------------------------------------------------------
+// FNV-1a hash of a source line
+static unsigned int depLineHash(const char *s) {
+	unsigned int h = 2166136261u;
+	while (*s) {
+		h ^= (unsigned char) *s++;
+		h *= 16777619u;
+	}
+	return (h);
+}
+
+// Read the source file the way processFile() does
+static bool depReadSource(const char *fileName, std::vector<std::string> &lines) {
+	char text[256];
+	FILE *f = fopen(fileName, "r");
+	if (!f)
+		return (false);
+	while (fgets(text, 256, f))
+		lines.push_back(text);
+	fclose(f);
+	return (true);
+}
+
+static long depFileSize(const char *name) {
+	long size;
+	FILE *f = fopen(name, "rb");
+	if (!f)
+		return (-1);
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fclose(f);
+	return (size);
+}
+
+// FNV-1a hash of a whole file, false if it cannot be read
+static bool depFileHash(const char *name, unsigned int *hashPtr) {
+	unsigned int h = 2166136261u;
+	int c;
+	FILE *f = fopen(name, "rb");
+	if (!f)
+		return (false);
+	while ((c = getc(f)) != EOF) {
+		h ^= (unsigned char) c;
+		h *= 16777619u;
+	}
+	fclose(f);
+	*hashPtr = h;
+	return (true);
+}
+
+// Options that change the code or the listing
+static std::string depOptions() {
+	char text[64];
+	sprintf(text, "%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d %d", listFlag, objFlag,
+			CEXflag, BITflag, CREflag, MEXflag, SEXflag, WARflag, RELAXflag,
+			EAOPTflag, PEEPflag, CHAINflag, LOOPflag, UNROLLflag, CYCLEflag,
+			HOTflag, ADVISEflag, unrollBudget);
+	return (text);
+}
+
+// true if the line may be re-encoded or moved by itself
+static bool depSimple(lineDep *d) {
+	return (!d->blocked && !d->setUse && d->instCount <= 1 && !d->fixed
+			&& d->first == d->last && d->error == OK);
+}
+
+// Add delta to the addresses at the start of the listing lines in text
+static void depMoveText(std::string &text, int delta) {
+	char addr[16];
+	size_t pos = 0;
+	size_t i;
+
+	while (pos + 8 <= text.size()) {
+		for (i = 0; i < 8 && isxdigit((unsigned char) text[pos + i]); i++)
+			;
+		if (i == 8) {
+			sprintf(addr, "%08X",
+					(unsigned int) strtoul(text.substr(pos, 8).c_str(), NULL, 16) + delta);
+			text.replace(pos, 8, addr);
+		}
+		pos = text.find('\n', pos);
+		if (pos == std::string::npos)
+			break;
+		pos++;
+	}
+}
+
+//------------------------------------------------------------
+// Forget everything, called before a full assembly
+int depClear() {
+	depLines.clear();
+	depHash.clear();
+	depFile.clear();
+	depIncludes.clear();
+	depFiles.clear();
+	depKey = depOptions();
+	depValid = false;
+	cur = NULL;
+	return (NORMAL);
+}
+
+// Start the record of a pass 2 source line
+int depBeginLine() {
+	if (depReplay) {
+		depScratch = lineDep();
+		cur = &depScratch;
+	} else {
+		depLines.emplace_back();
+		cur = &depLines.back();
+	}
+	cur->first = lineNum;
+	cur->startLoc = loc;
+	cur->error = OK;
+	cur->instCount = cur->dirCount = 0;
+	cur->fixed = false;
+	cur->blocked = skipCond || nestLevel > 0;
+	cur->setUse = false;
+	cur->listStart = (createdL68) ? ftell(listFile) : 0;
+	cur->listLine = lineNumL68;
+	strncpy(cur->globalLabel, globalLabel, SIGCHARS);
+	cur->globalLabel[SIGCHARS] = '\0';
+	return (NORMAL);
+}
+
+int depEndLine(int error) {
+	if (!cur)
+		return (NORMAL);
+	cur->last = lineNum;
+	cur->endLoc = loc;
+	cur->error = error;
+	cur->listEnd = (createdL68) ? ftell(listFile) : 0;
+	cur->listCount = lineNumL68 - cur->listLine;
+	cur = NULL;
+	return (NORMAL);
+}
+
+int depDefine(const char *sym) {
+	if (cur)
+		cur->defs.push_back(sym);
+	return (NORMAL);
+}
+
+int depUse(const char *sym, bool redefinable) {
+	if (cur) {
+		cur->uses.push_back(sym);
+		if (redefinable)
+			cur->setUse = true;
+	}
+	return (NORMAL);
+}
+
+// Called for every use of the location counter, by * or a PC relative
+// operand. The line is kept for replay with the use, as for a symbol.
+int depUseLoc() {
+	if (pass2)
+		depUse(DEP_LOC, false);
+	else
+		cacheUse(DEP_LOC);
+	return (NORMAL);
+}
+
+int depObject(int addr, int data, int size) {
+	if (cur && !offsetMode)
+		cur->obj.push_back( { addr, data, size });
+	return (NORMAL);
+}
+
+int depInstruction() {
+	if (cur)
+		cur->instCount++;
+	return (NORMAL);
+}
+
+// Called for every directive with its mnemonic
+int depDirective(const char *mnemonic) {
+	if (cur) {
+		cur->dirCount++;
+		if (strcmp(mnemonic, "DC") && strcmp(mnemonic, "DCB")
+				&& strcmp(mnemonic, "DS") && strcmp(mnemonic, "END"))
+			cur->fixed = true;          // may change loc or define a value
+	}
+	return (NORMAL);
+}
+
+// Called in pass 2 for every file read by INCLUDE or INCBIN
+int depInclude(const char *fileName) {
+	depIncludes.push_back(fileName);
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Called after a full assembly of fileName completed
+int depFinish(const char *fileName) {
+	std::vector<std::string> lines;
+
+	depHash.clear();
+	depValid = false;
+	if (!depReadSource(fileName, lines))
+		return (MILD_ERROR);
+	for (size_t i = 0; i < lines.size(); i++)
+		depHash.push_back(depLineHash(lines[i].c_str()));
+	depFiles.clear();
+	for (size_t i = 0; i < depIncludes.size(); i++) {
+		unsigned int h;
+		if (!depFileHash(depIncludes[i].c_str(), &h))
+			return (MILD_ERROR);
+		depFiles.push_back(std::make_pair(depIncludes[i], h));
+	}
+	depFile = fileName;
+	depErrors = errorCount;
+	depWarnings = warningCount;
+	depListSize = (createdL68) ? depFileSize(listName) : -1;
+	depValid = true;
+	return (NORMAL);
+}
+
+
+//------------------------------------------------------------
+// Re-encode record r at address start. The new record is left in
+// depScratch and its listing in text. Returns false if the line no
+// longer fits its record.
+static bool depEncode(const std::vector<std::string> &lines, int r, int start,
+		std::string &text) {
+	lineDep *old = &depLines[r];
+	int error = OK;
+	bool ok = true;
+
+	if (createdL68 && !(listFile = tmpfile()))
+		return (false);
+	strcpy(line, lines[old->first - 1].c_str());
+	loc = start;
+	lineNum = old->first;
+	lineNumL68 = old->listLine;
+	strcpy(globalLabel, old->globalLabel);
+	continuation = false;
+	skipList = false;
+	printCond = false;
+	skipCreateCode = false;
+
+	depReplay = true;
+	depBeginLine();
+	assemble(line, &error);
+	depEndLine(error);
+	depReplay = false;
+
+	text.clear();
+	if (createdL68) {
+		long n = ftell(listFile);
+		if (n > 0) {
+			text.resize(n);
+			rewind(listFile);
+			ok = (fread(&text[0], 1, n, listFile) == (size_t) n);
+		}
+		fclose(listFile);
+	}
+	return (ok && depSimple(&depScratch) && depScratch.defs == old->defs
+			&& depScratch.listCount == old->listCount);
+}
+
+//------------------------------------------------------------
+// Try to bring the last assembly of fileName up to date by re-encoding
+// only the lines that changed and the lines that use what they
+// define. Returns true if that was possible.
+bool depAssemble(const char *fileName) {
+	std::vector<std::string> lines;
+	std::vector<int> owner;
+	std::set<int> work;                 // records to re-encode
+	std::vector<std::string> texts;     // new listing of each record
+	std::vector<bool> textSet;
+	std::vector<std::vector<symbolDef*> > syms; // symbols defined by each record
+	std::vector<std::pair<symbolDef*, int> > flagSave;
+	std::map<std::string, int> defRec;  // record that defines each symbol
+	std::string oldText;
+	bool changed = false;               // a label has a new value
+	bool ok = true;
+	int round;
+
+	try {
+		if (!depValid || depFile != fileName || RELAXflag || EAOPTflag || PEEPflag
+				|| CHAINflag)                 // sizes may change
+			return (false);
+		if (CYCLEflag || HOTflag || ADVISEflag) // listings of every line
+			return (false);
+		if (depOptions() != depKey)
+			return (false);
+		for (size_t i = 0; i < depFiles.size(); i++) {  // INCLUDE and INCBIN files
+			unsigned int h;
+			if (!depFileHash(depFiles[i].first.c_str(), &h) || h != depFiles[i].second)
+				return (false);
+		}
+		if (!depReadSource(fileName, lines) || lines.size() != depHash.size())
+			return (false);
+		if (createdL68 && depFileSize(listName) != depListSize)
+			return (false);
+
+		// find the record that assembled each source line
+		owner.assign(lines.size() + 2, -1);
+		for (size_t r = 0; r < depLines.size(); r++)
+			for (int n = depLines[r].first; n <= depLines[r].last && n <= (int) lines.size(); n++)
+				owner[n] = r;
+
+		// changed lines must be plain instructions, labels or data
+		for (size_t i = 0; i < lines.size(); i++) {
+			if (depLineHash(lines[i].c_str()) == depHash[i])
+				continue;
+			int r = owner[i + 1];
+			if (r < 0 || !depSimple(&depLines[r]))
+				return (false);
+			work.insert(r);
+		}
+		if (createdL68) {
+			FILE *f = fopen(listName, "rb");
+			if (!f)
+				return (false);
+			oldText.resize(depListSize);
+			if (depListSize > 0 && fread(&oldText[0], 1, depListSize, f) != (size_t) depListSize) {
+				fclose(f);
+				return (false);
+			}
+			fclose(f);
+		}
+		texts.resize(depLines.size());
+		textSet.assign(depLines.size(), false);
+
+		int locSave = loc;
+		int lineNumSave = lineNum;
+		int lineNumL68Save = lineNumL68;
+		bool pass2Save = pass2;
+		bool objFlagSave = objFlag;
+		FILE *listFileSave = listFile;
+		char globalLabelSave[SIGCHARS + 1];
+		strcpy(globalLabelSave, globalLabel);
+
+		// symbols defined by each record, local labels after its global label
+		syms.resize(depLines.size());
+		for (size_t r = 0; r < depLines.size() && ok; r++) {
+			strcpy(globalLabel, depLines[r].globalLabel);
+			for (size_t s = 0; s < depLines[r].defs.size(); s++) {
+				int status = OK;
+				char name[SIGCHARS + 1];
+				strncpy(name, depLines[r].defs[s].c_str(), SIGCHARS);
+				name[SIGCHARS] = '\0';
+				symbolDef *sym = lookup(name, false, &status);
+				if (status != OK) {
+					ok = false;
+					break;
+				}
+				syms[r].push_back(sym);
+				flagSave.push_back(std::make_pair(sym, sym->flags));
+				defRec.insert(std::make_pair(depLines[r].defs[s], (int) r));
+			}
+		}
+
+		pass2 = true;
+		objFlag = false;                // object file is rewritten below
+		for (round = 0; ok && !work.empty(); round++) {
+			std::set<std::string> moved;  // labels given a new value in this round
+			std::vector<bool> encoded(depLines.size(), false);
+			int delta = 0;                // growth of the lines above
+
+			if (round == DEP_ROUNDS) {
+				ok = false;
+				break;
+			}
+			// symbols defined below a line are forward references to it
+			for (size_t s = 0; s < flagSave.size(); s++)
+				flagSave[s].first->flags &= ~BACKREF;
+			for (size_t r = 0; r < depLines.size(); r++) {
+				lineDep *rec = &depLines[r];
+				bool need = work.count(r) || (delta && !rec->uses.empty());
+
+				if ((need || delta) && !depSimple(rec)) {
+					ok = false;
+					break;
+				}
+				if (delta)
+					for (size_t s = 0; s < syms[r].size(); s++) {
+						syms[r][s]->value += delta;
+						moved.insert(rec->defs[s]);
+					}
+				if (need) {
+					std::string text;
+					int start = rec->startLoc + delta;
+					if (!depEncode(lines, r, start, text)) {
+						ok = false;
+						break;
+					}
+					delta += (depScratch.endLoc - start) - (rec->endLoc - rec->startLoc);
+					rec->startLoc = start;
+					rec->endLoc = depScratch.endLoc;
+					rec->uses = depScratch.uses;
+					rec->obj = depScratch.obj;
+					rec->instCount = depScratch.instCount;
+					texts[r] = text;
+					textSet[r] = true;
+					encoded[r] = true;
+					if (delta & 1) {            // word alignment below would change
+						ok = false;
+						break;
+					}
+				} else if (delta) {
+					rec->startLoc += delta;
+					rec->endLoc += delta;
+					for (size_t i = 0; i < rec->obj.size(); i++)
+						rec->obj[i].addr += delta;
+					if (createdL68) {
+						if (!textSet[r])
+							texts[r] = oldText.substr(rec->listStart, rec->listEnd - rec->listStart);
+						textSet[r] = true;
+						depMoveText(texts[r], delta);
+					}
+				}
+				for (size_t s = 0; s < syms[r].size(); s++)
+					syms[r][s]->flags |= BACKREF;
+			}
+
+			// lines that used a label before its new value was known
+			work.clear();
+			if (!moved.empty())
+				changed = true;
+			for (size_t r = 0; r < depLines.size() && ok; r++)
+				for (size_t u = 0; u < depLines[r].uses.size(); u++)
+					if (moved.count(depLines[r].uses[u])
+							&& (!encoded[r] || defRec[depLines[r].uses[u]] > (int) r)) {
+						work.insert(r);
+						break;
+					}
+		}
+
+		for (size_t s = 0; s < flagSave.size(); s++)
+			flagSave[s].first->flags = flagSave[s].second;
+		loc = locSave;
+		lineNum = lineNumSave;
+		lineNumL68 = lineNumL68Save;
+		pass2 = pass2Save;
+		objFlag = objFlagSave;
+		listFile = listFileSave;
+		strcpy(globalLabel, globalLabelSave);
+		if (!ok)
+			return (false);
+
+		// patch the listing
+		if (createdL68) {
+			std::string newText;
+			std::string tail;
+			char addr[16];
+			long pos = 0;
+			for (size_t r = 0; r < depLines.size(); r++) {
+				lineDep *rec = &depLines[r];
+				long start = rec->listStart;
+				long end = rec->listEnd;
+				newText.append(oldText, pos, start - pos);
+				rec->listStart = newText.size();
+				if (textSet[r])
+					newText.append(texts[r]);
+				else
+					newText.append(oldText, start, end - start);
+				rec->listEnd = newText.size();
+				pos = end;
+			}
+			tail = oldText.substr(pos);
+
+			// symbol table with the new label values
+			size_t at = tail.find("\n\nSYMBOL TABLE INFORMATION\n");
+			if (changed && CREflag && at != std::string::npos) {
+				std::string table;
+				FILE *f = tmpfile();
+				if (!f)
+					return (false);
+				listFile = f;
+				optCRE();
+				listFile = listFileSave;
+				long n = ftell(f);
+				if (n > 0) {
+					table.resize(n);
+					rewind(f);
+					if (fread(&table[0], 1, n, f) != (size_t) n) {
+						fclose(f);
+						return (false);
+					}
+				}
+				fclose(f);
+				tail.replace(at, std::string::npos, table);
+			}
+			newText.append(tail);
+			if (newText.size() >= 8) {      // starting address, as finishList() writes it
+				sprintf(addr, "%08X", startAddress);
+				newText.replace(0, 8, addr);
+			}
+
+			FILE *f = fopen(listName, "wb");
+			if (!f)
+				return (false);
+			fwrite(newText.data(), 1, newText.size(), f);
+			fclose(f);
+			depListSize = newText.size();
+		}
+
+		for (size_t i = 0; i < lines.size(); i++)
+			depHash[i] = depLineHash(lines[i].c_str());
+		errorCount = depErrors;
+		warningCount = depWarnings;
+
+		// write the saved object output to the S-Record file the caller
+		// opened with initObj()
+		if (objFlag) {
+			bool offsetSave = offsetMode;
+			offsetMode = false;
+			for (size_t r = 0; r < depLines.size(); r++)
+				for (size_t i = 0; i < depLines[r].obj.size(); i++)
+					outputObj(depLines[r].obj[i].addr, depLines[r].obj[i].data,
+							depLines[r].obj[i].size);
+			finishObj();
+			offsetMode = offsetSave;
+		}
+	} catch (...) {
+		depReplay = false;
+		depValid = false;
+		return (false);
+	}
+
+	return (true);
+}
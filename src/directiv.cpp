@@ -45,8 +45,11 @@
 #include "../include/codegen.h"
 #include "../include/symbol.h"
 #include "../include/object.h"
+#include "../include/equate.h"
+#include "../include/depend.h"
+#include "../include/unroll.h"
 
-extern int loc;
+extern thread_local int loc;
 extern int locOffset;
 extern int sectionLoc[16];     // section locations
 extern int sectI;              // current section
@@ -68,6 +71,17 @@ extern bool SEXflag;    // true expands structured code
 extern bool WARflag;    // true displays warnings
 extern bool CEXflag;    // true expands constants
 extern bool BITflag;    // True to assemble bitfield instructions
+extern bool PIPEflag;   // true reads and lexes source on separate threads
+extern bool RELAXflag;  // true shortens forward branches
+extern bool EAOPTflag;  // true picks the shortest addressing modes
+extern bool PEEPflag;   // true replaces slow instruction forms
+extern bool CHAINflag;  // true collapses structured branch chains
+extern bool LOOPflag;   // true tests structured loops at the bottom
+extern bool UNROLLflag; // true unrolls FOR loops with constant bounds
+extern int unrollBudget; // most instructions of an unrolled FOR
+extern bool CYCLEflag;  // true lists clock cycles of instructions
+extern bool HOTflag;    // true ranks the costliest loops and subroutines
+extern bool ADVISEflag; // true lists faster forms of instructions
 extern bool objFlag;	// True if an object code file is desired
 extern int includeNestLevel;    // count nested include directives
 extern char includeFile[LINE_LENGTH];  // name of current include file
@@ -114,6 +128,7 @@ int org(int size, char *label, char *op, int *errorPtr) {
 	op = eval(op, &newLoc, &backRef, errorPtr);
 	if (*errorPtr < SEVERE && !backRef) {
 		NEWERROR(*errorPtr, INV_FORWARD_REF);
+		equRefuse();                // an EQU below may define it
 	} else if (*errorPtr < ERRORN) {
 		if (isspace(*op) || !*op) {
 			// Check for an odd value, adjust to one higher
@@ -152,6 +167,7 @@ int section(int size, char *label, char *op, int *errorPtr) {
 		eval(op, &value, &backRef, errorPtr);    // evaluate section number
 		if (*errorPtr < SEVERE && !backRef) {
 			NEWERROR(*errorPtr, INV_FORWARD_REF);
+			equRefuse();              // an EQU below may define it
 		} else if (*errorPtr < ERRORN) {
 			if (value < 0 || value > 15) {          // if illegal section number
 				NEWERROR(*errorPtr, SYNTAX);
@@ -191,6 +207,7 @@ int offset(int size, char *label, char *op, int *errorPtr) {
 	op = eval(op, &newLoc, &backRef, errorPtr);
 	if (*errorPtr < SEVERE && !backRef) {
 		NEWERROR(*errorPtr, INV_FORWARD_REF);
+		equRefuse();                // an EQU below may define it
 	} else if (*errorPtr < ERRORN) {
 		if (isspace(*op) || !*op) {
 			if (!offsetMode) { // if not currently processing an Offset directive
@@ -254,6 +271,7 @@ int equ(int size, char *label, char *op, int *errorPtr) {
 	int value;
 	bool backRef;
 	char *op1;
+	symbolDef *symbol;
 
 	if (size)
 		NEWERROR(*errorPtr, INV_SIZE_CODE);
@@ -262,21 +280,25 @@ int equ(int size, char *label, char *op, int *errorPtr) {
 		return (NORMAL);
 	}
 
+	op1 = op;
 	op = eval(op, &value, &backRef, errorPtr);
-	if (*errorPtr < SEVERE && !backRef) {
+	// forward references are resolved later by the EQU dependency graph
+	if (*errorPtr < SEVERE && !backRef && !equLazy(label, errorPtr)) {
 		NEWERROR(*errorPtr, INV_FORWARD_REF);
 	} else if (*errorPtr < ERRORN)
-		if (isspace(*op) || !*op)
+		if (isspace(*op) || !*op) {
 			if (!*label) {
 				NEWERROR(*errorPtr, LABEL_REQUIRED);
-			} else {
-				define(label, value, pass2, true, errorPtr);
+			} else if (equRecord(label, op1, op, backRef)) {
+				symbol = define(label, value, pass2, true, errorPtr);
+				if (pass2 && !backRef && *errorPtr < ERRORN)
+					symbol->flags &= ~BACKREF;  // later uses ask equBackRef()
 				if (pass2 && listFlag && *errorPtr < MINOR) {
 					sprintf(listPtr, "=%08lX ", value);
 					listPtr += 10;
 				}
 			}
-		else
+		} else
 			NEWERROR(*errorPtr, SYNTAX);
 
 	return (NORMAL);
@@ -549,6 +571,8 @@ int ds(int size, char *label, char *op, int *errorPtr) {
 
 int opt(int size, char *label, char *op, int *errorPtr) {
 	int i;
+	int value;
+	bool backRef;
 	const int OPTCHARS = 8;       // max number of characters in OPT operand
 	char option[OPTCHARS + 1];
 	bool done = false;
@@ -576,6 +600,17 @@ int opt(int size, char *label, char *op, int *errorPtr) {
 			op++;
 		} while (isalnum(*op));
 		option[i] = '\0';             // end option string with null
+		if (*op == '=' && strcmp(option, "UNROLL") == 0) { // UNROLL=n
+			op = eval(op + 1, &value, &backRef, errorPtr);
+			if (*errorPtr > SEVERE)
+				return (NORMAL);
+			if (!backRef)
+				NEWERROR(*errorPtr, INV_FORWARD_REF);
+			else if (value < 1)
+				NEWERROR(*errorPtr, INV_UNROLL_BUDGET);
+			else
+				unrollBudget = value;     // most instructions of an unrolled FOR
+		}
 		op = skipSpace(op);           // skip spaces
 		if (*op == ',') {
 			op++;                       // skip comma between options
@@ -606,7 +641,47 @@ int opt(int size, char *label, char *op, int *errorPtr) {
 			if (pass2 && listFlag) {
 				listLine("*[sim68k]bitfield\n"); // enables bit field support in Sim68K
 			}
-		} else
+		} else if (strcmp(option, "PIPE") == 0)
+			PIPEflag = true;            // pipeline read and lex from next pass
+		else if (strcmp(option, "NOPIPE") == 0)
+			PIPEflag = false;           // read and lex on the assembler thread
+		else if (strcmp(option, "RELAX") == 0)
+			RELAXflag = true;           // shorten forward branches
+		else if (strcmp(option, "NORELAX") == 0)
+			RELAXflag = false;          // forward branches stay long
+		else if (strcmp(option, "EAOPT") == 0)
+			EAOPTflag = true;           // shortest addressing modes
+		else if (strcmp(option, "NOEAOPT") == 0)
+			EAOPTflag = false;          // addressing modes as written
+		else if (strcmp(option, "PEEP") == 0)
+			PEEPflag = true;            // peephole optimizer
+		else if (strcmp(option, "NOPEEP") == 0)
+			PEEPflag = false;           // instructions as written
+		else if (strcmp(option, "CHAIN") == 0)
+			CHAINflag = true;           // collapse structured branch chains
+		else if (strcmp(option, "NOCHAIN") == 0)
+			CHAINflag = false;          // structured branches as generated
+		else if (strcmp(option, "LOOP") == 0)
+			LOOPflag = true;            // structured loops tested at the bottom
+		else if (strcmp(option, "NOLOOP") == 0)
+			LOOPflag = false;           // structured loops tested at the top
+		else if (strcmp(option, "UNROLL") == 0)
+			UNROLLflag = true;          // unroll FOR loops with constant bounds
+		else if (strcmp(option, "NOUNROLL") == 0)
+			UNROLLflag = false;         // FOR loops as written
+		else if (strcmp(option, "CYCLES") == 0)
+			CYCLEflag = true;           // clock cycles in the listing
+		else if (strcmp(option, "NOCYCLES") == 0)
+			CYCLEflag = false;          // no clock cycles
+		else if (strcmp(option, "HOT") == 0)
+			HOTflag = true;             // rank loops and subroutines by cycles
+		else if (strcmp(option, "NOHOT") == 0)
+			HOTflag = false;            // no loop analysis
+		else if (strcmp(option, "ADVISE") == 0)
+			ADVISEflag = true;          // list faster forms of instructions
+		else if (strcmp(option, "NOADVISE") == 0)
+			ADVISEflag = false;         // no performance advice
+		else
 			NEWERROR(*errorPtr, SYNTAX);
 	}
 	return (NORMAL);
@@ -685,6 +760,8 @@ int include(int size, char *label, char *fileName, int *errorPtr) {
 			NEWERROR(*errorPtr, FILE_ERROR);            // error, invalid syntax
 			return (SEVERE);
 		}
+		if (pass2)
+			depInclude(capLine);           // changes to it need a full assembly
 		tmpInFile = inFile;                 // save current input file
 		inFile = incFile;                 // make include file input file
 		strcpy(fileNameSave, includeFile);          // save current include file
@@ -708,6 +785,7 @@ int include(int size, char *label, char *fileName, int *errorPtr) {
 		// assemble each line of the include file
 		// until END directive or EOF
 		includeNestLevel++;	// count nest level of include directive
+		unrollEnter(UNROLL_INCLUDE);	// a REPT in the file reads its lines
 		lineNum = 1;
 		while (!endFlag && fgets(line, 256, inFile)) {
 			error = OK;
@@ -719,6 +797,7 @@ int include(int size, char *label, char *fileName, int *errorPtr) {
 				assemble(line, &error);
 			lineNum++;
 		}
+		unrollLeave();
 		fclose(inFile);
 		inFile = tmpInFile;                 // restore previous input file
 		strcpy(includeFile, fileNameSave);   // restore previous include file
@@ -802,6 +881,8 @@ int incbin(int size, char *label, char *fileName, int *errorPtr) {
 			NEWERROR(*errorPtr, FILE_ERROR);     // error, invalid syntax
 			return (SEVERE);
 		}
+		if (pass2)
+			depInclude(capLine);           // changes to it need a full assembly
 
 		// loop through every byte of incbin file
 		// read 1 byte of data from file
@@ -0,0 +1,791 @@
+/***********************************************************************
+ *
+ *		DISASM.CPP
+ *		Table Driven Disassembler for 68000 Code
+ *
+ *    Function: disasmStart()
+ *		Builds the decode table the first time it is called.
+ *		For every instruction of opcodeTable[], each of its
+ *		flavors and each size the flavor allows, the operand
+ *		fields the builder of the flavor fills in are set to
+ *		every value the addressing modes of the flavor allow.
+ *		Each of the 65536 first words of an instruction maps
+ *		to the first instruction, flavor and size that can
+ *		output it, in the order the assembler searches them.
+ *
+ *		disasmInst()
+ *		Writes the instruction at code as text and returns its
+ *		length in bytes. The first word gives the flavor from
+ *		the decode table; the operands are read back from the
+ *		fields and the extension words the builder outputs. A
+ *		word that no flavor outputs, or an instruction cut off
+ *		by the end of the code, is written as DC.W.
+ *
+ *		disasmModes()
+ *		Returns the length of the instruction at code with its
+ *		flavor, size and operand addressing modes, for the
+ *		cycle counts of the listing.
+ *
+ *		disasmImage()
+ *		Writes the instructions of a memory image to a file,
+ *		one per line with the address and the code words.
+ *
+ *		disasmSRec()
+ *		Reads the S1, S2 and S3 records of an S-record file and
+ *		writes each block of consecutive addresses with
+ *		disasmImage(). Records with a bad checksum are left
+ *		out.
+ *
+ *		MOVEM, which has no flavor list, is decoded with its
+ *		register list word. The other instructions with no
+ *		flavor list, such as MOVEC and MOVES, are written as
+ *		DC.W.
+ *
+ *	 Usage: disasmInst(code, length, addr, text)
+ *		const unsigned char *code;
+ *		int length, addr;
+ *		char *text;                 at least DISASM_TEXT chars
+ *
+ *		disasmModes(code, length, &flavorPtr, &size, &source, &dest)
+ *		const unsigned char *code;
+ *		int length;
+ *		const flavor *flavorPtr;
+ *		int size, source, dest;
+ *
+ *		disasmImage(out, image, length, addr)
+ *		FILE *out;
+ *		const unsigned char *image;
+ *		int length, addr;
+ *
+ *		disasmSRec(name, out)
+ *		char *name;
+ *		FILE *out;
+ *
+ ************************************************************************/
+
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <bit>
+#include <vector>
+#include "../include/asm.h"
+#include "../include/build.h"
+#include "../include/disasm.h"
+
+extern instruction opcodeTable[];
+extern int opcodeCount;
+
+// Operand kinds, what the builder of a flavor puts in the code for one
+// operand
+const char DIS_NONE = 0;          // no operand
+const char DIS_EA = 1;            // effective address in bits 0-5
+const char DIS_EA_MOVE = 2;       // effective address in bits 6-11, MOVE destination
+const char DIS_REG0 = 3;          // register in bits 0-2
+const char DIS_REG9 = 4;          // register in bits 9-11
+const char DIS_QUICK = 5;         // 1 to 8 in bits 9-11
+const char DIS_DATA8 = 6;         // signed byte in bits 0-7
+const char DIS_VECTOR = 7;        // trap vector in bits 0-3
+const char DIS_BRANCH = 8;        // displacement in bits 0-7 or the next word
+const char DIS_DBRANCH = 9;       // displacement in the next word
+const char DIS_IMM = 10;          // immediate of the instruction size
+const char DIS_IMM8 = 11;         // byte in the next word
+const char DIS_IMM16 = 12;        // word in the next word
+const char DIS_DISP16 = 13;       // signed word in the next word
+const char DIS_FIXED = 14;        // SR, CCR or USP
+const char DIS_MOVEP = 15;        // d(An), register in bits 0-2
+const char DIS_BF_EA = 16;        // bit field <ea>{offset:width}
+const char DIS_BF_REG = 17;       // data register of the bit field word
+const char DIS_SIDE = 18;         // chosen by the modes of the flavor
+
+const int DISASM_WORDS = 0x10000; // first words decoded
+
+struct disasmForm {
+	int (*exec)(int, int, opDescriptor*, opDescriptor*, int*);
+	char source;
+	char dest;
+};
+
+// Operands of the flavors of each builder
+static const disasmForm disasmForms[] = {
+	{ move, DIS_EA, DIS_EA_MOVE },
+	{ zeroOp, DIS_NONE, DIS_NONE },
+	{ oneOp, DIS_EA, DIS_FIXED },
+	{ arithReg, DIS_EA, DIS_REG9 },
+	{ arithAddr, DIS_REG9, DIS_EA },
+	{ bitField, DIS_SIDE, DIS_SIDE },
+	{ immedInst, DIS_IMM, DIS_EA },
+	{ quickMath, DIS_QUICK, DIS_EA },
+	{ movep, DIS_SIDE, DIS_SIDE },
+	{ moveReg, DIS_FIXED, DIS_EA },
+	{ staticBit, DIS_IMM8, DIS_EA },
+	{ trap, DIS_VECTOR, DIS_NONE },
+	{ branch, DIS_BRANCH, DIS_NONE },
+	{ moveq, DIS_DATA8, DIS_REG9 },
+	{ immedToCCR, DIS_IMM8, DIS_FIXED },
+	{ immedWord, DIS_IMM16, DIS_FIXED },
+	{ dbcc, DIS_REG0, DIS_DBRANCH },
+	{ scc, DIS_EA, DIS_NONE },
+	{ shiftReg, DIS_SIDE, DIS_REG0 },
+	{ exg, DIS_REG9, DIS_REG0 },
+	{ twoReg, DIS_REG0, DIS_REG9 },
+	{ oneReg, DIS_REG0, DIS_NONE },
+	{ moveUSP, DIS_SIDE, DIS_SIDE },
+	{ link_ins, DIS_REG0, DIS_DISP16 }
+};
+
+struct disasmEntry {
+	short inst;                   // index in opcodeTable[], -1 if none
+	char flavor;
+	char size;
+	char source;                  // operand kinds
+	char dest;
+};
+
+struct disasmCursor {
+	const unsigned char *code;
+	int length;
+	int pos;                      // bytes read
+	int addr;                     // address of code
+	bool ok;                      // false if a word was past the end
+};
+
+static std::vector<disasmEntry> disasmTable;  // by first word
+
+// Addressing modes of the effective address fields, mode 7 by register
+static const int disasmMode7[] = { AbsShort, AbsLong, PCDisp, PCIndex,
+		IMMEDIATE };
+
+// Addressing modes of MOVEM, registers to memory and memory to registers
+static const int disasmMovemModes[] = {
+		AnInd | AnIndPre | AnIndDisp | AnIndIndex | AbsShort | AbsLong,
+		AnInd | AnIndPost | AnIndDisp | AnIndIndex | AbsShort | AbsLong
+				| PCDisp | PCIndex };
+
+//------------------------------------------------------------
+// Returns the operand kind of a flavor for the source or destination
+static char disasmKind(const flavor *flavorPtr, bool dest) {
+	const disasmForm *form = NULL;
+	int set = (dest) ? flavorPtr->dest : flavorPtr->source;
+	char kind;
+
+	for (size_t i = 0; i < sizeof(disasmForms) / sizeof(disasmForm); i++)
+		if (disasmForms[i].exec == flavorPtr->exec)
+			form = &disasmForms[i];
+	if (!form || !set)
+		return (DIS_NONE);
+	kind = (dest) ? form->dest : form->source;
+	if (kind != DIS_SIDE)
+		return (kind);
+	if (flavorPtr->exec == bitField)  // BFINS Dn,<ea>{offset:width}
+		return (((flavorPtr->wordmask & 0x0700) == 0x0700) == dest ?
+				DIS_BF_EA : DIS_BF_REG);
+	if (flavorPtr->exec == movep)
+		return ((set == DnDirect) ? DIS_REG9 : DIS_MOVEP);
+	if (flavorPtr->exec == shiftReg)
+		return ((set == IMMEDIATE) ? DIS_QUICK : DIS_REG9);
+	return ((set == AnDirect) ? DIS_REG0 : DIS_FIXED);  // moveUSP
+}
+
+// Returns the bits of the first word a kind of operand fills in
+static int disasmBits(char kind) {
+	switch (kind) {
+	case DIS_EA:
+	case DIS_BF_EA:
+		return (0x003F);
+	case DIS_EA_MOVE:
+		return (0x0FC0);
+	case DIS_REG0:
+	case DIS_MOVEP:
+		return (0x0007);
+	case DIS_REG9:
+	case DIS_QUICK:
+		return (0x0E00);
+	case DIS_DATA8:
+	case DIS_BRANCH:
+		return (0x00FF);
+	case DIS_VECTOR:
+		return (0x000F);
+	}
+	return (0);
+}
+
+// Returns the addressing mode of an effective address field, or 0
+static int disasmEAMode(int mode, int reg) {
+	if (mode < 7)
+		return (1 << mode);
+	return ((reg < 5) ? disasmMode7[reg] : 0);
+}
+
+// true if the effective address of a kind of operand in word is one of
+// the modes of set
+static bool disasmLegal(char kind, int word, int set) {
+	if (kind == DIS_EA || kind == DIS_BF_EA)
+		return (disasmEAMode((word >> 3) & 7, word & 7) & set);
+	if (kind == DIS_EA_MOVE)
+		return (disasmEAMode((word >> 6) & 7, (word >> 9) & 7) & set);
+	return (true);
+}
+
+// Enter every first word a flavor outputs for one size
+static int disasmEnter(int inst, int f, int size, int mask) {
+	const flavor *flavorPtr = opcodeTable[inst].flavorPtr + f;
+	char source = disasmKind(flavorPtr, false);
+	char dest = disasmKind(flavorPtr, true);
+	int bits = disasmBits(source) | disasmBits(dest);
+	int word;
+	int x = bits;
+
+	do {
+		word = (mask & ~bits) | x;
+		if (disasmTable[word].inst < 0
+				&& disasmLegal(source, word, flavorPtr->source)
+				&& disasmLegal(dest, word, flavorPtr->dest)) {
+			disasmTable[word].inst = inst;
+			disasmTable[word].flavor = f;
+			disasmTable[word].size = size;
+			disasmTable[word].source = source;
+			disasmTable[word].dest = dest;
+		}
+		x = (x - 1) & bits;
+	} while (x != bits);
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Build the decode table
+int disasmStart() {
+	static const int sizes[] = { BYTE_SIZE, WORD_SIZE, LONG_SIZE };
+	const flavor *flavorPtr;
+	disasmEntry none = { -1, 0, 0, DIS_NONE, DIS_NONE };
+
+	if (!disasmTable.empty())
+		return (NORMAL);
+	disasmTable.assign(DISASM_WORDS, none);
+	for (int inst = 0; inst < opcodeCount; inst++)
+		for (int f = 0; f < opcodeTable[inst].flavorCount; f++) {
+			flavorPtr = opcodeTable[inst].flavorPtr + f;
+			if (!(flavorPtr->sizes & (BYTE_SIZE | WORD_SIZE | LONG_SIZE))) {
+				disasmEnter(inst, f, 0, flavorPtr->wordmask);
+				continue;
+			}
+			for (int s = 0; s < 3; s++)
+				if (flavorPtr->sizes & sizes[s])
+					disasmEnter(inst, f, sizes[s],
+							(s == 0) ? flavorPtr->bytemask :
+							(s == 1) ? flavorPtr->wordmask : flavorPtr->longmask);
+		}
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Returns the next word of the code, or 0 past the end
+static int disasmWord(disasmCursor &c) {
+	int word;
+
+	if (c.pos + 2 > c.length) {
+		c.ok = false;
+		return (0);
+	}
+	word = (c.code[c.pos] << 8) | c.code[c.pos + 1];
+	c.pos += 2;
+	return (word);
+}
+
+// Copy s to t. Returns the end of the text.
+static char* disasmPut(char *t, const char *s) {
+	while (*s)
+		*t++ = *s++;
+	return (t);
+}
+
+// Write $n in hex
+static char* disasmHex(char *t, unsigned int n) {
+	static const char digits[] = "0123456789ABCDEF";
+	int shift = 28;
+
+	*t++ = '$';
+	while (shift > 0 && !(n >> shift))
+		shift -= 4;
+	for (; shift >= 0; shift -= 4)
+		*t++ = digits[(n >> shift) & 15];
+	return (t);
+}
+
+// Write a signed number in hex
+static char* disasmSigned(char *t, int n) {
+	if (n < 0) {
+		*t++ = '-';
+		return (disasmHex(t, -n));
+	}
+	return (disasmHex(t, n));
+}
+
+// Write a number from 0 to 99 in decimal
+static char* disasmDec(char *t, int n) {
+	if (n >= 10)
+		*t++ = '0' + n / 10;
+	*t++ = '0' + n % 10;
+	return (t);
+}
+
+// Write a register, D0-D7 or A0-A7 by number 0-15
+static char* disasmReg(char *t, int reg) {
+	*t++ = (reg & 8) ? 'A' : 'D';
+	*t++ = '0' + (reg & 7);
+	return (t);
+}
+
+// Write the index register of a brief extension word and the ')'
+static char* disasmIndex(char *t, int ext) {
+	*t++ = ',';
+	t = disasmReg(t, (ext >> 12) & 15);
+	return (disasmPut(t, (ext & 0x800) ? ".L)" : ".W)"));
+}
+
+// Write an effective address, reading its extension words
+static char* disasmEA(char *t, disasmCursor &c, int mode, int reg, int size) {
+	int at;
+	int ext;
+
+	switch (mode) {
+	case DnDirect:
+		return (disasmReg(t, reg));
+	case AnDirect:
+		return (disasmReg(t, reg + 8));
+	case AnInd:
+	case AnIndPost:
+	case AnIndPre:
+		if (mode == AnIndPre)
+			*t++ = '-';
+		*t++ = '(';
+		t = disasmReg(t, reg + 8);
+		*t++ = ')';
+		if (mode == AnIndPost)
+			*t++ = '+';
+		return (t);
+	case AnIndDisp:
+		t = disasmSigned(t, (short) disasmWord(c));
+		*t++ = '(';
+		t = disasmReg(t, reg + 8);
+		*t++ = ')';
+		return (t);
+	case AnIndIndex:
+		ext = disasmWord(c);
+		t = disasmSigned(t, (signed char) (ext & 0xFF));
+		*t++ = '(';
+		t = disasmReg(t, reg + 8);
+		return (disasmIndex(t, ext));
+	case AbsShort:
+		t = disasmHex(t, disasmWord(c));
+		return (disasmPut(t, ".W"));
+	case AbsLong:
+		ext = disasmWord(c) << 16;
+		ext |= disasmWord(c);
+		t = disasmHex(t, ext);
+		return (disasmPut(t, ".L"));
+	case PCDisp:
+		at = c.addr + c.pos;
+		t = disasmHex(t, at + (short) disasmWord(c));
+		return (disasmPut(t, "(PC)"));
+	case PCIndex:
+		at = c.addr + c.pos;
+		ext = disasmWord(c);
+		t = disasmHex(t, at + (signed char) (ext & 0xFF));
+		t = disasmPut(t, "(PC");
+		return (disasmIndex(t, ext));
+	case IMMEDIATE:
+		ext = disasmWord(c);
+		if (size == LONG_SIZE)
+			ext = (ext << 16) | disasmWord(c);
+		else if (size == BYTE_SIZE)
+			ext &= 0xFF;
+		*t++ = '#';
+		return (disasmHex(t, ext));
+	}
+	return (t);
+}
+
+// Returns the addressing mode of an operand of kind in word, or 0 if
+// the operand is not one. set is the operand modes of the flavor.
+static int disasmKindMode(char kind, int word, int set) {
+	switch (kind) {
+	case DIS_EA:
+	case DIS_BF_EA:
+		return (disasmEAMode((word >> 3) & 7, word & 7));
+	case DIS_EA_MOVE:
+		return (disasmEAMode((word >> 6) & 7, (word >> 9) & 7));
+	case DIS_REG0:
+	case DIS_REG9:
+		if (!std::has_single_bit((unsigned int) set))  // EXG Dn,An
+			return ((kind == DIS_REG9) ? DnDirect : AnDirect);
+		return (set);
+	case DIS_QUICK:
+	case DIS_DATA8:
+	case DIS_VECTOR:
+	case DIS_IMM:
+	case DIS_IMM8:
+	case DIS_IMM16:
+		return (IMMEDIATE);
+	case DIS_FIXED:
+		return (set);
+	case DIS_MOVEP:
+		return (AnIndDisp);
+	case DIS_BF_REG:
+		return (DnDirect);
+	}
+	return (0);
+}
+
+// Write the register operand of a flavor, in the mode of its set
+static char* disasmRegOp(char *t, disasmCursor &c, int set, int reg,
+		char kind) {
+	return (disasmEA(t, c, disasmKindMode(kind, 0, set), reg, 0));
+}
+
+// Write the name of a register that is not in the code
+static char* disasmFixed(char *t, int set) {
+	if (set & SRDirect)
+		return (disasmPut(t, "SR"));
+	if (set & CCRDirect)
+		return (disasmPut(t, "CCR"));
+	if (set & USPDirect)
+		return (disasmPut(t, "USP"));
+	return (t);
+}
+
+// Write {offset:width} of a bit field word
+static char* disasmField(char *t, int field) {
+	*t++ = '{';
+	if (field & 0x0800)
+		t = disasmReg(t, (field >> 6) & 7);
+	else
+		t = disasmDec(t, (field >> 6) & 31);
+	*t++ = ':';
+	if (field & 0x0020)
+		t = disasmReg(t, field & 7);
+	else
+		t = disasmDec(t, (field & 31) ? field & 31 : 32);
+	*t++ = '}';
+	return (t);
+}
+
+// Write one operand of kind from the first word and the cursor
+static char* disasmOperand(char *t, disasmCursor &c, int word, char kind,
+		int set, int size, int field) {
+	int n;
+
+	switch (kind) {
+	case DIS_EA:
+		return (disasmEA(t, c, disasmEAMode((word >> 3) & 7, word & 7),
+				word & 7, size));
+	case DIS_EA_MOVE:
+		return (disasmEA(t, c, disasmEAMode((word >> 6) & 7, (word >> 9) & 7),
+				(word >> 9) & 7, size));
+	case DIS_REG0:
+		return (disasmRegOp(t, c, set, word & 7, kind));
+	case DIS_REG9:
+		return (disasmRegOp(t, c, set, (word >> 9) & 7, kind));
+	case DIS_QUICK:
+		n = (word >> 9) & 7;
+		*t++ = '#';
+		return (disasmDec(t, (n) ? n : 8));
+	case DIS_DATA8:
+		*t++ = '#';
+		return (disasmSigned(t, (signed char) (word & 0xFF)));
+	case DIS_VECTOR:
+		*t++ = '#';
+		return (disasmDec(t, word & 0xF));
+	case DIS_BRANCH:
+		n = (signed char) (word & 0xFF);
+		if (!n)
+			n = (short) disasmWord(c);
+		return (disasmHex(t, c.addr + 2 + n));
+	case DIS_DBRANCH:
+		n = c.addr + c.pos;
+		return (disasmHex(t, n + (short) disasmWord(c)));
+	case DIS_IMM:
+		return (disasmEA(t, c, IMMEDIATE, 0, size));
+	case DIS_IMM8:
+		return (disasmEA(t, c, IMMEDIATE, 0, BYTE_SIZE));
+	case DIS_IMM16:
+		return (disasmEA(t, c, IMMEDIATE, 0, WORD_SIZE));
+	case DIS_DISP16:
+		*t++ = '#';
+		return (disasmSigned(t, (short) disasmWord(c)));
+	case DIS_FIXED:
+		return (disasmFixed(t, set));
+	case DIS_MOVEP:
+		return (disasmEA(t, c, AnIndDisp, word & 7, 0));
+	case DIS_BF_EA:
+		t = disasmEA(t, c, disasmEAMode((word >> 3) & 7, word & 7), word & 7,
+				size);
+		return (disasmField(t, field));
+	case DIS_BF_REG:
+		return (disasmReg(t, (field >> 12) & 7));
+	}
+	return (t);
+}
+
+// Write the register list of a MOVEM mask with bit 0 for D0, as
+// D0/D3-D5/A3
+static char* disasmRegList(char *t, int mask) {
+	char *start = t;
+	int last;
+
+	for (int reg = 0; reg < 16; reg = last + 1) {
+		last = reg;
+		if (!(mask & (1 << reg)))
+			continue;
+		while ((last & 7) != 7 && (mask & (1 << (last + 1))))
+			last++;
+		if (t != start)
+			*t++ = '/';
+		t = disasmReg(t, reg);
+		if (last > reg) {
+			*t++ = '-';
+			t = disasmReg(t, last);
+		}
+	}
+	return (t);
+}
+
+// Write the MOVEM at the cursor to text. Returns its length in bytes,
+// or 0 if word is not a MOVEM the assembler outputs.
+static int disasmMovem(char *text, disasmCursor &c, int word) {
+	bool toRegs = (word & 0x0400);
+	int mode = disasmEAMode((word >> 3) & 7, word & 7);
+	int mask;
+	int list = 0;
+	char *t;
+
+	if (!(mode & disasmMovemModes[toRegs]))
+		return (0);
+	mask = disasmWord(c);
+	if (!c.ok || !mask)
+		return (0);
+	for (int i = 0; i < 16; i++)     // -(An) has bit 0 for A7
+		if (mask & (1 << i))
+			list |= 1 << ((mode == AnIndPre) ? 15 - i : i);
+	t = disasmPut(text, (word & 0x0040) ? "MOVEM.L " : "MOVEM.W ");
+	if (!toRegs) {
+		t = disasmRegList(t, list);
+		*t++ = ',';
+	}
+	t = disasmEA(t, c, mode, word & 7, 0);
+	if (toRegs) {
+		*t++ = ',';
+		t = disasmRegList(t, list);
+	}
+	*t = '\0';
+	return ((c.ok) ? c.pos : 0);
+}
+
+//------------------------------------------------------------
+// Write the instruction at code, of length bytes at address addr, to
+// text. Returns the length of the instruction in bytes.
+int disasmInst(const unsigned char *code, int length, int addr, char *text) {
+	static const char sizeCode[] = "?BW?L";
+	disasmCursor c = { code, length, 0, addr, true };
+	const flavor *flavorPtr;
+	disasmEntry entry;
+	char *t = text;
+	int word;
+	int field = 0;
+	int n;
+
+	disasmStart();
+	word = disasmWord(c);
+	if (!c.ok) {                      // odd byte at the end
+		t = disasmPut(text, "DC.B    ");
+		t = disasmHex(t, code[0]);
+		*t = '\0';
+		return (1);
+	}
+	entry = disasmTable[word];
+	if (entry.inst < 0 && (word & 0xFB80) == 0x4880
+			&& (n = disasmMovem(text, c, word)) > 0)
+		return (n);
+	if (entry.inst >= 0) {
+		flavorPtr = opcodeTable[entry.inst].flavorPtr + entry.flavor;
+		t = disasmPut(t, opcodeTable[entry.inst].mnemonic);
+		if (flavorPtr->exec == branch)
+			t = disasmPut(t, (word & 0xFF) ? ".S" : ".W");
+		else if (entry.size && flavorPtr->exec != bitField) {
+			*t++ = '.';
+			*t++ = sizeCode[(int) entry.size];
+		}
+		if (flavorPtr->exec == bitField)  // field word comes first
+			field = disasmWord(c);
+		if (entry.source || entry.dest)
+			do
+				*t++ = ' ';
+			while (t < text + 8);
+		t = disasmOperand(t, c, word, entry.source, flavorPtr->source,
+				entry.size, field);
+		if (entry.source && entry.dest)
+			*t++ = ',';
+		t = disasmOperand(t, c, word, entry.dest, flavorPtr->dest, entry.size,
+				field);
+	}
+	if (entry.inst < 0 || !c.ok) {
+		t = disasmPut(text, "DC.W    ");
+		t = disasmHex(t, word);
+		*t = '\0';
+		return (2);
+	}
+	*t = '\0';
+	return (c.pos);
+}
+
+//------------------------------------------------------------
+// Returns the length in bytes of the instruction at code as
+// disasmInst() does, with its flavor, size and the addressing modes of
+// its operands. The flavor is NULL if the code is written as DC or is a
+// MOVEM. The mode of an operand that is not an addressing mode, such as
+// a branch displacement, is 0.
+int disasmModes(const unsigned char *code, int length,
+		const flavor **flavorPtr, int *sizePtr, int *sourcePtr, int *destPtr) {
+	char text[DISASM_TEXT];
+	disasmEntry entry;
+	int word;
+	int n;
+
+	n = disasmInst(code, length, 0, text);
+	*flavorPtr = NULL;
+	*sizePtr = *sourcePtr = *destPtr = 0;
+	if (strncmp(text, "DC.", 3) == 0)
+		return (n);
+	word = (code[0] << 8) | code[1];
+	entry = disasmTable[word];
+	if (entry.inst < 0)               // MOVEM
+		return (n);
+	*flavorPtr = opcodeTable[entry.inst].flavorPtr + entry.flavor;
+	*sizePtr = entry.size;
+	*sourcePtr = disasmKindMode(entry.source, word, (*flavorPtr)->source);
+	*destPtr = disasmKindMode(entry.dest, word, (*flavorPtr)->dest);
+	return (n);
+}
+
+//------------------------------------------------------------
+// Write the instructions of length bytes of image at address addr
+int disasmImage(FILE *out, const unsigned char *image, int length, int addr) {
+	static const char digits[] = "0123456789ABCDEF";
+	char line[DISASM_TEXT + 48];
+	char *t;
+	int pos = 0;
+	int n;
+
+	disasmStart();
+	while (pos < length) {
+		t = line;
+		for (int shift = 28; shift >= 0; shift -= 4)
+			*t++ = digits[((addr + pos) >> shift) & 15];
+		*t++ = ' ';
+		*t++ = ' ';
+		n = disasmInst(image + pos, length - pos, addr + pos, line + 40);
+		for (int i = 0; i < n && i < 12; i++) {
+			*t++ = digits[image[pos + i] >> 4];
+			*t++ = digits[image[pos + i] & 15];
+			if (i & 1)
+				*t++ = ' ';
+		}
+		while (t < line + 40)
+			*t++ = ' ';
+		t = strchr(t, '\0');
+		*t++ = '\n';
+		fwrite(line, 1, t - line, out);
+		pos += n;
+	}
+	if (ferror(out))
+		return (MILD_ERROR);
+	return (NORMAL);
+}
+
+// Returns the value of the hex digit pair at p, or -1
+static int disasmPair(const char *p) {
+	int n = 0;
+
+	for (int i = 0; i < 2; i++) {
+		if (!isxdigit(p[i]))
+			return (-1);
+		n = n * 16 + (isdigit(p[i]) ? p[i] - '0' : toupper(p[i]) - 'A' + 10);
+	}
+	return (n);
+}
+
+struct disasmRecord {
+	int addr;
+	std::vector<unsigned char> data;
+};
+
+//------------------------------------------------------------
+// Write the code of S-record file name
+int disasmSRec(char *name, FILE *out) {
+	std::vector<disasmRecord> records;
+	std::vector<unsigned char> block;
+	disasmRecord record;
+	char srec[600];
+	FILE *in;
+	int status = NORMAL;
+	int addrBytes;
+	int count;
+	int sum;
+	int n;
+	int addr;
+
+	in = fopen(name, "r");
+	if (!in)
+		return (MILD_ERROR);
+	while (fgets(srec, sizeof(srec), in)) {
+		if (srec[0] != 'S' || srec[1] < '1' || srec[1] > '3')
+			continue;                   // not a data record
+		addrBytes = srec[1] - '0' + 1;
+		count = disasmPair(srec + 2);
+		if (count < addrBytes + 1) {
+			status = MILD_ERROR;
+			continue;
+		}
+		sum = count;
+		record.addr = 0;
+		record.data.clear();
+		for (int i = 0; i < count; i++) {
+			n = disasmPair(srec + 4 + i * 2);
+			if (n < 0)
+				break;
+			sum += n;
+			if (i < addrBytes)
+				record.addr = (record.addr << 8) | n;
+			else if (i < count - 1)
+				record.data.push_back(n);
+		}
+		if (n < 0 || (sum & 0xFF) != 0xFF) {  // bad record
+			status = MILD_ERROR;
+			continue;
+		}
+		records.push_back(record);
+	}
+	fclose(in);
+
+	// disassemble each block of consecutive addresses
+	std::stable_sort(records.begin(), records.end(),
+			[](const disasmRecord &a, const disasmRecord &b) {
+				return (a.addr < b.addr);
+			});
+	addr = 0;
+	for (size_t i = 0; i < records.size(); i++) {
+		if (!block.empty() && records[i].addr != addr + (int) block.size()) {
+			if (disasmImage(out, &block[0], block.size(), addr) != NORMAL)
+				status = MILD_ERROR;
+			block.clear();
+		}
+		if (block.empty())
+			addr = records[i].addr;
+		block.insert(block.end(), records[i].data.begin(),
+				records[i].data.end());
+	}
+	if (!block.empty() && disasmImage(out, &block[0], block.size(), addr)
+			!= NORMAL)
+		status = MILD_ERROR;
+	return (status);
+}
@@ -0,0 +1,136 @@
+/***********************************************************************
+ *
+ *		DISPATCH.CPP
+ *		Flavor Dispatch Tables for 68000 Assembler
+ *
+ *    Function: dispatchSource()
+ *		Called by instCode() once the source operand is parsed.
+ *		Returns the flavor that matches the source addressing
+ *		mode before the destination operand is needed, without
+ *		walking the flavor list.
+ *
+ *		dispatchBoth()
+ *		Called by instCode() once both operands are parsed.
+ *		Returns the flavor that matches both addressing modes.
+ *
+ *		The table of a flavor list is made the first time the
+ *		instruction is assembled and kept for the rest of the
+ *		run. It is indexed by the bit number of each addressing
+ *		mode and gives the first flavor of the list that
+ *		matches, so the flavor picked is the one the search of
+ *		the list in order would pick. A flavor with no source
+ *		operand matches anything. Flavors before the first one
+ *		with a destination operand are matched on the source
+ *		alone, as the destination is not parsed until that
+ *		flavor is reached.
+ *
+ ************************************************************************/
+
+#include <bit>
+#include <unordered_map>
+#include "../include/asm.h"
+#include "../include/dispatch.h"
+
+const int DISPATCH_MODES = 18;    // bits of the addressing modes, then no mode
+
+struct dispatchTable {
+	int destAt;                   // first flavor with a destination operand
+	signed char before[DISPATCH_MODES];   // source mode -> flavor, -1 if none
+	signed char after[DISPATCH_MODES][DISPATCH_MODES];  // source, dest mode
+};
+
+static std::unordered_map<const flavor*, dispatchTable> dispatchTables;
+
+// Returns the table index of an addressing mode, or -1 if mode is not
+// a single mode
+static int dispatchIndex(int mode) {
+	if (!mode)
+		return (DISPATCH_MODES - 1);
+	if (!std::has_single_bit((unsigned int) mode))
+		return (-1);
+	if (std::countr_zero((unsigned int) mode) >= DISPATCH_MODES - 1)
+		return (-1);
+	return (std::countr_zero((unsigned int) mode));
+}
+
+// Returns the addressing mode of a table index
+static int dispatchMode(int index) {
+	return ((index == DISPATCH_MODES - 1) ? 0 : 1 << index);
+}
+
+// true if the flavor takes the source and destination modes. dest is
+// not looked at for a flavor with no destination operand.
+static bool dispatchMatch(const flavor *flavorPtr, int source, int dest) {
+	if (!flavorPtr->source)
+		return (true);
+	if (!(source & flavorPtr->source))
+		return (false);
+	return (!flavorPtr->dest || (dest & flavorPtr->dest));
+}
+
+// Returns the first flavor from first to last that takes the modes,
+// or -1
+static int dispatchScan(instruction *tablePtr, int first, int last,
+		int source, int dest) {
+	for (int f = first; f < last; f++)
+		if (dispatchMatch(tablePtr->flavorPtr + f, source, dest))
+			return (f);
+	return (-1);
+}
+
+// Returns the table of the flavor list of tablePtr, making it if needed
+static dispatchTable& dispatchFind(instruction *tablePtr) {
+	std::unordered_map<const flavor*, dispatchTable>::iterator it;
+	int count = tablePtr->flavorCount;
+	int s;
+	int d;
+
+	it = dispatchTables.find(tablePtr->flavorPtr);
+	if (it != dispatchTables.end())
+		return (it->second);
+	dispatchTable &table = dispatchTables[tablePtr->flavorPtr];
+	for (table.destAt = 0; table.destAt < count; table.destAt++)
+		if (tablePtr->flavorPtr[table.destAt].dest)
+			break;
+	for (s = 0; s < DISPATCH_MODES; s++) {
+		table.before[s] = dispatchScan(tablePtr, 0, table.destAt,
+				dispatchMode(s), 0);
+		for (d = 0; d < DISPATCH_MODES; d++)
+			table.after[s][d] = dispatchScan(tablePtr, table.destAt, count,
+					dispatchMode(s), dispatchMode(d));
+	}
+	return (table);
+}
+
+//------------------------------------------------------------
+// Returns the first flavor with a destination operand, or the number
+// of flavors if there is none
+int dispatchDest(instruction *tablePtr) {
+	return (dispatchFind(tablePtr).destAt);
+}
+
+//------------------------------------------------------------
+// Returns the flavor before dispatchDest() that takes the source
+// mode, or -1
+int dispatchSource(instruction *tablePtr, int source) {
+	dispatchTable &table = dispatchFind(tablePtr);
+	int s = dispatchIndex(source);
+
+	if (s < 0)
+		return (dispatchScan(tablePtr, 0, table.destAt, source, 0));
+	return (table.before[s]);
+}
+
+//------------------------------------------------------------
+// Returns the flavor from dispatchDest() on that takes the source and
+// destination modes, or -1
+int dispatchBoth(instruction *tablePtr, int source, int dest) {
+	dispatchTable &table = dispatchFind(tablePtr);
+	int s = dispatchIndex(source);
+	int d = dispatchIndex(dest);
+
+	if (s < 0 || d < 0)
+		return (dispatchScan(tablePtr, table.destAt, tablePtr->flavorCount,
+				source, dest));
+	return (table.after[s][d]);
+}
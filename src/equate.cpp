@@ -0,0 +1,338 @@
+/***********************************************************************
+ *
+ *		EQUATE.CPP
+ *		EQU Dependency Graph for 68000 Assembler
+ *
+ *    Function: equRecord()
+ *		Called by equ() for every EQU. Pass 1 keeps the
+ *		expression of each EQU, with the location and the
+ *		global label it was written under. An EQU that refers
+ *		to symbols defined later is not rejected; its label is
+ *		left undefined until it is needed.
+ *
+ *		equResolve()
+ *		Called by eval() in pass 1 for a symbol that is not
+ *		defined. If it is an EQU label its expression is
+ *		evaluated, resolving the EQU labels it uses in turn,
+ *		and the label is defined when every symbol it needs is
+ *		known. EQUs may then be written in any order, and ORG,
+ *		SECTION and OFFSET accept them before their definition.
+ *
+ *		equBackRef()
+ *		Called by eval() in pass 2 for a symbol not yet defined
+ *		in this pass. Pass 1 counts the uses of each symbol made
+ *		before it was defined; pass 2 treats the same uses as
+ *		forward references, so both passes choose the same
+ *		instruction sizes. A later use of an EQU label resolved
+ *		in pass 1 is a backward reference.
+ *
+ *		equNext()
+ *		Called at the end of pass 1. The remaining EQUs are
+ *		resolved and EQUs that depend on each other are reported
+ *		in pass 2 with the names around the cycle. Returns true
+ *		to repeat pass 1 if ORG, SECTION or OFFSET refused a
+ *		forward reference and new EQUs were found; the next
+ *		pass 1 resolves them from the expressions kept.
+ *
+ ************************************************************************/
+
+#include <cstdio>
+#include <cctype>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include "../include/asm.h"
+#include "../include/eval.h"
+#include "../include/symbol.h"
+#include "../include/relax.h"
+#include "../include/equate.h"
+
+extern thread_local int loc;
+extern bool pass2;
+extern char globalLabel[SIGCHARS + 1];
+extern char buffer[256];        // used to form messages for display in windows
+
+const char EQU_NONE = 0;          // states of a symbol
+const char EQU_WAITING = 1;       //   EQU not resolved in this pass
+const char EQU_BUSY = 2;          //   its expression is being evaluated
+const char EQU_DONE = 3;          //   defined in this pass
+const char EQU_CYCLE = 4;         //   depends on itself
+
+const int EQU_PASSES = 4;         // most pass 1 runs for one assembly
+
+struct equNode {
+	std::string expr;             // expression of the EQU, empty if not an EQU
+	std::string global;           // globalLabel at the EQU
+	int loc;                      // location at the EQU
+	char state;
+	int misses;                   // uses in pass 1 before it was defined
+	int uses;                     // uses in pass 2 before it was defined
+	std::string cycle;            // names around the cycle it is on
+};
+
+static std::map<std::string, equNode> equNodes;  // symbol -> node, by table name
+static int equCount;                             // EQUs kept at the start of the pass
+static int equPasses;                            // pass 1 runs
+static bool equRefused;                          // a directive refused a forward reference
+
+//------------------------------------------------------------
+// Called at the start of an assembly
+int equStart() {
+	equNodes.clear();
+	equPasses = 0;
+	return (NORMAL);
+}
+
+// Called at the start of each pass
+int equPass() {
+	std::map<std::string, equNode>::iterator it;
+
+	equCount = 0;
+	for (it = equNodes.begin(); it != equNodes.end(); it++) {
+		if (!pass2) {
+			it->second.state = (it->second.expr.empty()) ? EQU_NONE : EQU_WAITING;
+			it->second.misses = 0;
+		}
+		it->second.uses = 0;
+		if (!it->second.expr.empty())
+			equCount++;
+	}
+	if (!pass2)
+		equPasses++;
+	equRefused = false;
+	return (NORMAL);
+}
+
+// Returns the name of label as the symbol table keeps it. A local label
+// is joined to the last global label the way lookup() does it.
+static std::string equName(const char *label) {
+	std::string name;
+
+	if (*label != '.')
+		return (std::string(label, strnlen(label, SIGCHARS)));
+	name.assign(globalLabel, strnlen(globalLabel, SIGCHARS));
+	name += ':';
+	name += label + 1;
+	if (name.size() > SIGCHARS)
+		name.resize(SIGCHARS);
+	return (name);
+}
+
+// Evaluate the expression of node as it was written. Returns true if
+// every symbol it uses is known.
+static bool equEval(equNode &node, int *valuePtr) {
+	std::string text = node.expr;
+	char global[SIGCHARS + 1];
+	int locSave = loc;
+	bool backRef;
+	int error = OK;
+
+	strcpy(global, globalLabel);
+	strcpy(globalLabel, node.global.c_str());
+	loc = node.loc;
+	node.state = EQU_BUSY;
+	eval(&text[0], valuePtr, &backRef, &error);
+	loc = locSave;
+	strcpy(globalLabel, global);
+	return (backRef && error < ERRORN);
+}
+
+// Define the EQU label name from its expression if it can be
+// evaluated. Returns the symbol or NULL.
+static symbolDef* equSolve(const std::string &name) {
+	equNode &node = equNodes[name];
+	char sym[SIGCHARS + 1];
+	symbolDef *symbol;
+	int value;
+	int error = OK;
+
+	if (node.state != EQU_WAITING)
+		return (NULL);
+	if (!equEval(node, &value)) {
+		node.state = EQU_WAITING;
+		return (NULL);
+	}
+	node.state = EQU_DONE;
+	strcpy(sym, name.c_str());
+	symbol = lookup(sym, true, &error);
+	if (error >= ERRORN)
+		return (NULL);
+	symbol->value = value;
+	symbol->flags = 0;
+	relaxDefine(sym, value);        // value for the next pass 1
+	return (symbol);
+}
+
+//------------------------------------------------------------
+// Called by equ(). Keeps the expression from expr to end in pass 1.
+// Returns true if equ() should define the label now.
+bool equRecord(char *label, char *expr, char *end, bool backRef) {
+	equNode &node = equNodes[equName(label)];
+
+	if (pass2)
+		return (true);
+	node.expr.assign(expr, end - expr);
+	node.global = globalLabel;
+	node.loc = loc;
+	if (*label != '.')                // as define() does
+		strncpy(globalLabel, label, SIGCHARS);
+	if (node.state == EQU_DONE)       // already resolved by a use above
+		return (false);
+	node.state = (backRef) ? EQU_DONE : EQU_WAITING;
+	return (backRef);
+}
+
+//------------------------------------------------------------
+// Called by equ() for an expression with forward references. Returns
+// true if the dependency graph takes care of them.
+bool equLazy(char *label, int *errorPtr) {
+	std::map<std::string, equNode>::iterator it;
+
+	if (!*label)
+		return (false);
+	if (!pass2)                       // equ() checks what follows
+		return (true);
+	it = equNodes.find(equName(label));
+	if (it == equNodes.end())
+		return (false);
+	if (it->second.state == EQU_CYCLE) {
+		snprintf(buffer, sizeof(buffer), "ERROR: Circular EQU %s\n",
+				it->second.cycle.c_str());
+		NEWERROR(*errorPtr, CIRCULAR_EQU);
+		return (true);
+	}
+	return (it->second.state == EQU_DONE);
+}
+
+//------------------------------------------------------------
+// Called by eval() in pass 1 for an undefined symbol. name is the
+// name given to lookup(). Returns the symbol if it was an EQU that
+// could be resolved, otherwise NULL.
+symbolDef* equResolve(char *name) {
+	symbolDef *symbol = equSolve(name);
+
+	if (!symbol)
+		equNodes[name].misses++;
+	return (symbol);
+}
+
+//------------------------------------------------------------
+// Called by eval() in pass 2 for a symbol that is not yet defined in
+// this pass. Returns true if pass 1 had it defined at this use.
+bool equBackRef(char *name, symbolDef *symbol) {
+	std::map<std::string, equNode>::iterator it;
+	int value;
+
+	it = equNodes.find(name);
+	if (it == equNodes.end() || it->second.state != EQU_DONE)
+		return (false);
+	if (++it->second.uses <= it->second.misses)
+		return (false);               // a forward reference in pass 1
+	if (!equEval(it->second, &value) || value != symbol->value) {
+		it->second.state = EQU_DONE;
+		return (false);
+	}
+	it->second.state = EQU_DONE;
+	symbol->flags |= BACKREF;
+	return (true);
+}
+
+//------------------------------------------------------------
+// Called by org(), section() and offset() when pass 1 refuses a
+// forward reference
+int equRefuse() {
+	if (!pass2)
+		equRefused = true;
+	return (NORMAL);
+}
+
+// Adds to names the EQU labels used by the expression of node that
+// are still waiting
+static int equUses(equNode &node, std::vector<std::string> &names) {
+	const char *p = node.expr.c_str();
+	char global[SIGCHARS + 1];
+	std::map<std::string, equNode>::iterator it;
+	std::string sym;
+
+	strcpy(global, globalLabel);
+	strcpy(globalLabel, node.global.c_str());
+	while (*p) {
+		if (*p == '\'') {               // skip string
+			for (p++; *p && !(*p == '\'' && *(p + 1) != '\''); p++)
+				if (*p == '\'')
+					p++;
+			if (*p)
+				p++;
+		} else if (*p == '$' || isdigit(*p)) {   // skip number
+			p++;
+			while (isalnum(*p))
+				p++;
+		} else if (isalpha(*p) || *p == '.' || *p == '_') {
+			sym.clear();
+			do
+				sym += *p++;
+			while (isalnum(*p) || *p == '_' || *p == '$');
+			it = equNodes.find(equName(sym.c_str()));
+			if (it != equNodes.end() && it->second.state == EQU_WAITING)
+				names.push_back(it->first);
+		} else
+			p++;
+	}
+	strcpy(globalLabel, global);
+	return (NORMAL);
+}
+
+// Depth first search from name. path holds the names being searched;
+// a name found on it closes a cycle.
+static int equFindCycle(const std::string &name, std::vector<std::string> &path,
+		std::map<std::string, char> &seen) {
+	std::vector<std::string> names;
+	std::string cycle;
+	size_t i;
+
+	seen[name] = 1;
+	path.push_back(name);
+	equUses(equNodes[name], names);
+	for (size_t n = 0; n < names.size(); n++) {
+		if (seen[names[n]] == 1) {      // on the path
+			for (i = 0; path[i] != names[n]; i++)
+				;
+			for (cycle.clear(); i < path.size(); i++)
+				cycle += path[i] + " -> ";
+			cycle += names[n];
+			for (i = 0; path[i] != names[n]; i++)
+				;
+			for (; i < path.size(); i++)
+				if (equNodes[path[i]].state == EQU_WAITING) {
+					equNodes[path[i]].state = EQU_CYCLE;
+					equNodes[path[i]].cycle = cycle;
+				}
+		} else if (!seen[names[n]])
+			equFindCycle(names[n], path, seen);
+	}
+	path.pop_back();
+	seen[name] = 2;
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Called at the end of pass 1. Returns true to repeat pass 1 with the
+// EQUs found in this pass, unless last says pass 2 follows this pass.
+bool equNext(bool last) {
+	std::map<std::string, equNode>::iterator it;
+	std::map<std::string, char> seen;
+	std::vector<std::string> path;
+	int count = 0;
+
+	for (it = equNodes.begin(); it != equNodes.end(); it++)
+		if (it->second.state == EQU_WAITING)
+			equSolve(it->first);
+	for (it = equNodes.begin(); it != equNodes.end(); it++) {
+		if (it->second.state == EQU_WAITING && !seen[it->first])
+			equFindCycle(it->first, path, seen);
+		if (!it->second.expr.empty())
+			count++;
+	}
+	return (!last && equRefused && count > equCount && equPasses < EQU_PASSES);
+}
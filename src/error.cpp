@@ -177,6 +177,9 @@ int printError(FILE *outFile, int errorCode, int lineNum) {
 	case INV_OPERATOR:
 		sprintf(buffer, "ERROR: Invalid operator\n");
 		break;
+	case INV_UNROLL_BUDGET:
+		sprintf(buffer, "ERROR: Unroll budget must be 1 or more\n");
+		break;
 	case INV_FORWARD_REF:
 		sprintf(buffer,
 				"ERROR: Forward references not allowed with this directive\n");
@@ -238,6 +241,21 @@ int printError(FILE *outFile, int errorCode, int lineNum) {
 	case ILLEGAL_SYMBOL:
 		sprintf(buffer, "ERROR: Illegal symbol\n");
 		break;
+	case NO_UNROLL:
+		sprintf(buffer, "ERROR: No matching UNROLL statement was found\n");
+		break;
+	case ENDU_EXPECTED:
+		sprintf(buffer, "ERROR: UNROLL without ENDU\n");
+		break;
+	case NO_ENDR:
+		sprintf(buffer, "ERROR: No matching REPT, IRP or IRPC was found\n");
+		break;
+	case ENDR_EXPECTED:
+		sprintf(buffer, "ERROR: REPT, IRP or IRPC without ENDR\n");
+		break;
+	case CIRCULAR_EQU:  // the names around the cycle
+		//the error message has already been written to buffer
+		break;
 	default:
 		if (errorCode > MINOR)
 			sprintf(buffer, "ERROR: No message defined\n");
@@ -23,7 +23,23 @@
  *		The char pointed to by refPtr is set to true if all the
  *		symbols encountered in the expression are backwards
  *		references or FALSE if at least one symbol is a forward
- *		reference.
+ *		reference. An undefined symbol that is an EQU label is
+ *		resolved from its expression first (see EQUATE.CPP).
+ *
+ *		Each expression is compiled the first time it is seen
+ *		into a list of terms and operators. Numbers and strings
+ *		are converted once, symbols keep a pointer to their
+ *		symbol table entry, and an expression of numbers only is
+ *		folded to its value. The compiled form is kept by the
+ *		text of the rest of the line and run by evalRun() the
+ *		same way eval() would read the text, with the same
+ *		results and errors. An expression that cannot be
+ *		compiled, because of a syntax error, is read by eval().
+ *		When EVAL_CODES are kept they are all dropped, but not
+ *		while one is running: an EQU resolved from a term runs
+ *		eval() again, and that one reads its expression itself.
+ *		The operator stack holds operators of rising precedence
+ *		only, so STACKMAX values are always enough.
  *
  *	 Usage:	char *eval(p, valuePtr, refPtr, errorPtr)
  *		char *p;
@@ -51,14 +67,25 @@
 
 #include <cstdio>
 #include <cctype>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 #include "../include/asm.h"
 #include "../include/eval.h"
 #include "../include/symbol.h"
+#include "../include/depend.h"
+#include "../include/cache.h"
+#include "../include/relax.h"
+#include "../include/equate.h"
 
 extern bool pass2;
-extern int loc;
+extern thread_local int loc;
 extern char buffer[256];  //ck used to form messages for display in windows
 extern char numBuf[20];
+extern unsigned int symbolGeneration; // changes when the symbol table is cleared
 
 // Largest number that can be represented in an unsigned int
 //	- MACHINE DEPENDENT
@@ -68,6 +95,361 @@ const unsigned int LONGLIMIT = 0xFFFFFFFF;         //ck
 
 #define STACKMAX 5
 
+const char EVAL_LOC = 0;        // kinds of term
+const char EVAL_NUMBER = 1;
+const char EVAL_SYMBOL = 2;
+const char EVAL_PAREN = 3;
+const size_t EVAL_CODES = 65536;  // most expressions kept
+
+struct evalTerm {
+	char kind;                    // EVAL_LOC, EVAL_NUMBER, EVAL_SYMBOL or EVAL_PAREN
+	std::string unary;            // - and ~ in front of the term
+	int value;                    // EVAL_NUMBER value
+	int error;                    // EVAL_NUMBER error
+	char name[SIGCHARS + 1];      // EVAL_SYMBOL name
+	symbolDef *symbol;            // EVAL_SYMBOL entry, if found
+	unsigned int generation;      //   in this symbol table
+	int expr;                     // EVAL_PAREN expression
+	int end;                      // offset of the character after the term
+};
+
+struct evalExpr {
+	std::vector<evalTerm> terms;
+	std::string ops;              // operator after each term but the last
+	int end;                      // offset of the terminator
+};
+
+struct evalCode {
+	std::string text;             // rest of the line from the expression
+	std::vector<evalExpr> exprs;  // exprs[0] is the expression
+	bool compiled;                // false after a syntax error
+	bool folded;                  // numbers only, value is known
+	int value;
+};
+
+static std::deque<evalCode> evalCodes;
+static std::unordered_map<std::string_view, evalCode*> evalIndex;
+static int evalDepth;           // compiled expressions being run
+
+static int evalCompile(evalCode &code, int off);
+static int evalRun(evalCode &code, int e, char *p, int *valuePtr, bool *refPtr,
+		int *errorPtr);
+
+// true if c ends an expression
+static bool evalEnd(char c) {
+	return (c == ',' || c == '(' || c == ')' || !c || isspace(c) || c == '.'
+			|| c == '{' || c == ':' || c == '}');
+}
+
+// Compile the term at text[off] the way evalNumber() reads it. Returns
+// false on a syntax error.
+static bool evalCompileTerm(evalCode &code, int off, evalTerm &term) {
+	const char *p = code.text.c_str() + off;
+	const char *start = code.text.c_str();
+	unsigned int x;
+	int base;
+	int i;
+
+	term.unary.clear();
+	term.error = OK;
+	term.symbol = NULL;
+	while (*p == '-' || *p == '~')
+		term.unary += *p++;
+	if (*p == '*') {
+		term.kind = EVAL_LOC;
+		p++;
+	} else if (*p == '(') {
+		term.kind = EVAL_PAREN;
+		term.expr = evalCompile(code, ++p - start);
+		if (term.expr < 0 || code.text[code.exprs[term.expr].end] != ')')
+			return (false);
+		p = start + code.exprs[term.expr].end + 1;
+	} else if (*p == '$' && isxdigit(*(p + 1))) {
+		term.kind = EVAL_NUMBER;
+		x = 0;
+		while (isxdigit(*++p)) {
+			if (x > LONGLIMIT / 16)
+				NEWERROR(term.error, NUMBER_TOO_BIG);
+			if (*p > '9')
+				x = 16 * x + (*p - 'A' + 10);
+			else
+				x = 16 * x + (*p - '0');
+		}
+		term.value = x;
+	} else if (*p == '%' || *p == '@' || isdigit(*p)) {
+		term.kind = EVAL_NUMBER;
+		base = 10;
+		if (*p == '%') {
+			base = 2;
+			p++;
+		} else if (*p == '@') {
+			base = 8;
+			p++;
+		}
+		if (*p < '0' || *p >= '0' + base)
+			return (false);
+		x = 0;
+		while (*p >= '0' && *p < '0' + base) {
+			if (x > ((unsigned int) (LONGLIMIT - (*p - '0')) / base))
+				NEWERROR(term.error, NUMBER_TOO_BIG);
+			x = (int) ((int) ((int) base * x) + (int) (*p - '0'));
+			p++;
+		}
+		term.value = x;
+	} else if (*p == '\'') {
+		term.kind = EVAL_NUMBER;
+		i = 0;
+		x = 0;
+		for (p++; *p; p++) {
+			if (*p == '\'' && *(p + 1) != '\'')
+				break;                      // ending ' found
+			if (*p == '\'')                // ''
+				p++;
+			x = (x << 8) + *p;
+			i++;
+		}
+		if (i == 0 || !*p || !*++p)
+			return (false);
+		if (i == 3)
+			x = x << 8;
+		else if (i > 4)
+			NEWERROR(term.error, ASCII_TOO_BIG);
+		term.value = x;
+	} else if (isalpha(*p) || *p == '.' || *p == '_') {
+		term.kind = EVAL_SYMBOL;
+		i = 0;
+		do {
+			if (i < SIGCHARS)
+				term.name[i++] = *p;
+			p++;
+		} while (isalnum(*p) || *p == '_' || *p == '$');
+		term.name[i] = '\0';
+	} else
+		return (false);
+	term.end = p - start;
+	return (true);
+}
+
+// Compile the expression at text[off] the way eval() reads it. Returns
+// its index in code.exprs, or -1 on a syntax error.
+static int evalCompile(evalCode &code, int off) {
+	int e = code.exprs.size();
+	evalTerm term;
+	const char *p;
+
+	code.exprs.push_back(evalExpr());
+	while (true) {
+		if (!evalCompileTerm(code, off, term))
+			return (-1);
+		code.exprs[e].terms.push_back(term);
+		p = code.text.c_str() + term.end;
+		if (*p == '>' || *p == '<') {   // >> and <<
+			p++;
+			if (*p != *(p - 1))
+				return (-1);
+		}
+		if (precedence(*p)) {
+			code.exprs[e].ops += *p;
+			off = p + 1 - code.text.c_str();
+		} else if (evalEnd(*p)) {
+			code.exprs[e].end = p - code.text.c_str();
+			return (e);
+		} else
+			return (-1);
+	}
+}
+
+// true if no term of expression e reads a symbol or the location
+static bool evalConstant(evalCode &code, int e) {
+	for (size_t i = 0; i < code.exprs[e].terms.size(); i++) {
+		evalTerm &term = code.exprs[e].terms[i];
+		if (term.kind == EVAL_LOC || term.kind == EVAL_SYMBOL || term.error != OK
+				|| (term.kind == EVAL_PAREN && !evalConstant(code, term.expr)))
+			return (false);
+	}
+	return (true);
+}
+
+// Returns the compiled form of the expression at p, or NULL when it
+// cannot be kept now
+static evalCode* evalFind(char *p) {
+	std::unordered_map<std::string_view, evalCode*>::iterator it;
+	bool backRef;
+	int error = OK;
+
+	it = evalIndex.find(std::string_view(p));
+	if (it != evalIndex.end())
+		return (it->second);
+	if (evalCodes.size() >= EVAL_CODES) {
+		if (evalDepth)
+			return (NULL);              // evalRun() is using one of them
+		evalIndex.clear();
+		evalCodes.clear();
+	}
+	evalCodes.push_back(evalCode());
+	evalCode &code = evalCodes.back();
+	code.text = p;
+	code.compiled = (evalCompile(code, 0) == 0);
+	code.folded = false;
+	if (code.compiled && evalConstant(code, 0)) {
+		evalRun(code, 0, p, &code.value, &backRef, &error);
+		code.folded = (error == OK);  // not when dividing by zero
+	}
+	evalIndex[code.text] = &code;
+	return (&code);
+}
+
+// Evaluate a term as evalNumber() does. Returns the offset evalNumber()
+// would return, or -1 for NULL.
+static int evalTermRun(evalCode &code, evalTerm &term, char *p, int *numberPtr,
+		bool *refPtr, int *errorPtr) {
+	char name[SIGCHARS + 1];
+	symbolDef *symbol;
+	int status;
+	int end;
+	int x = 0;
+
+	*refPtr = true;
+	end = term.end;
+	switch (term.kind) {
+	case EVAL_LOC:
+		x = loc;
+		depUseLoc();
+		break;
+	case EVAL_NUMBER:
+		NEWERROR(*errorPtr, term.error);
+		x = term.value;
+		break;
+	case EVAL_PAREN:
+		end = evalRun(code, term.expr, p, &x, refPtr, errorPtr);
+		if (*errorPtr > SEVERE)
+			return (-1);
+		else if (end < 0 || p[end] != ')') {
+			NEWERROR(*errorPtr, SYNTAX);
+			return (-1);
+		}
+		end++;
+		break;
+	case EVAL_SYMBOL:
+		strcpy(name, term.name);
+		status = OK;
+		if (term.symbol && term.generation == symbolGeneration)
+			symbol = term.symbol;
+		else {
+			symbol = lookup(name, false, &status);
+			if (status == UNDEFINED && !pass2 && (symbol = equResolve(name)))
+				status = OK;                // EQU resolved from its expression
+			if (status == OK && *term.name != '.') { // a local label depends
+				term.symbol = symbol;              //   on the last global label
+				term.generation = symbolGeneration;
+			}
+		}
+		if (status == OK)
+			if (!(symbol->flags & REG_LIST_SYM)) {
+				x = symbol->value;
+				if (symbol->flags & REDEFINABLE)
+					cacheNoReplay();      // SET value may differ in pass 2
+				if (pass2) {
+					*refPtr = (symbol->flags & BACKREF) || equBackRef(name, symbol);
+					depUse(name, symbol->flags & REDEFINABLE);
+				} else
+					cacheUse(name);       // for depUse() when the line is replayed
+			} else {
+				x = 0;
+				NEWERROR(*errorPtr, REG_LIST_SPEC);
+			}
+		else {
+			if (pass2) {
+				if ((strncmp(name, ".0", 2)) == 0) {
+					NEWERROR(*errorPtr, ENDI_EXPECTED);
+				} else if ((strncmp(name, ".1", 2)) == 0) {
+					NEWERROR(*errorPtr, ENDW_EXPECTED);
+				} else if ((strncmp(name, ".2", 2)) == 0) {
+					NEWERROR(*errorPtr, ENDF_EXPECTED);
+				} else if ((strncmp(name, ".3", 2)) == 0) {
+					NEWERROR(*errorPtr, REPEAT_EXPECTED);
+				} else {
+					NEWERROR(*errorPtr, UNDEFINED);
+				}
+			} else {
+				relaxValue(name, &x);   // value from previous pass 1
+				NEWERROR(*errorPtr, INCOMPLETE);
+			}
+			*refPtr = false;
+		}
+		break;
+	}
+	for (int i = term.unary.size() - 1; i >= 0; i--)
+		x = (term.unary[i] == '-') ? -x : ~x;
+	*numberPtr = x;
+	return (end);
+}
+
+// Evaluate expression e of code as eval() does. p is the text the code
+// was compiled from. Returns the offset eval() would return, or -1 for
+// NULL.
+static int evalRun(evalCode &code, int e, char *p, int *valuePtr, bool *refPtr,
+		int *errorPtr) {
+	evalExpr &expr = code.exprs[e];
+	int valStack[STACKMAX];
+	char opStack[STACKMAX - 1];
+	int valPtr = 0;
+	int opPtr = 0;
+	int t;
+	int i;
+	int end;
+	int prec;
+	bool evaluate = true;
+	bool backRef;
+	int status;
+
+	*refPtr = true;
+	for (size_t n = 0; ; n++) {
+		status = OK;
+		end = evalTermRun(code, expr.terms[n], p, &t, &backRef, &status);
+		NEWERROR(*errorPtr, status);
+		if (!backRef && status > ERRORN) {
+			*refPtr = false;
+			return (end);
+		} else if (*errorPtr > SEVERE)
+			return (-1);
+		if (evaluate)
+			valStack[valPtr++] = t;
+		*refPtr = (*refPtr && backRef);
+
+		prec = (n < expr.ops.size()) ? precedence(expr.ops[n]) : 0;
+		while (opPtr && evaluate && (prec <= precedence(opStack[opPtr - 1]))) {
+			t = valStack[--valPtr];
+			i = valStack[--valPtr];
+			status = doOp(i, t, opStack[--opPtr], &t);
+			if (status != OK) {
+				if (pass2) {
+					NEWERROR(*errorPtr, status);
+				} else
+					NEWERROR(*errorPtr, INCOMPLETE);
+				evaluate = false;
+				*refPtr = false;
+			} else
+				valStack[valPtr++] = t;
+		}
+		if (!prec) {
+			*valuePtr = (evaluate) ? valStack[--valPtr] : 0;
+			return (expr.end);
+		}
+		if (evaluate)
+			opStack[opPtr++] = expr.ops[n];
+	}
+}
+
+//-------------------------------------------------------
+// Called at the start of an assembly
+int evalStart() {
+	evalIndex.clear();
+	evalCodes.clear();
+	evalDepth = 0;
+	return (NORMAL);
+}
+
 char* eval(char *p, int *valuePtr, bool *refPtr, int *errorPtr) {
 	int valStack[STACKMAX];
 	char opStack[STACKMAX - 1];
@@ -81,6 +463,20 @@ char* eval(char *p, int *valuePtr, bool *refPtr, int *errorPtr) {
 	int status;
 
 	try {
+		// Run the compiled expression if there is one
+		evalCode *code = evalFind(p);
+		if (code && code->folded) {
+			*refPtr = true;
+			*valuePtr = code->value;
+			return (p + code->exprs[0].end);
+		}
+		if (code && code->compiled) {
+			evalDepth++;
+			t = evalRun(*code, 0, p, valuePtr, refPtr, errorPtr);
+			evalDepth--;
+			return ((t < 0) ? NULL : p + t);
+		}
+
 		// Assume that the expression is to be evaluated,
 		//   at least until an undefined symbol is found
 		evaluate = true;
@@ -194,6 +590,7 @@ char* evalNumber(char *p, int *numberPtr, bool *refPtr, int *errorPtr) {
 		//ck   * is current address
 		if (*p == '*') {
 			*numberPtr = loc;
+			depUseLoc();
 			return (++p);
 		} else if (*p == '-') {
 			/* Evaluate unary minus operator recursively */
@@ -304,15 +701,22 @@ char* evalNumber(char *p, int *numberPtr, bool *refPtr, int *errorPtr) {
 			 in a pointer to the symbol table entry */
 			status = OK;
 			symbol = lookup(name, false, &status);
+			if (status == UNDEFINED && !pass2 && (symbol = equResolve(name)))
+				status = OK;              // EQU resolved from its expression
 
 			if (status == OK)
 				/* If symbol was found, and it's not a register
 				 list symbol, then return its value */
 				if (!(symbol->flags & REG_LIST_SYM)) {
 					*numberPtr = symbol->value;
+					if (symbol->flags & REDEFINABLE)
+						cacheNoReplay();      // SET value may differ in pass 2
 
-					if (pass2)
-						*refPtr = (symbol->flags & BACKREF);
+					if (pass2) {
+						*refPtr = (symbol->flags & BACKREF) || equBackRef(name, symbol);
+						depUse(name, symbol->flags & REDEFINABLE);
+					} else
+						cacheUse(name);     // for depUse() when the line is replayed
 				} else {
 					/* If it is a register list symbol, return error */
 					*numberPtr = 0;
@@ -332,8 +736,10 @@ char* evalNumber(char *p, int *numberPtr, bool *refPtr, int *errorPtr) {
 					} else {
 						NEWERROR(*errorPtr, UNDEFINED);
 					}
-				} else
+				} else {
+					relaxValue(name, numberPtr);  // value from previous pass 1
 					NEWERROR(*errorPtr, INCOMPLETE);
+				}
 				*refPtr = false;
 			}
 
@@ -18,7 +18,7 @@
 
 // General
 
-int loc;		// The assembler's location counter
+thread_local int loc;	// The assembler's location counter (one per encoding thread)
 int locOffset;        // loc is saved here during processing of Offset directive
 int sectionLoc[16];    // section locations
 int sectI;             // current section
@@ -46,6 +46,8 @@ FILE *objFile;		// Object file (S-Record)
 FILE *binFile;          //ck Object file (Binary)
 FILE *tmpFile;          //ck temp file
 FILE *errFile;          //ck Error messages file (text)
+char listName[256];     // name of listing file
+char objName[256];      // name of S-Record file
 
 // Listing information
 char line[256];		// Source line
@@ -63,6 +65,17 @@ bool CREflag;           // true adds symbol table to listing
 bool MEXflag;           // true expands macro calls in listing
 bool SEXflag;           // true expands structured code in listing
 bool WARflag;           // true shows Warnings during assembly
+bool PIPEflag;          // true reads and lexes source on separate threads
+bool RELAXflag;         // true repeats pass 1 to shorten forward branches
+bool EAOPTflag;         // true picks the shortest addressing modes
+bool PEEPflag;          // true replaces slow instruction forms
+bool CHAINflag;         // true collapses structured branch chains
+bool LOOPflag;          // true tests structured loops at the bottom
+bool UNROLLflag;        // true unrolls FOR loops with constant bounds
+bool CYCLEflag;         // true lists clock cycles of instructions
+bool HOTflag;           // true ranks the costliest loops and subroutines
+bool ADVISEflag;        // true lists faster forms of instructions
+int unrollBudget = 64;  // most instructions of an unrolled FOR
 bool noFileName;        // true indicates no name for current source file
 
 // Editor flags
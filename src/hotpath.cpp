@@ -0,0 +1,546 @@
+/***********************************************************************
+ *
+ *		HOTPATH.CPP
+ *		Loop and Subroutine Cycle Analysis for 68000 Assembler
+ *
+ *    Function: hotInst(), hotLabel(), hotTrips()
+ *		With OPT HOT, pass 2 keeps each instruction output with
+ *		its clock cycles, passed on by cycleFlush(), the global
+ *		labels on code, passed on by cycleLabel(), and the trip
+ *		counts of FOR loops with constant bounds, given by
+ *		asmStructure() and unrollFor() at the top of the loop.
+ *
+ *		hotList()
+ *		Called by finishList(). The flow of the program is
+ *		taken from the branches, jumps and calls of the
+ *		instructions, so the labels made by structured code are
+ *		followed like any other. A backward branch makes a loop
+ *		from its target to the branch, and loops inside it are
+ *		nested in it. One trip of a loop is timed as the longest
+ *		path through its body, with the most cycles of each
+ *		instruction, a nested loop counted as all of its trips
+ *		and a call as the cycles of the subroutine. A branch
+ *		into the middle of a nested loop enters it at its top.
+ *		A subroutine, the target of a BSR or JSR, is timed the
+ *		same way from its entry to its returns.
+ *
+ *		The trips of a loop are those of a FOR with constant
+ *		bounds or, for a loop closed by DBcc, one more than the
+ *		MOVEQ or MOVE #n that loads the counter right before
+ *		the loop. A BRA to the DBcc between the two means the
+ *		first trip is skipped. For DBcc other than DBRA this is
+ *		the most trips the loop can make. A loop of unknown
+ *		trips is counted once. Cycles that rest on an unknown
+ *		trip count, an untimed instruction, an indirect jump or
+ *		call or a recursive call are marked "+?".
+ *
+ *		The listing ranks the costliest loops and subroutines.
+ *
+ ************************************************************************/
+
+#include <cstdio>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "../include/asm.h"
+#include "../include/hotpath.h"
+
+extern thread_local int loc;
+extern bool pass2;
+extern bool HOTflag;            // true ranks the costliest loops and subroutines
+
+const int HOT_RANKED = 20;        // loops and subroutines listed
+
+// Flow of control after an instruction
+const char HOT_NEXT = 0;          // next instruction
+const char HOT_BRANCH = 1;        // next instruction or target, Bcc
+const char HOT_DBCC = 2;          // next instruction or target, DBcc
+const char HOT_JUMP = 3;          // target, BRA or JMP
+const char HOT_CALL = 4;          // target, then next instruction
+const char HOT_RETURN = 5;        // leaves the subroutine
+const char HOT_EXIT = 6;          // unknown, JMP through a register
+
+struct hotCode {
+	int addr;
+	int length;
+	int line;                     // listing line number
+	int cycles;                   // most clock cycles
+	bool timed;
+	char kind;                    // HOT_NEXT ...
+	int target;                   // address branched to, -1 if not known
+	int reg;                      // DBcc counter or data register loaded, or -1
+	long value;                   // immediate loaded into reg
+};
+
+struct hotCost {
+	long long cycles;
+	bool unknown;                 // rests on something not known
+};
+
+struct hotLoop {
+	int head;                     // index of the first instruction
+	int tail;                     // index of the last branch back to head
+	int depth;                    // loops it is nested in
+	long long trips;              // -1 if not known
+	int state;                    // 0 not timed, 1 being timed, 2 timed
+	hotCost trip;                 // one trip
+	hotCost total;                // all trips
+};
+
+struct hotSub {
+	int calls;                    // BSR and JSR to the entry
+	int state;                    // 0 not timed, 1 being timed, 2 timed
+	hotCost total;
+};
+
+// Longest paths from the first instruction of a region
+struct hotWalk {
+	int first;                    // indexes of the region
+	int last;
+	int self;                     // loop timed, -1 for a subroutine
+	int reach;                    // furthest instruction reached
+	std::vector<long long> dist;  // most cycles to each instruction, -1 if none
+	hotCost cost;                 // most cycles leaving the region
+};
+
+static std::vector<hotCode> hotCodes;         // instructions output in pass 2
+static std::map<int, std::string> hotLabels;  // global labels by address
+static std::map<int, long long> hotFor;       // FOR trips by address of the top
+static std::vector<hotLoop> hotLoops;         // by index of head
+static std::vector<int> hotLoopAt;            // loop with its head at an index, or -1
+static std::map<int, hotSub> hotSubs;         // by index of entry
+static bool hotFlag;                          // HOTflag at start of assembly
+
+static hotCost hotLoopCost(int n);
+static hotCost hotSubCost(int entry);
+
+//------------------------------------------------------------
+// Called at the start of an assembly
+int hotStart() {
+	hotFlag = HOTflag;
+	return (NORMAL);
+}
+
+// Called at the start of each pass
+int hotPass() {
+	HOTflag = hotFlag;
+	hotCodes.clear();
+	hotLabels.clear();
+	hotFor.clear();
+	hotLoops.clear();
+	hotLoopAt.clear();
+	hotSubs.clear();
+	return (NORMAL);
+}
+
+// Big endian word and long at code
+static int hotWord(const unsigned char *code) {
+	return ((code[0] << 8) | code[1]);
+}
+
+static int hotLong(const unsigned char *code) {
+	return ((hotWord(code) << 16) | hotWord(code + 2));
+}
+
+// Address of a JMP or JSR with mode field ea, or -1 if it is not known
+static int hotTarget(int addr, const unsigned char *code, int length, int ea) {
+	if (ea == 0x38 && length >= 4)            // abs.W
+		return ((short) hotWord(code + 2));
+	if (ea == 0x39 && length >= 6)            // abs.L
+		return (hotLong(code + 2));
+	if (ea == 0x3A && length >= 4)            // d16(PC)
+		return (addr + 2 + (short) hotWord(code + 2));
+	return (-1);
+}
+
+//------------------------------------------------------------
+// Called by cycleFlush() for each instruction output in pass 2
+int hotInst(int addr, const unsigned char *code, int length, int line,
+		int cycles, bool timed) {
+	hotCode c;
+	int word;
+	int disp;
+
+	if (!pass2 || !HOTflag || length < 2)
+		return (NORMAL);
+	word = hotWord(code);
+	c.addr = addr;
+	c.length = length;
+	c.line = line;
+	c.cycles = (timed) ? cycles : 0;
+	c.timed = timed;
+	c.kind = HOT_NEXT;
+	c.target = -1;
+	c.reg = -1;
+	c.value = 0;
+	if ((word & 0xF000) == 0x6000) {          // Bcc, BRA, BSR
+		disp = (signed char) word;
+		if (disp == 0 && length >= 4)
+			disp = (short) hotWord(code + 2);
+		else if (disp == -1 && length >= 6)
+			disp = hotLong(code + 2);
+		c.target = addr + 2 + disp;
+		c.kind = ((word & 0x0F00) == 0x0000) ? HOT_JUMP :
+				((word & 0x0F00) == 0x0100) ? HOT_CALL : HOT_BRANCH;
+	} else if ((word & 0xF0F8) == 0x50C8 && length >= 4) {  // DBcc
+		if ((word & 0x0F00) != 0x0000) {      // DBT never branches
+			c.kind = HOT_DBCC;
+			c.target = addr + 2 + (short) hotWord(code + 2);
+			c.reg = word & 7;
+		}
+	} else if ((word & 0xFF80) == 0x4E80) {   // JSR, JMP
+		c.target = hotTarget(addr, code, length, word & 0x3F);
+		if (!(word & 0x0040))
+			c.kind = HOT_CALL;
+		else
+			c.kind = (c.target < 0) ? HOT_EXIT : HOT_JUMP;
+	} else if (word == 0x4E75 || word == 0x4E73 || word == 0x4E77
+			|| word == 0x4E72)                    // RTS, RTE, RTR, STOP
+		c.kind = HOT_RETURN;
+	else if ((word & 0xF100) == 0x7000) {     // MOVEQ #n,Dn
+		c.reg = (word >> 9) & 7;
+		c.value = (signed char) word;
+	} else if ((word & 0xF1FF) == 0x303C && length >= 4) {  // MOVE.W #n,Dn
+		c.reg = (word >> 9) & 7;
+		c.value = (short) hotWord(code + 2);
+	} else if ((word & 0xF1FF) == 0x203C && length >= 6) {  // MOVE.L #n,Dn
+		c.reg = (word >> 9) & 7;
+		c.value = hotLong(code + 2);
+	}
+	hotCodes.push_back(c);
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Called by cycleLabel() for a global label on code in pass 2
+int hotLabel(const char *sym, int value) {
+	if (!pass2 || !HOTflag)
+		return (NORMAL);
+	hotLabels.emplace(value, sym);
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Called at the top of a loop that runs count times
+int hotTrips(long long count) {
+	if (!pass2 || !HOTflag)
+		return (NORMAL);
+	hotFor[loc] = count;
+	return (NORMAL);
+}
+
+// Index of the instruction at addr, or -1
+static int hotIndex(int addr) {
+	int low = 0;
+	int high = hotCodes.size() - 1;
+
+	while (low <= high) {
+		int mid = (low + high) / 2;
+		if (hotCodes[mid].addr == addr)
+			return (mid);
+		if (hotCodes[mid].addr < addr)
+			low = mid + 1;
+		else
+			high = mid - 1;
+	}
+	return (-1);
+}
+
+// true if instruction i + 1 directly follows instruction i
+static bool hotFollows(int i) {
+	return (hotCodes[i].addr + hotCodes[i].length == hotCodes[i + 1].addr);
+}
+
+// Trips of a loop, -1 if not known
+static long long hotCount(const hotLoop &loop) {
+	std::map<int, long long>::iterator it;
+	const hotCode &tail = hotCodes[loop.tail];
+	long long first = 1;              // trip before the DBcc first counts
+	int j = loop.head - 1;
+
+	it = hotFor.find(hotCodes[loop.head].addr);
+	if (it != hotFor.end())
+		return (it->second);
+	if (tail.kind != HOT_DBCC)
+		return (-1);
+	if (j >= 0 && hotFollows(j) && hotCodes[j].kind == HOT_JUMP
+			&& hotCodes[j].target > hotCodes[loop.head].addr
+			&& hotCodes[j].target <= tail.addr) {  // BRA to the DBcc
+		first = 0;
+		j--;
+	}
+	for (int k = 0; k < 4 && j >= 0 && hotFollows(j); k++, j--) {
+		if (hotCodes[j].kind != HOT_NEXT)
+			break;
+		if (hotCodes[j].reg == tail.reg)
+			return ((hotCodes[j].value & 0xFFFF) + first);
+	}
+	return (-1);
+}
+
+// Find the loops and subroutines of the program
+static int hotBuild() {
+	int h;
+
+	std::stable_sort(hotCodes.begin(), hotCodes.end(),
+			[](const hotCode &a, const hotCode &b) { return (a.addr < b.addr); });
+	hotCodes.erase(std::unique(hotCodes.begin(), hotCodes.end(),
+			[](const hotCode &a, const hotCode &b) { return (a.addr == b.addr); }),
+			hotCodes.end());
+	hotLoopAt.assign(hotCodes.size(), -1);
+	for (size_t i = 0; i < hotCodes.size(); i++) {
+		hotCode &c = hotCodes[i];
+		if (c.kind == HOT_CALL && (h = hotIndex(c.target)) >= 0)
+			hotSubs[h].calls++;
+		if ((c.kind != HOT_BRANCH && c.kind != HOT_DBCC && c.kind != HOT_JUMP)
+				|| c.target > c.addr || (h = hotIndex(c.target)) < 0)
+			continue;
+		if (hotLoopAt[h] < 0) {
+			hotLoop loop = hotLoop();
+			loop.head = h;
+			hotLoopAt[h] = hotLoops.size();
+			hotLoops.push_back(loop);
+		}
+		hotLoops[hotLoopAt[h]].tail = i;      // branches back come in order
+	}
+	std::sort(hotLoops.begin(), hotLoops.end(),
+			[](const hotLoop &a, const hotLoop &b) { return (a.head < b.head); });
+	for (size_t n = 0; n < hotLoops.size(); n++) {
+		hotLoop &loop = hotLoops[n];
+		hotLoopAt[loop.head] = n;
+		loop.trips = hotCount(loop);
+		for (size_t m = 0; m < n; m++)
+			if (hotLoops[m].tail >= loop.tail)
+				loop.depth++;
+	}
+	return (NORMAL);
+}
+
+// Add cycles leaving the region
+static int hotLeave(hotWalk &w, long long d) {
+	w.cost.cycles = std::max(w.cost.cycles, d);
+	return (NORMAL);
+}
+
+// Reach instruction i with d cycles
+static int hotArrive(hotWalk &w, int i, long long d) {
+	if (i > w.last)
+		return (hotLeave(w, d));
+	w.dist[i - w.first] = std::max(w.dist[i - w.first], d);
+	w.reach = std::max(w.reach, i);
+	return (NORMAL);
+}
+
+// Index of the top of the outermost loop of the region that i is inside
+// of, or i
+static int hotOuter(const hotWalk &w, int i) {
+	size_t n = std::lower_bound(hotLoops.begin(), hotLoops.end(), w.first,
+			[](const hotLoop &loop, int head) { return (loop.head < head); })
+			- hotLoops.begin();
+
+	for (; n < hotLoops.size() && hotLoops[n].head < i; n++) {
+		const hotLoop &loop = hotLoops[n];
+		if ((int) n != w.self && loop.tail <= w.last && i <= loop.tail)
+			return (loop.head);
+	}
+	return (i);
+}
+
+// Branch with d cycles from instruction from to addr. Branches back and
+// out of the region leave it.
+static int hotBranch(hotWalk &w, int from, int addr, long long d) {
+	int i = (addr < 0) ? -1 : hotIndex(addr);
+
+	if (i <= from || i > w.last)
+		return (hotLeave(w, d));
+	return (hotArrive(w, hotOuter(w, i), d));
+}
+
+// Most cycles through the instructions from first to last, up to a
+// return, a branch out of them or a branch back. Loops inside them other
+// than self are timed as a whole.
+static hotCost hotPath(int first, int last, int self) {
+	hotWalk w;
+	hotCost c;
+	long long d;
+	int n;
+
+	w.first = first;
+	w.last = last;
+	w.self = self;
+	w.reach = first;
+	w.dist.assign(last - first + 1, -1);
+	w.dist[0] = 0;
+	w.cost.cycles = 0;
+	w.cost.unknown = false;
+	for (int i = first; i <= last && i <= w.reach; i++) {
+		d = w.dist[i - first];
+		n = hotLoopAt[i];
+		if (n >= 0 && n != self && hotLoops[n].tail <= last) {
+			int tail = hotLoops[n].tail;
+			if (d >= 0) {                       // the loop, then its exits
+				c = hotLoopCost(n);
+				d += c.cycles;
+				w.cost.unknown |= c.unknown;
+				hotArrive(w, tail + 1, d);
+				for (int j = i; j <= tail; j++) {
+					const hotCode &exit = hotCodes[j];
+					int to = hotIndex(exit.target);
+					if (exit.kind == HOT_RETURN || exit.kind == HOT_EXIT)
+						hotLeave(w, d);
+					else if (exit.kind != HOT_NEXT && exit.kind != HOT_CALL
+							&& (to < i || to > tail))  // out of the loop
+						hotBranch(w, tail, exit.target, d);
+				}
+			}
+			i = tail;
+			continue;
+		}
+		if (d < 0)                            // not reached
+			continue;
+		const hotCode &code = hotCodes[i];
+		d += code.cycles;
+		w.cost.unknown |= !code.timed;
+		switch (code.kind) {
+		case HOT_CALL:
+			if ((n = hotIndex(code.target)) < 0)
+				w.cost.unknown = true;
+			else {
+				c = hotSubCost(n);
+				d += c.cycles;
+				w.cost.unknown |= c.unknown;
+			}
+			hotArrive(w, i + 1, d);
+			break;
+		case HOT_BRANCH:
+		case HOT_DBCC:
+			hotArrive(w, i + 1, d);
+			hotBranch(w, i, code.target, d);
+			break;
+		case HOT_JUMP:
+			hotBranch(w, i, code.target, d);
+			break;
+		case HOT_EXIT:
+			w.cost.unknown = true;
+			hotLeave(w, d);
+			break;
+		case HOT_RETURN:
+			hotLeave(w, d);
+			break;
+		default:
+			hotArrive(w, i + 1, d);
+		}
+	}
+	return (w.cost);
+}
+
+// Cycles of all trips of loop n
+static hotCost hotLoopCost(int n) {
+	hotLoop &loop = hotLoops[n];
+
+	if (loop.state == 1) {
+		hotCost c = { 0, true };
+		return (c);
+	}
+	if (loop.state == 0) {
+		loop.state = 1;
+		loop.trip = hotPath(loop.head, loop.tail, n);
+		loop.total = loop.trip;
+		if (loop.trips >= 0)
+			loop.total.cycles *= loop.trips;
+		else
+			loop.total.unknown = true;
+		loop.state = 2;
+	}
+	return (loop.total);
+}
+
+// Cycles of the subroutine at index entry
+static hotCost hotSubCost(int entry) {
+	hotSub &sub = hotSubs[entry];
+
+	if (sub.state == 1) {                   // recursive call
+		hotCost c = { 0, true };
+		return (c);
+	}
+	if (sub.state == 0) {
+		sub.state = 1;
+		sub.total = hotPath(entry, hotCodes.size() - 1, -1);
+		sub.state = 2;
+	}
+	return (sub.total);
+}
+
+// Write cycles, with "+?" when they rest on something not known
+static char* hotFormat(char *text, const hotCost &c) {
+	sprintf(text, "%lld%s", c.cycles, (c.unknown) ? "+?" : "");
+	return (text);
+}
+
+// Nearest global label at or before addr, or "*"
+static const char* hotName(int addr) {
+	std::map<int, std::string>::iterator it = hotLabels.upper_bound(addr);
+
+	if (it == hotLabels.begin())
+		return ("*");
+	--it;
+	return (it->second.c_str());
+}
+
+//------------------------------------------------------------
+// Write the costliest loops and subroutines to the listing
+int hotList(FILE *listFile) {
+	std::vector<int> loops;
+	std::vector<int> subs;
+	std::map<int, hotSub>::iterator it;
+	char trips[24];
+	char text[2][32];
+
+	if (hotCodes.empty())
+		return (NORMAL);
+	hotBuild();
+	for (size_t n = 0; n < hotLoops.size(); n++) {
+		hotLoopCost(n);
+		loops.push_back(n);
+	}
+	for (it = hotSubs.begin(); it != hotSubs.end(); ++it) {
+		hotSubCost(it->first);
+		subs.push_back(it->first);
+	}
+	std::stable_sort(loops.begin(), loops.end(), [](int a, int b) {
+		return (hotLoops[a].total.cycles > hotLoops[b].total.cycles);
+	});
+	std::stable_sort(subs.begin(), subs.end(), [](int a, int b) {
+		return (hotSubs[a].total.cycles > hotSubs[b].total.cycles);
+	});
+	fprintf(listFile, "Hot paths: %d loop%s, %d subroutine%s\n",
+			(int) loops.size(), (loops.size() != 1) ? "s" : "",
+			(int) subs.size(), (subs.size() != 1) ? "s" : "");
+
+	fprintf(listFile, "\n\nLOOP CYCLE INFORMATION\n");
+	fprintf(listFile, "Line    Address   Depth  Trips   Cycles/Trip     Cycles            Label\n");
+	fprintf(listFile, "------------------------------------------------------------------------\n");
+	for (size_t k = 0; k < loops.size() && k < HOT_RANKED; k++) {
+		hotLoop &loop = hotLoops[loops[k]];
+		if (loop.trips >= 0)
+			sprintf(trips, "%lld", loop.trips);
+		else
+			sprintf(trips, "?");
+		fprintf(listFile, "%6d  %08X  %5d  %-6s  %-14s  %-16s  %s\n",
+				hotCodes[loop.head].line, hotCodes[loop.head].addr, loop.depth,
+				trips, hotFormat(text[0], loop.trip), hotFormat(text[1], loop.total),
+				hotName(hotCodes[loop.head].addr));
+	}
+
+	fprintf(listFile, "\n\nSUBROUTINE CYCLE INFORMATION\n");
+	fprintf(listFile, "Line    Address   Calls  Cycles            Label\n");
+	fprintf(listFile, "------------------------------------------------\n");
+	for (size_t k = 0; k < subs.size() && k < HOT_RANKED; k++) {
+		hotSub &sub = hotSubs[subs[k]];
+		fprintf(listFile, "%6d  %08X  %5d  %-16s  %s\n", hotCodes[subs[k]].line,
+				hotCodes[subs[k]].addr, sub.calls, hotFormat(text[0], sub.total),
+				hotName(hotCodes[subs[k]].addr));
+	}
+	return (NORMAL);
+}
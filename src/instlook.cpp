@@ -41,6 +41,7 @@
 
 #include <cstdio>
 #include <cctype>
+#include <cstring>
 #include "../include/asm.h"
 #include "../include/symbol.h"
 #include "../include/build.h"
@@ -49,8 +50,8 @@
 #include <map>
 #include <string>
 
-//extern instruction instTable[];
-//extern int tableSize;
+extern instruction instTable[];
+extern int tableSize;
 extern int macroFP;            // location of macro in input file
 extern char buffer[256];  //ck used to form messages for display in windows
 extern bool BITflag;
@@ -97,58 +98,49 @@ char* instLookup(char *p, instruction *(*instPtrPtr), char *sizePtr,
 		} else
 			*sizePtr = 0;
 
-//		int lo = 0;
-//		int hi = tableSize - 1;
-//		int mid = (hi + lo) / 2;
-//
-//		// search for opcode in instTable
-//		int cmp = 0;
-//		do {
-//			mid = (hi + lo) / 2;
-//			cmp = strcmp(opcode, instTable[mid].mnemonic);
-//			if (cmp > 0)
-//				lo = mid + 1;
-//			else if (cmp < 0)
-//				hi = mid - 1;
-//		} while (cmp && (hi >= lo));
+		int lo = 0;
+		int hi = tableSize - 1;
+		int mid = (hi + lo) / 2;
 
-//		if ( auto instrIter{ instTable.find( "key" ) }; instrIter != std::end( instTable ) ) {
-//		// if opcode found
-////		if (!cmp) {
-////			// if bitfield instruction and BITflag is false
-////			if (instTable[mid].flavorPtr
-////					&& instTable[mid].flavorPtr->exec == bitField && !BITflag) {
-////				NEWERROR(*errorPtr, INV_OPCODE);        // error invalid opcode
-////				return (NULL);
-////			}
-////			*instPtrPtr = &instTable[mid];
-////			return (p);
-//			const auto&[ key, value ] { *instrIter };
-//			instruction instr = value;
-//			if (instr.flavorPtr && instr.flavorPtr->exec == bitField && !BITflag) {
-//				NEWERROR(*errorPtr, INV_OPCODE);        // error invalid opcode
-//				return (NULL);
-//			}
-//			*instPtrPtr = &instr;
-//			return (p);
+		// search for opcode in instTable
+		int cmp = 0;
+		do {
+			mid = (hi + lo) / 2;
+			cmp = strcmp(opcode, instTable[mid].mnemonic);
+			if (cmp > 0)
+				lo = mid + 1;
+			else if (cmp < 0)
+				hi = mid - 1;
+		} while (cmp && (hi >= lo));
+
+		// if opcode found
+		if (!cmp) {
+			// if bitfield instruction and BITflag is false
+			if (instTable[mid].flavorPtr
+					&& instTable[mid].flavorPtr->exec == bitField && !BITflag) {
+				NEWERROR(*errorPtr, INV_OPCODE);        // error invalid opcode
+				return (NULL);
+			}
+			*instPtrPtr = &instTable[mid];
+			return (p);
 			// else, opcode not found
-//		} else {
-//
-//			// search for matching macro definition in symbol table
-//			symbol = lookup(opcode, false, errorPtr);
-//			if ((*errorPtr < ERRORN) && (symbol->flags & MACRO_SYM)) { // if found
-//				if (pass2 && !(symbol->flags & BACKREF)) // if forward reference
-//					NEWERROR(*errorPtr, FORWARD_REF);     // warning
-//				*instPtrPtr = &asmMac;   // point to asmMac function description
-//				macroFP = symbol->value;  // get file pointer to macro
-//				return (p);                // return pointer to macro parameters
-//			} else {
-//
-//				// not a macro call either, so must be invalid opcode
-//				NEWERROR(*errorPtr, INV_OPCODE);
-//				return (NULL);
-//			}
-//		}
+		} else {
+
+			// search for matching macro definition in symbol table
+			symbol = lookup(opcode, false, errorPtr);
+			if ((*errorPtr < ERRORN) && (symbol->flags & MACRO_SYM)) { // if found
+				if (pass2 && !(symbol->flags & BACKREF)) // if forward reference
+					NEWERROR(*errorPtr, FORWARD_REF);     // warning
+				*instPtrPtr = &asmMac;   // point to asmMac function description
+				macroFP = symbol->value;  // get file pointer to macro
+				return (p);                // return pointer to macro parameters
+			} else {
+
+				// not a macro call either, so must be invalid opcode
+				NEWERROR(*errorPtr, INV_OPCODE);
+				return (NULL);
+			}
+		}
 	} catch (...) {
 		NEWERROR(*errorPtr, EXCEPTION);
 		sprintf(buffer,
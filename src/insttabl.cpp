@@ -58,6 +58,7 @@
 #include "../include/directive.h"
 #include "../include/structured.h"
 #include "../include/movem.h"
+#include "../include/unroll.h"
 #include "../include/macro.h"
 #include "../include/build.h"
 #include <map>
@@ -515,176 +516,182 @@ flavor unlkfl[] = { { AnDirect, 0, 0, oneReg, 0, 0x4E58, 0 } };
 #define flavorCount(flavorArray) (sizeof(flavorArray)/sizeof(flavor))
 
 /* The instruction table itself... */
-//// Instructions MUST BE IN ALPHABETICAL ORDER
-//instruction instTable[] = {
-//		{ "ABCD", abcdfl, flavorCount(abcdfl), true, NULL },
-//		{ "ADD", addfl, flavorCount(addfl), true, NULL },
-//		{ "ADDA", addafl, flavorCount(addafl), true, NULL },
-//		{ "ADDI", addifl, flavorCount(addifl), true, NULL },
-//		{ "ADDQ", addqfl, flavorCount(addqfl), true, NULL },
-//		{ "ADDX", addxfl, flavorCount(addxfl), true, NULL },
-//		{ "AND", andfl, flavorCount( andfl), true, NULL },
-//		{ "ANDI", andifl, flavorCount(andifl), true, NULL },
-//		{ "ASL", aslfl, flavorCount(aslfl), true, NULL },
-//		{ "ASR", asrfl, flavorCount(asrfl), true, NULL },
-//		{ "BCC", bccfl, flavorCount(bccfl), true, NULL },
-//		{ "BCHG", bchgfl, flavorCount(bchgfl), true, NULL },
-//		{ "BCLR", bclrfl, flavorCount(bclrfl), true, NULL },
-//		{ "BCS", bcsfl, flavorCount(bcsfl), true, NULL },
-//		{ "BEQ", beqfl, flavorCount(beqfl), true, NULL },
-//		{ "BFCHG", bfchgfl, flavorCount(bfchgfl), true, NULL },
-//		{ "BFCLR", bfclrfl,flavorCount(bfclrfl), true, NULL },
-//		{ "BFEXTS", bfextsfl,flavorCount(bfextsfl), true, NULL },
-//		{ "BFEXTU", bfextufl,flavorCount(bfextufl), true, NULL },
-//		{ "BFFFO", bfffofl, flavorCount(bfffofl), true, NULL },
-//		{ "BFINS", bfinsfl, flavorCount(bfinsfl), true, NULL },
-//		{ "BFSET", bfsetfl, flavorCount(bfsetfl), true, NULL },
-//		{ "BFTST", bftstfl, flavorCount(bftstfl), true, NULL },
-//		{ "BGE", bgefl, flavorCount( bgefl), true, NULL },
-//		{ "BGT", bgtfl, flavorCount(bgtfl), true, NULL },
-//		{ "BHI", bhifl, flavorCount(bhifl), true, NULL },
-//		{ "BHS", bccfl, flavorCount(bccfl), true, NULL },
-//		{ "BLE", blefl, flavorCount(blefl), true, NULL },
-//		{ "BLO", bcsfl, flavorCount(bcsfl), true, NULL },
-//		{ "BLS", blsfl, flavorCount(blsfl), true,NULL },
-//		{ "BLT", bltfl, flavorCount(bltfl), true, NULL },
-//		{ "BMI", bmifl, flavorCount(bmifl), true, NULL },
-//		{ "BNE", bnefl, flavorCount(bnefl), true, NULL },
-//		{ "BPL", bplfl, flavorCount(bplfl), true, NULL },
-//		{ "BRA", brafl, flavorCount(brafl), true, NULL },
-//		{ "BSET", bsetfl, flavorCount(bsetfl), true, NULL },
-//		{ "BSR", bsrfl, flavorCount(bsrfl), true, NULL },
-//		{ "BTST", btstfl, flavorCount(btstfl), true, NULL },
-//		{ "BVC", bvcfl, flavorCount( bvcfl), true, NULL },
-//		{ "BVS", bvsfl, flavorCount(bvsfl), true, NULL },
-//		{ "CHK", chkfl, flavorCount(chkfl), true, NULL },
-//		{ "CLR", clrfl, flavorCount(clrfl), true, NULL },
-//		{ "CMP", cmpfl, flavorCount(cmpfl), true, NULL },
-//		{ "CMPA", cmpafl, flavorCount(cmpafl), true, NULL },
-//		{ "CMPI", cmpifl, flavorCount(cmpifl), true, NULL },
-//		{ "CMPM", cmpmfl, flavorCount(cmpmfl), true, NULL },
-//		{ "DBCC", dbccfl, flavorCount(dbccfl), true, NULL },
-//		{ "DBCS", dbcsfl, flavorCount(dbcsfl), true, NULL },
-//		{ "DBEQ", dbeqfl, flavorCount(dbeqfl), true, NULL },
-//		{ "DBF", dbffl, flavorCount(dbffl), true, NULL },
-//		{ "DBGE", dbgefl, flavorCount(dbgefl), true, NULL },
-//		{ "DBGT", dbgtfl, flavorCount(dbgtfl), true, NULL },
-//		{ "DBHI", dbhifl,flavorCount(dbhifl), true, NULL },
-//		{ "DBHS", dbccfl,flavorCount(dbccfl), true, NULL },
-//		{ "DBLE", dblefl, flavorCount(dblefl), true, NULL },
-//		{ "DBLO", dbcsfl, flavorCount(dbcsfl), true, NULL },
-//		{ "DBLOOP", NULL, 0, false, asmStructure },
-//		{ "DBLS", dblsfl, flavorCount(dblsfl), true, NULL },
-//		{ "DBLT", dbltfl, flavorCount(dbltfl), true, NULL },
-//		{ "DBMI", dbmifl, flavorCount(dbmifl), true, NULL },
-//		{ "DBNE", dbnefl, flavorCount(dbnefl), true, NULL },
-//		{ "DBPL", dbplfl, flavorCount(dbplfl), true, NULL },
-//		{ "DBRA", dbrafl, flavorCount(dbrafl), true, NULL },
-//		{ "DBT", dbtfl, flavorCount(dbtfl), true, NULL },
-//		{ "DBVC", dbvcfl, flavorCount(dbvcfl), true, NULL },
-//		{ "DBVS", dbvsfl, flavorCount(dbvsfl), true, NULL },
-//		{ "DC", NULL, 0,false, dc },
-//		{ "DCB", NULL, 0, false, dcb },
-//		{ "DIVS", divsfl, flavorCount(divsfl), true, NULL },
-//		{ "DIVU", divufl,flavorCount(divufl), true, NULL },
-//		{ "DS", NULL, 0, false, ds },
-//		{ "ELSE", NULL, 0, false, asmStructure },
-//		{ "END", NULL, 0, false, funct_end },
-//		{ "ENDF", NULL, 0, false, asmStructure },
-//		{ "ENDI", NULL, 0, false, asmStructure },
-//		{ "ENDW", NULL, 0, false, asmStructure },
-//		{ "EOR", eorfl, flavorCount(eorfl), true, NULL },
-//		{ "EORI", eorifl, flavorCount(eorifl), true, NULL },
-//		{ "EQU", NULL, 0, false, equ },
-//		{ "EXG", exgfl, flavorCount(exgfl), true, NULL },
-//		{ "EXT", extfl, flavorCount(extfl), true, NULL },
-//		{ "FAIL", NULL, 0, false, failError },
-//		{ "FOR", NULL, 0, false, asmStructure },
-//		{ "IF", NULL, 0, false, asmStructure },
-//		{ "ILLEGAL", illegalfl, flavorCount(illegalfl), true, NULL },
-//		{ "INCBIN", NULL, 0, false, incbin },
-//		{ "INCLUDE", NULL, 0, false, include },
-//		{ "JMP", jmpfl, flavorCount(jmpfl), true, NULL },
-//		{ "JSR", jsrfl, flavorCount(jsrfl), true, NULL },
-//		{ "LEA", leafl, flavorCount(leafl), true, NULL },
-//		{ "LINK", linkfl, flavorCount(linkfl), true, NULL },
-//		{ "LIST", NULL, 0, false, listOn },
-//		{ "LSL", lslfl, flavorCount(lslfl), true, NULL },
-//		{ "LSR", lsrfl, flavorCount(lsrfl), true, NULL },
-//		{ "MACRO", NULL, 0, false, macro },
-//		{ "MEMORY", NULL, 0, false, memory },
-//		{ "MOVE", movefl, flavorCount(movefl), true, NULL },
-//		{ "MOVEA", moveafl, flavorCount(moveafl), true, NULL },
-//		//{ "MOVEC", movecfl, flavorCount(movecfl), true, NULL },
-//		{ "MOVEM", movefl, 0, false, movem },
-//		// movefl is only used for syntax highlighting
-//		{ "MOVEP", movepfl, flavorCount(movepfl), true, NULL },
-//		{ "MOVEQ", moveqfl, flavorCount(moveqfl), true, NULL },
-//		//{ "MOVES", movesfl, flavorCount(movesfl), true, NULL },
-//		{ "MULS", mulsfl, flavorCount(mulsfl), true, NULL },
-//		{ "MULU", mulufl, flavorCount(mulufl), true, NULL },
-//		{ "NBCD", nbcdfl, flavorCount(nbcdfl), true, NULL },
-//		{ "NEG", negfl, flavorCount(negfl), true, NULL },
-//		{ "NEGX", negxfl, flavorCount(negxfl), true, NULL },
-//		{ "NOLIST", NULL, 0, false, listOff },
-//		{ "NOP", nopfl, flavorCount(nopfl), true, NULL },
-//		{ "NOT", notfl, flavorCount(notfl), true, NULL },
-//		{ "OFFSET", NULL, 0, false, offset },
-//		{ "OPT", NULL, 0, false, opt },
-//		{ "OR", orfl, flavorCount(orfl), true, NULL },
-//		{ "ORG", NULL, 0, false, org },
-//		{ "ORI", orifl, flavorCount(orifl), true, NULL },
-//		{ "PAGE", NULL, 0, false, page },
-//		{ "PEA", peafl, flavorCount(peafl), true, NULL },
-//		{ "REG", NULL, 0, false, reg },
-//		{ "REPEAT", NULL, 0, false, asmStructure },
-//		{ "RESET", resetfl, flavorCount(resetfl), true, NULL },
-//		{ "ROL", rolfl, flavorCount( rolfl), true, NULL },
-//		{ "ROR", rorfl, flavorCount(rorfl), true, NULL },
-//		{ "ROXL", roxlfl, flavorCount(roxlfl), true, NULL },
-//		{ "ROXR", roxrfl, flavorCount(roxrfl), true, NULL },
-//		//{ "RTD", rtdfl, flavorCount(rtdfl), true, NULL },
-//		{ "RTE", rtefl, flavorCount(rtefl), true, NULL },
-//		{ "RTR", rtrfl, flavorCount(rtrfl), true, NULL },
-//		{ "RTS", rtsfl, flavorCount(rtsfl), true, NULL },
-//		{ "SBCD", sbcdfl, flavorCount(sbcdfl), true, NULL },
-//		{ "SCC", sccfl, flavorCount(sccfl), true, NULL },
-//		{ "SCS", scsfl, flavorCount(scsfl), true, NULL },
-//		{ "SECTION", NULL, 0, false, section },
-//		{ "SEQ", seqfl, flavorCount(seqfl), true, NULL },
-//		{ "SET", NULL, 0, false, set },
-//		{ "SF", sffl, flavorCount(sffl), true, NULL },
-//		{ "SGE", sgefl, flavorCount(sgefl), true, NULL },
-//		{ "SGT", sgtfl,flavorCount(sgtfl), true, NULL },
-//		{ "SHI", shifl, flavorCount(shifl), true, NULL },
-//		{ "SHS", sccfl, flavorCount(sccfl), true, NULL },
-//		{ "SIMHALT", NULL, 0, false, simhalt },
-//		{ "SLE", slefl, flavorCount(slefl), true, NULL },
-//		{ "SLO", scsfl, flavorCount( scsfl), true, NULL },
-//		{ "SLS", slsfl, flavorCount(slsfl), true, NULL },
-//		{ "SLT", sltfl, flavorCount(sltfl), true, NULL },
-//		{ "SMI", smifl, flavorCount(smifl), true, NULL },
-//		{ "SNE", snefl, flavorCount(snefl), true, NULL },
-//		{ "SPL", splfl, flavorCount( splfl), true, NULL },
-//		{ "ST", stfl, flavorCount(stfl), true, NULL },
-//		{ "STOP", stopfl, flavorCount(stopfl), true, NULL },
-//		{ "SUB", subfl, flavorCount(subfl), true, NULL },
-//		{ "SUBA", subafl, flavorCount(subafl), true, NULL },
-//		{ "SUBI", subifl, flavorCount(subifl), true, NULL },
-//		{ "SUBQ", subqfl, flavorCount(subqfl), true, NULL },
-//		{ "SUBX", subxfl, flavorCount(subxfl), true, NULL },
-//		{ "SVC", svcfl, flavorCount( svcfl), true, NULL },
-//		{ "SVS", svsfl, flavorCount(svsfl), true, NULL },
-//		{ "SWAP", swapfl, flavorCount(swapfl), true, NULL },
-//		{ "TAS", tasfl, flavorCount(tasfl), true, NULL },
-//		{ "TRAP", trapfl, flavorCount(trapfl), true, NULL },
-//		{ "TRAPV", trapvfl, flavorCount(trapvfl), true, NULL },
-//		{ "TST", tstfl, flavorCount( tstfl), true, NULL },
-//		{ "UNLESS", NULL, 0, false, asmStructure },
-//		{ "UNLK", unlkfl, flavorCount(unlkfl), true, NULL },
-//		{ "UNTIL", NULL, 0, false, asmStructure },
-//		{ "WHILE", NULL, 0, false, asmStructure }
-//};
+// Instructions MUST BE IN ALPHABETICAL ORDER
+instruction instTable[] = {
+		{ "ABCD", abcdfl, flavorCount(abcdfl), true, NULL },
+		{ "ADD", addfl, flavorCount(addfl), true, NULL },
+		{ "ADDA", addafl, flavorCount(addafl), true, NULL },
+		{ "ADDI", addifl, flavorCount(addifl), true, NULL },
+		{ "ADDQ", addqfl, flavorCount(addqfl), true, NULL },
+		{ "ADDX", addxfl, flavorCount(addxfl), true, NULL },
+		{ "AND", andfl, flavorCount( andfl), true, NULL },
+		{ "ANDI", andifl, flavorCount(andifl), true, NULL },
+		{ "ASL", aslfl, flavorCount(aslfl), true, NULL },
+		{ "ASR", asrfl, flavorCount(asrfl), true, NULL },
+		{ "BCC", bccfl, flavorCount(bccfl), true, NULL },
+		{ "BCHG", bchgfl, flavorCount(bchgfl), true, NULL },
+		{ "BCLR", bclrfl, flavorCount(bclrfl), true, NULL },
+		{ "BCS", bcsfl, flavorCount(bcsfl), true, NULL },
+		{ "BEQ", beqfl, flavorCount(beqfl), true, NULL },
+		{ "BFCHG", bfchgfl, flavorCount(bfchgfl), true, NULL },
+		{ "BFCLR", bfclrfl,flavorCount(bfclrfl), true, NULL },
+		{ "BFEXTS", bfextsfl,flavorCount(bfextsfl), true, NULL },
+		{ "BFEXTU", bfextufl,flavorCount(bfextufl), true, NULL },
+		{ "BFFFO", bfffofl, flavorCount(bfffofl), true, NULL },
+		{ "BFINS", bfinsfl, flavorCount(bfinsfl), true, NULL },
+		{ "BFSET", bfsetfl, flavorCount(bfsetfl), true, NULL },
+		{ "BFTST", bftstfl, flavorCount(bftstfl), true, NULL },
+		{ "BGE", bgefl, flavorCount( bgefl), true, NULL },
+		{ "BGT", bgtfl, flavorCount(bgtfl), true, NULL },
+		{ "BHI", bhifl, flavorCount(bhifl), true, NULL },
+		{ "BHS", bccfl, flavorCount(bccfl), true, NULL },
+		{ "BLE", blefl, flavorCount(blefl), true, NULL },
+		{ "BLO", bcsfl, flavorCount(bcsfl), true, NULL },
+		{ "BLS", blsfl, flavorCount(blsfl), true,NULL },
+		{ "BLT", bltfl, flavorCount(bltfl), true, NULL },
+		{ "BMI", bmifl, flavorCount(bmifl), true, NULL },
+		{ "BNE", bnefl, flavorCount(bnefl), true, NULL },
+		{ "BPL", bplfl, flavorCount(bplfl), true, NULL },
+		{ "BRA", brafl, flavorCount(brafl), true, NULL },
+		{ "BSET", bsetfl, flavorCount(bsetfl), true, NULL },
+		{ "BSR", bsrfl, flavorCount(bsrfl), true, NULL },
+		{ "BTST", btstfl, flavorCount(btstfl), true, NULL },
+		{ "BVC", bvcfl, flavorCount( bvcfl), true, NULL },
+		{ "BVS", bvsfl, flavorCount(bvsfl), true, NULL },
+		{ "CHK", chkfl, flavorCount(chkfl), true, NULL },
+		{ "CLR", clrfl, flavorCount(clrfl), true, NULL },
+		{ "CMP", cmpfl, flavorCount(cmpfl), true, NULL },
+		{ "CMPA", cmpafl, flavorCount(cmpafl), true, NULL },
+		{ "CMPI", cmpifl, flavorCount(cmpifl), true, NULL },
+		{ "CMPM", cmpmfl, flavorCount(cmpmfl), true, NULL },
+		{ "DBCC", dbccfl, flavorCount(dbccfl), true, NULL },
+		{ "DBCS", dbcsfl, flavorCount(dbcsfl), true, NULL },
+		{ "DBEQ", dbeqfl, flavorCount(dbeqfl), true, NULL },
+		{ "DBF", dbffl, flavorCount(dbffl), true, NULL },
+		{ "DBGE", dbgefl, flavorCount(dbgefl), true, NULL },
+		{ "DBGT", dbgtfl, flavorCount(dbgtfl), true, NULL },
+		{ "DBHI", dbhifl,flavorCount(dbhifl), true, NULL },
+		{ "DBHS", dbccfl,flavorCount(dbccfl), true, NULL },
+		{ "DBLE", dblefl, flavorCount(dblefl), true, NULL },
+		{ "DBLO", dbcsfl, flavorCount(dbcsfl), true, NULL },
+		{ "DBLOOP", NULL, 0, false, asmStructure },
+		{ "DBLS", dblsfl, flavorCount(dblsfl), true, NULL },
+		{ "DBLT", dbltfl, flavorCount(dbltfl), true, NULL },
+		{ "DBMI", dbmifl, flavorCount(dbmifl), true, NULL },
+		{ "DBNE", dbnefl, flavorCount(dbnefl), true, NULL },
+		{ "DBPL", dbplfl, flavorCount(dbplfl), true, NULL },
+		{ "DBRA", dbrafl, flavorCount(dbrafl), true, NULL },
+		{ "DBT", dbtfl, flavorCount(dbtfl), true, NULL },
+		{ "DBVC", dbvcfl, flavorCount(dbvcfl), true, NULL },
+		{ "DBVS", dbvsfl, flavorCount(dbvsfl), true, NULL },
+		{ "DC", NULL, 0,false, dc },
+		{ "DCB", NULL, 0, false, dcb },
+		{ "DIVS", divsfl, flavorCount(divsfl), true, NULL },
+		{ "DIVU", divufl,flavorCount(divufl), true, NULL },
+		{ "DS", NULL, 0, false, ds },
+		{ "ELSE", NULL, 0, false, asmStructure },
+		{ "END", NULL, 0, false, funct_end },
+		{ "ENDF", NULL, 0, false, asmStructure },
+		{ "ENDI", NULL, 0, false, asmStructure },
+		{ "ENDR", NULL, 0, false, endr },
+		{ "ENDU", NULL, 0, false, asmStructure },
+		{ "ENDW", NULL, 0, false, asmStructure },
+		{ "EOR", eorfl, flavorCount(eorfl), true, NULL },
+		{ "EORI", eorifl, flavorCount(eorifl), true, NULL },
+		{ "EQU", NULL, 0, false, equ },
+		{ "EXG", exgfl, flavorCount(exgfl), true, NULL },
+		{ "EXT", extfl, flavorCount(extfl), true, NULL },
+		{ "FAIL", NULL, 0, false, failError },
+		{ "FOR", NULL, 0, false, asmStructure },
+		{ "IF", NULL, 0, false, asmStructure },
+		{ "ILLEGAL", illegalfl, flavorCount(illegalfl), true, NULL },
+		{ "INCBIN", NULL, 0, false, incbin },
+		{ "INCLUDE", NULL, 0, false, include },
+		{ "IRP", NULL, 0, false, irp },
+		{ "IRPC", NULL, 0, false, irpc },
+		{ "JMP", jmpfl, flavorCount(jmpfl), true, NULL },
+		{ "JSR", jsrfl, flavorCount(jsrfl), true, NULL },
+		{ "LEA", leafl, flavorCount(leafl), true, NULL },
+		{ "LINK", linkfl, flavorCount(linkfl), true, NULL },
+		{ "LIST", NULL, 0, false, listOn },
+		{ "LSL", lslfl, flavorCount(lslfl), true, NULL },
+		{ "LSR", lsrfl, flavorCount(lsrfl), true, NULL },
+		{ "MACRO", NULL, 0, false, macro },
+		{ "MEMORY", NULL, 0, false, memory },
+		{ "MOVE", movefl, flavorCount(movefl), true, NULL },
+		{ "MOVEA", moveafl, flavorCount(moveafl), true, NULL },
+		//{ "MOVEC", movecfl, flavorCount(movecfl), true, NULL },
+		{ "MOVEM", movefl, 0, false, movem },
+		// movefl is only used for syntax highlighting
+		{ "MOVEP", movepfl, flavorCount(movepfl), true, NULL },
+		{ "MOVEQ", moveqfl, flavorCount(moveqfl), true, NULL },
+		//{ "MOVES", movesfl, flavorCount(movesfl), true, NULL },
+		{ "MULS", mulsfl, flavorCount(mulsfl), true, NULL },
+		{ "MULU", mulufl, flavorCount(mulufl), true, NULL },
+		{ "NBCD", nbcdfl, flavorCount(nbcdfl), true, NULL },
+		{ "NEG", negfl, flavorCount(negfl), true, NULL },
+		{ "NEGX", negxfl, flavorCount(negxfl), true, NULL },
+		{ "NOLIST", NULL, 0, false, listOff },
+		{ "NOP", nopfl, flavorCount(nopfl), true, NULL },
+		{ "NOT", notfl, flavorCount(notfl), true, NULL },
+		{ "OFFSET", NULL, 0, false, offset },
+		{ "OPT", NULL, 0, false, opt },
+		{ "OR", orfl, flavorCount(orfl), true, NULL },
+		{ "ORG", NULL, 0, false, org },
+		{ "ORI", orifl, flavorCount(orifl), true, NULL },
+		{ "PAGE", NULL, 0, false, page },
+		{ "PEA", peafl, flavorCount(peafl), true, NULL },
+		{ "REG", NULL, 0, false, reg },
+		{ "REPEAT", NULL, 0, false, asmStructure },
+		{ "REPT", NULL, 0, false, rept },
+		{ "RESET", resetfl, flavorCount(resetfl), true, NULL },
+		{ "ROL", rolfl, flavorCount( rolfl), true, NULL },
+		{ "ROR", rorfl, flavorCount(rorfl), true, NULL },
+		{ "ROXL", roxlfl, flavorCount(roxlfl), true, NULL },
+		{ "ROXR", roxrfl, flavorCount(roxrfl), true, NULL },
+		//{ "RTD", rtdfl, flavorCount(rtdfl), true, NULL },
+		{ "RTE", rtefl, flavorCount(rtefl), true, NULL },
+		{ "RTR", rtrfl, flavorCount(rtrfl), true, NULL },
+		{ "RTS", rtsfl, flavorCount(rtsfl), true, NULL },
+		{ "SBCD", sbcdfl, flavorCount(sbcdfl), true, NULL },
+		{ "SCC", sccfl, flavorCount(sccfl), true, NULL },
+		{ "SCS", scsfl, flavorCount(scsfl), true, NULL },
+		{ "SECTION", NULL, 0, false, section },
+		{ "SEQ", seqfl, flavorCount(seqfl), true, NULL },
+		{ "SET", NULL, 0, false, set },
+		{ "SF", sffl, flavorCount(sffl), true, NULL },
+		{ "SGE", sgefl, flavorCount(sgefl), true, NULL },
+		{ "SGT", sgtfl,flavorCount(sgtfl), true, NULL },
+		{ "SHI", shifl, flavorCount(shifl), true, NULL },
+		{ "SHS", sccfl, flavorCount(sccfl), true, NULL },
+		{ "SIMHALT", NULL, 0, false, simhalt },
+		{ "SLE", slefl, flavorCount(slefl), true, NULL },
+		{ "SLO", scsfl, flavorCount( scsfl), true, NULL },
+		{ "SLS", slsfl, flavorCount(slsfl), true, NULL },
+		{ "SLT", sltfl, flavorCount(sltfl), true, NULL },
+		{ "SMI", smifl, flavorCount(smifl), true, NULL },
+		{ "SNE", snefl, flavorCount(snefl), true, NULL },
+		{ "SPL", splfl, flavorCount( splfl), true, NULL },
+		{ "ST", stfl, flavorCount(stfl), true, NULL },
+		{ "STOP", stopfl, flavorCount(stopfl), true, NULL },
+		{ "SUB", subfl, flavorCount(subfl), true, NULL },
+		{ "SUBA", subafl, flavorCount(subafl), true, NULL },
+		{ "SUBI", subifl, flavorCount(subifl), true, NULL },
+		{ "SUBQ", subqfl, flavorCount(subqfl), true, NULL },
+		{ "SUBX", subxfl, flavorCount(subxfl), true, NULL },
+		{ "SVC", svcfl, flavorCount( svcfl), true, NULL },
+		{ "SVS", svsfl, flavorCount(svsfl), true, NULL },
+		{ "SWAP", swapfl, flavorCount(swapfl), true, NULL },
+		{ "TAS", tasfl, flavorCount(tasfl), true, NULL },
+		{ "TRAP", trapfl, flavorCount(trapfl), true, NULL },
+		{ "TRAPV", trapvfl, flavorCount(trapvfl), true, NULL },
+		{ "TST", tstfl, flavorCount( tstfl), true, NULL },
+		{ "UNLESS", NULL, 0, false, asmStructure },
+		{ "UNLK", unlkfl, flavorCount(unlkfl), true, NULL },
+		{ "UNROLL", NULL, 0, false, asmStructure },
+		{ "UNTIL", NULL, 0, false, asmStructure },
+		{ "WHILE", NULL, 0, false, asmStructure }
+};
 
 //std::map<std::string, instruction> instTable = {
 //		{ "ABCD", { "ABCD", abcdfl, flavorCount(abcdfl), true, NULL }} };
@@ -762,6 +769,8 @@ flavor unlkfl[] = { { AnDirect, 0, 0, oneReg, 0, 0x4E58, 0 } };
 //		{ "END", NULL, 0, false, funct_end },
 //		{ "ENDF", NULL, 0, false, asmStructure },
 //		{ "ENDI", NULL, 0, false, asmStructure },
+//		{ "ENDR", NULL, 0, false, endr },
+//		{ "ENDU", NULL, 0, false, asmStructure },
 //		{ "ENDW", NULL, 0, false, asmStructure },
 //		{ "EOR", eorfl, flavorCount(eorfl), true, NULL },
 //		{ "EORI", eorifl, flavorCount(eorifl), true, NULL },
@@ -774,6 +783,8 @@ flavor unlkfl[] = { { AnDirect, 0, 0, oneReg, 0, 0x4E58, 0 } };
 //		{ "ILLEGAL", illegalfl, flavorCount(illegalfl), true, NULL },
 //		{ "INCBIN", NULL, 0, false, incbin },
 //		{ "INCLUDE", NULL, 0, false, include },
+//		{ "IRP", NULL, 0, false, irp },
+//		{ "IRPC", NULL, 0, false, irpc },
 //		{ "JMP", jmpfl, flavorCount(jmpfl), true, NULL },
 //		{ "JSR", jsrfl, flavorCount(jsrfl), true, NULL },
 //		{ "LEA", leafl, flavorCount(leafl), true, NULL },
@@ -808,6 +819,7 @@ flavor unlkfl[] = { { AnDirect, 0, 0, oneReg, 0, 0x4E58, 0 } };
 //		{ "PEA", peafl, flavorCount(peafl), true, NULL },
 //		{ "REG", NULL, 0, false, reg },
 //		{ "REPEAT", NULL, 0, false, asmStructure },
+//		{ "REPT", NULL, 0, false, rept },
 //		{ "RESET", resetfl, flavorCount(resetfl), true, NULL },
 //		{ "ROL", rolfl, flavorCount( rolfl), true, NULL },
 //		{ "ROR", rorfl, flavorCount(rorfl), true, NULL },
@@ -852,10 +864,149 @@ flavor unlkfl[] = { { AnDirect, 0, 0, oneReg, 0, 0x4E58, 0 } };
 //		{ "TST", tstfl, flavorCount( tstfl), true, NULL },
 //		{ "UNLESS", NULL, 0, false, asmStructure },
 //		{ "UNLK", unlkfl, flavorCount(unlkfl), true, NULL },
+//		{ "UNROLL", NULL, 0, false, asmStructure },
 //		{ "UNTIL", NULL, 0, false, asmStructure },
 //		{ "WHILE", NULL, 0, false, asmStructure }
 //};
 
 /* Declare a global variable containing the size of the instruction table */
 
-//int tableSize = sizeof(instTable) / sizeof(instruction);
+int tableSize = sizeof(instTable) / sizeof(instruction);
+
+/* Instructions that have a flavor list, in the order of instTable[].
+   The disassembler builds its decode table from them. */
+
+instruction opcodeTable[] = {
+		{ "ABCD", abcdfl, flavorCount(abcdfl), true, NULL },
+		{ "ADD", addfl, flavorCount(addfl), true, NULL },
+		{ "ADDA", addafl, flavorCount(addafl), true, NULL },
+		{ "ADDI", addifl, flavorCount(addifl), true, NULL },
+		{ "ADDQ", addqfl, flavorCount(addqfl), true, NULL },
+		{ "ADDX", addxfl, flavorCount(addxfl), true, NULL },
+		{ "AND", andfl, flavorCount( andfl), true, NULL },
+		{ "ANDI", andifl, flavorCount(andifl), true, NULL },
+		{ "ASL", aslfl, flavorCount(aslfl), true, NULL },
+		{ "ASR", asrfl, flavorCount(asrfl), true, NULL },
+		{ "BCC", bccfl, flavorCount(bccfl), true, NULL },
+		{ "BCHG", bchgfl, flavorCount(bchgfl), true, NULL },
+		{ "BCLR", bclrfl, flavorCount(bclrfl), true, NULL },
+		{ "BCS", bcsfl, flavorCount(bcsfl), true, NULL },
+		{ "BEQ", beqfl, flavorCount(beqfl), true, NULL },
+		{ "BFCHG", bfchgfl, flavorCount(bfchgfl), true, NULL },
+		{ "BFCLR", bfclrfl,flavorCount(bfclrfl), true, NULL },
+		{ "BFEXTS", bfextsfl,flavorCount(bfextsfl), true, NULL },
+		{ "BFEXTU", bfextufl,flavorCount(bfextufl), true, NULL },
+		{ "BFFFO", bfffofl, flavorCount(bfffofl), true, NULL },
+		{ "BFINS", bfinsfl, flavorCount(bfinsfl), true, NULL },
+		{ "BFSET", bfsetfl, flavorCount(bfsetfl), true, NULL },
+		{ "BFTST", bftstfl, flavorCount(bftstfl), true, NULL },
+		{ "BGE", bgefl, flavorCount( bgefl), true, NULL },
+		{ "BGT", bgtfl, flavorCount(bgtfl), true, NULL },
+		{ "BHI", bhifl, flavorCount(bhifl), true, NULL },
+		{ "BHS", bccfl, flavorCount(bccfl), true, NULL },
+		{ "BLE", blefl, flavorCount(blefl), true, NULL },
+		{ "BLO", bcsfl, flavorCount(bcsfl), true, NULL },
+		{ "BLS", blsfl, flavorCount(blsfl), true, NULL },
+		{ "BLT", bltfl, flavorCount(bltfl), true, NULL },
+		{ "BMI", bmifl, flavorCount(bmifl), true, NULL },
+		{ "BNE", bnefl, flavorCount(bnefl), true, NULL },
+		{ "BPL", bplfl, flavorCount(bplfl), true, NULL },
+		{ "BRA", brafl, flavorCount(brafl), true, NULL },
+		{ "BSET", bsetfl, flavorCount(bsetfl), true, NULL },
+		{ "BSR", bsrfl, flavorCount(bsrfl), true, NULL },
+		{ "BTST", btstfl, flavorCount(btstfl), true, NULL },
+		{ "BVC", bvcfl, flavorCount( bvcfl), true, NULL },
+		{ "BVS", bvsfl, flavorCount(bvsfl), true, NULL },
+		{ "CHK", chkfl, flavorCount(chkfl), true, NULL },
+		{ "CLR", clrfl, flavorCount(clrfl), true, NULL },
+		{ "CMP", cmpfl, flavorCount(cmpfl), true, NULL },
+		{ "CMPA", cmpafl, flavorCount(cmpafl), true, NULL },
+		{ "CMPI", cmpifl, flavorCount(cmpifl), true, NULL },
+		{ "CMPM", cmpmfl, flavorCount(cmpmfl), true, NULL },
+		{ "DBCC", dbccfl, flavorCount(dbccfl), true, NULL },
+		{ "DBCS", dbcsfl, flavorCount(dbcsfl), true, NULL },
+		{ "DBEQ", dbeqfl, flavorCount(dbeqfl), true, NULL },
+		{ "DBF", dbffl, flavorCount(dbffl), true, NULL },
+		{ "DBGE", dbgefl, flavorCount(dbgefl), true, NULL },
+		{ "DBGT", dbgtfl, flavorCount(dbgtfl), true, NULL },
+		{ "DBHI", dbhifl,flavorCount(dbhifl), true, NULL },
+		{ "DBHS", dbccfl,flavorCount(dbccfl), true, NULL },
+		{ "DBLE", dblefl, flavorCount(dblefl), true, NULL },
+		{ "DBLO", dbcsfl, flavorCount(dbcsfl), true, NULL },
+		{ "DBLS", dblsfl, flavorCount(dblsfl), true, NULL },
+		{ "DBLT", dbltfl, flavorCount(dbltfl), true, NULL },
+		{ "DBMI", dbmifl, flavorCount(dbmifl), true, NULL },
+		{ "DBNE", dbnefl, flavorCount(dbnefl), true, NULL },
+		{ "DBPL", dbplfl, flavorCount(dbplfl), true, NULL },
+		{ "DBRA", dbrafl, flavorCount(dbrafl), true, NULL },
+		{ "DBT", dbtfl, flavorCount(dbtfl), true, NULL },
+		{ "DBVC", dbvcfl, flavorCount(dbvcfl), true, NULL },
+		{ "DBVS", dbvsfl, flavorCount(dbvsfl), true, NULL },
+		{ "DIVS", divsfl, flavorCount(divsfl), true, NULL },
+		{ "DIVU", divufl,flavorCount(divufl), true, NULL },
+		{ "EOR", eorfl, flavorCount(eorfl), true, NULL },
+		{ "EORI", eorifl, flavorCount(eorifl), true, NULL },
+		{ "EXG", exgfl, flavorCount(exgfl), true, NULL },
+		{ "EXT", extfl, flavorCount(extfl), true, NULL },
+		{ "ILLEGAL", illegalfl, flavorCount(illegalfl), true, NULL },
+		{ "JMP", jmpfl, flavorCount(jmpfl), true, NULL },
+		{ "JSR", jsrfl, flavorCount(jsrfl), true, NULL },
+		{ "LEA", leafl, flavorCount(leafl), true, NULL },
+		{ "LINK", linkfl, flavorCount(linkfl), true, NULL },
+		{ "LSL", lslfl, flavorCount(lslfl), true, NULL },
+		{ "LSR", lsrfl, flavorCount(lsrfl), true, NULL },
+		{ "MOVE", movefl, flavorCount(movefl), true, NULL },
+		{ "MOVEA", moveafl, flavorCount(moveafl), true, NULL },
+		{ "MOVEP", movepfl, flavorCount(movepfl), true, NULL },
+		{ "MOVEQ", moveqfl, flavorCount(moveqfl), true, NULL },
+		{ "MULS", mulsfl, flavorCount(mulsfl), true, NULL },
+		{ "MULU", mulufl, flavorCount(mulufl), true, NULL },
+		{ "NBCD", nbcdfl, flavorCount(nbcdfl), true, NULL },
+		{ "NEG", negfl, flavorCount(negfl), true, NULL },
+		{ "NEGX", negxfl, flavorCount(negxfl), true, NULL },
+		{ "NOP", nopfl, flavorCount(nopfl), true, NULL },
+		{ "NOT", notfl, flavorCount(notfl), true, NULL },
+		{ "OR", orfl, flavorCount(orfl), true, NULL },
+		{ "ORI", orifl, flavorCount(orifl), true, NULL },
+		{ "PEA", peafl, flavorCount(peafl), true, NULL },
+		{ "RESET", resetfl, flavorCount(resetfl), true, NULL },
+		{ "ROL", rolfl, flavorCount( rolfl), true, NULL },
+		{ "ROR", rorfl, flavorCount(rorfl), true, NULL },
+		{ "ROXL", roxlfl, flavorCount(roxlfl), true, NULL },
+		{ "ROXR", roxrfl, flavorCount(roxrfl), true, NULL },
+		{ "RTE", rtefl, flavorCount(rtefl), true, NULL },
+		{ "RTR", rtrfl, flavorCount(rtrfl), true, NULL },
+		{ "RTS", rtsfl, flavorCount(rtsfl), true, NULL },
+		{ "SBCD", sbcdfl, flavorCount(sbcdfl), true, NULL },
+		{ "SCC", sccfl, flavorCount(sccfl), true, NULL },
+		{ "SCS", scsfl, flavorCount(scsfl), true, NULL },
+		{ "SEQ", seqfl, flavorCount(seqfl), true, NULL },
+		{ "SF", sffl, flavorCount(sffl), true, NULL },
+		{ "SGE", sgefl, flavorCount(sgefl), true, NULL },
+		{ "SGT", sgtfl,flavorCount(sgtfl), true, NULL },
+		{ "SHI", shifl, flavorCount(shifl), true, NULL },
+		{ "SHS", sccfl, flavorCount(sccfl), true, NULL },
+		{ "SLE", slefl, flavorCount(slefl), true, NULL },
+		{ "SLO", scsfl, flavorCount( scsfl), true, NULL },
+		{ "SLS", slsfl, flavorCount(slsfl), true, NULL },
+		{ "SLT", sltfl, flavorCount(sltfl), true, NULL },
+		{ "SMI", smifl, flavorCount(smifl), true, NULL },
+		{ "SNE", snefl, flavorCount(snefl), true, NULL },
+		{ "SPL", splfl, flavorCount( splfl), true, NULL },
+		{ "ST", stfl, flavorCount(stfl), true, NULL },
+		{ "STOP", stopfl, flavorCount(stopfl), true, NULL },
+		{ "SUB", subfl, flavorCount(subfl), true, NULL },
+		{ "SUBA", subafl, flavorCount(subafl), true, NULL },
+		{ "SUBI", subifl, flavorCount(subifl), true, NULL },
+		{ "SUBQ", subqfl, flavorCount(subqfl), true, NULL },
+		{ "SUBX", subxfl, flavorCount(subxfl), true, NULL },
+		{ "SVC", svcfl, flavorCount( svcfl), true, NULL },
+		{ "SVS", svsfl, flavorCount(svsfl), true, NULL },
+		{ "SWAP", swapfl, flavorCount(swapfl), true, NULL },
+		{ "TAS", tasfl, flavorCount(tasfl), true, NULL },
+		{ "TRAP", trapfl, flavorCount(trapfl), true, NULL },
+		{ "TRAPV", trapvfl, flavorCount(trapvfl), true, NULL },
+		{ "TST", tstfl, flavorCount( tstfl), true, NULL },
+		{ "UNLK", unlkfl, flavorCount(unlkfl), true, NULL } };
+
+int opcodeCount = sizeof(opcodeTable) / sizeof(instruction);
@@ -12,8 +12,10 @@
  *		Writes the specified line to the listing file. If
  *		the line is not a continuation, then the routine
  *		includes the source line as the last part of the
- *		listing line. If an error occurs during the writing,
- *		the routine prints a message and exits.
+ *		listing line. With OPT CYCLES the clock cycles of the
+ *		line follow the object code field. If an error occurs
+ *		during the writing, the routine prints a message and
+ *		exits.
  *
  *		listLoc()
  *		Starts the process of assembling a listing line by
@@ -69,21 +71,30 @@
 #include "../include/error.h"
 #include "../include/symbol.h"
 #include "../include/listing.h"
+#include "../include/chain.h"
+#include "../include/cycles.h"
+#include "../include/hotpath.h"
+#include "../include/advise.h"
+#include "../include/peep.h"
+#include "../include/relax.h"
 
 /* Declarations of global variables */
-extern int loc;
+extern thread_local int loc;
 extern bool pass2;
 extern bool CEXflag;
+extern bool CYCLEflag;          // true lists clock cycles of instructions
 extern bool continuation;
 extern bool CREflag;
 extern bool offsetMode;
 extern bool showEqual;
 extern char line[LINE_LENGTH];
 extern FILE *listFile;
+extern char listName[256];      // name of listing file
 extern int lineNum;
 extern int lineNumL68;
 
 static char listData[49]; /* Buffer in which listing lines are assembled */
+static bool listSplit;    // true while listObj() lists part of a line
 
 extern char *listPtr; /* Pointer to above buffer (this pointer is
  global because it is actually manipulated
@@ -121,6 +132,8 @@ int initList(char *name) {
 		fprintf(listFile, "Assembler used: %s\n", TITLE);
 		//fprintf(listFile, "Created On: %s\n\n", timeStr.c_str());
 
+		strncpy(listName, name, 255);
+		listName[255] = '\0';
 		createdL68 = true;
 		return (NORMAL);
 	} catch (...) {
@@ -139,6 +152,8 @@ int listLine(const char *text, char lineIdent[])   // ck 4-2006 lineIdent[]
 		//TODO
 		//TTextStuff *Active = (TTextStuff*) Main->ActiveMDIChild; //grab active mdi child
 		fprintf(listFile, "%-32.32s", listData);
+		if (CYCLEflag)                      // OPT CYCLES column
+			fprintf(listFile, " %-15.15s", cycleField(listSplit));
 		if (!continuation) {
 			// replace tab with spaces
 			int i = 0, j = 0, k, t;
@@ -239,7 +254,9 @@ int listObj(int data, int size) {
 		return (NORMAL);
 	}
 	if (CEXflag && (listPtr - listData + size > 31)) {
+		listSplit = true;
 		listLine(line);
+		listSplit = false;
 		strcpy(listData, "          ");
 		listPtr = listData + 10;
 		continuation = true;
@@ -283,6 +300,12 @@ int finishList() {
 			fprintf(listFile, "%d warning%s generated\n", warningCount, (warningCount > 1) ? "s" : "");
 		else
 			fprintf(listFile, "No warnings generated\n");
+		relaxList(listFile);                  // bytes saved by OPT RELAX
+		peepList(listFile);                   // cycles saved by OPT PEEP
+		chainList(listFile);                  // branches changed by OPT CHAIN
+		cycleList(listFile);                  // clock cycles by label for OPT CYCLES
+		hotList(listFile);                    // costliest loops for OPT HOT
+		adviseList(listFile);                 // faster forms for OPT ADVISE
 
 		// If OPT CRE Display Symbol Table ?
 		if (CREflag)
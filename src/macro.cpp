@@ -13,6 +13,11 @@
  Functions: macro - Defines the macro.
  Saves file pointer to macro, defines macro name,
  moves file pointer past ENDM directive.
+ Pass 1 notes where each definition ends. Pass 2 moves
+ straight there, with fseek() when the source is read
+ directly, and lists the lines from tmpFile.
+ Each pass 1 writes its definitions from the start of tmpFile, so
+ a repeated pass 1 does not add a second copy of them.
 
  asmMacro -
  for (each line of macro) {
@@ -21,6 +26,20 @@
  assemble this line of macro
  }
 
+ Each expansion is kept, keyed by the place of the macro in
+ tmpFile, the size and the arguments. A later call with the same size
+ and arguments takes the substituted and lexed lines from it instead
+ of reading and substituting the macro again. Only the \@ labels are
+ put in for each call. Lines with \@ labels are lexed by assemble().
+ A line is substituted the first time it is not skipped by conditional
+ assembly.
+ A new definition of a macro has a new place in tmpFile, so the
+ expansions kept for an earlier one are not used for it.
+
+ macroRead - Reads the next line of the expansion being assembled,
+ with the arguments put in, for a REPT, IRP, IRPC or unrolled FOR in
+ the macro. The ENDM line is left for asmMacro.
+
  tokenize - Tokenize a string to tokens[].
  Each element of token[] is a pointer to the corresponding
  token in tokens[].  is always reserved for the label
@@ -38,7 +57,10 @@
 
 #include <cstdio>
 #include <cctype>
+#include <deque>
+#include <map>
 #include <string>
+#include <vector>
 #include "../include/extern.h"
 #include "../include/asm.h"
 #include "../include/eval.h"
@@ -46,6 +68,8 @@
 #include "../include/listing.h"
 #include "../include/symbol.h"
 #include "../include/error.h"
+#include "../include/pipeline.h"
+#include "../include/unroll.h"
 
 extern char line[LINE_LENGTH];		// Source line
 extern FILE *inFile;            // source file
@@ -55,7 +79,7 @@ extern bool listFlag;
 extern bool continuation;	// TRUE if the listing line is a continuation
 extern char pass;		// pass counter
 extern bool pass2;		// Flag set during second pass
-extern int loc;		        // The assembler's location counter
+extern thread_local int loc;		        // The assembler's location counter
 extern int lineNum;
 extern int labelNum;            // macro label \@ number
 extern bool MEXflag;            // true expands macro listing
@@ -72,6 +96,100 @@ int macroNestLevel;             // count nested macro calls
 char lineIdent[MACRO_NEST_LIMIT + 2]; // "mmm" used to identify macro in listing + 1 for 's' when structured code is called from macro and +1 for '\0'
 bool noENDM;                    // set true if no ENDM in macro
 
+const int MAC_LINE = 0;         // kinds of macro line
+const int MAC_ENDM = 1;
+const int MAC_MEXIT = 2;
+const int MAC_IFARG = 3;
+const size_t MAC_CACHE_LINES = 4096;  // most lines kept for all expansions
+
+struct macroLine {
+	std::string text;             // line from tmpFile after strcap()
+	std::string sub;              // line after parameter substitution
+	std::vector<size_t> stamps;   // where \@ label numbers go in sub
+	int error;                    // error from the substitution
+	int kind;                     // MAC_LINE, MAC_ENDM, MAC_MEXIT or MAC_IFARG
+	bool comment;                 // comment line, not substituted
+	bool labeled;                 // label present
+	std::string ifarg;            // argument of IFARG
+	bool substituted;             // sub, stamps and error are set
+	bool lexed;                   // lex holds sub lexed
+	lexLine lex;
+};
+
+// a deque, as lines read by macroRead() may be added while assemble() is
+// using the lex of an earlier one
+typedef std::deque<macroLine> macroExpansion;
+
+struct macroReader {
+	macroExpansion *cached;       // kept expansion for this call, or NULL
+	macroExpansion *recorded;     // expansion read from tmpFile
+	size_t lineN;                 // next line of cached
+	long tmpFP;                   // next line in tmpFile
+	char (*arguments)[ARG_SIZE + 1];
+	int argN;
+	const char *labelNumA;        // \@ label number
+};
+
+struct macroSpan {
+	std::string name;             // macro defined
+	int line;                     // lineNum of the MACRO line
+	int lines;                    // lines read up to ENDM, 0 if none
+	long end;                     // inFile position after ENDM, -1 if not known
+	int tmpFP;                    // the lines in tmpFile
+	std::string endm;             // ENDM line
+};
+
+static std::vector<macroSpan> macroSpans; // definitions by sequence number
+static unsigned int macroSeq;   // definition sequence number
+static long macroEnd;           // end of the definitions written by pass 1
+
+// expansions by place of the macro in tmpFile, then size and arguments
+static std::map<int, std::map<std::string, macroExpansion> > macroCache;
+static size_t macroCacheLines;  // lines kept in macroCache
+static std::vector<macroReader*> macroReaders; // expansions being assembled
+
+//--------------------------------------------------------
+// Called at the start of an assembly
+int macroStart() {
+	macroCache.clear();
+	macroCacheLines = 0;
+	macroSpans.clear();
+	macroReaders.clear();
+	return (NORMAL);
+}
+
+// Called at the start of each pass. A repeated pass 1 writes the
+// definitions again where expansions were kept for the earlier ones.
+int macroPass() {
+	macroSeq = 0;
+	if (!pass2) {
+		macroEnd = 0;
+		macroCache.clear();
+		macroCacheLines = 0;
+	}
+	return (NORMAL);
+}
+
+// Move past a definition noted by pass 1 and list it. line is left
+// holding the ENDM line.
+static int macroSkip(const macroSpan &span) {
+	char text[LINE_LENGTH];
+
+	if (listFlag) {
+		fseek(tmpFile, span.tmpFP, SEEK_SET);
+		for (int i = 1; i < span.lines && fgets(text, 256, tmpFile); i++)
+			listLine(text);
+	}
+	if (span.end >= 0 && !unrollActive() && pipeDirect()) {
+		fseek(inFile, span.end, SEEK_SET);
+		lineNum += span.lines;
+		strcpy(line, span.endm.c_str());
+	} else
+		for (int i = 0; i < span.lines && unrollRead(line); i++)
+			;                             // read without looking at the lines
+	return (NORMAL);
+}
+
 //--------------------------------------------------------
 // Define macro
 // Save file pointer to macro, define macro name, move file pointer
@@ -82,12 +200,20 @@ int macro(int size, char *label, char *op, int *errorPtr) {
 	const int MAXT = 128;           // maximum number of tokens
 	char *token[MAXT];              // pointers to tokens
 	char tokens[MAC_SIZE];          // place tokens here
+	unsigned int seq = macroSeq++;
+	int line1 = lineNum;
+	int lines = 0;
 
 	if (size)
 		NEWERROR(*errorPtr, INV_SIZE_CODE);
 	error = OK;
+	if (!pass2) {
+		if (seq == macroSpans.size())
+			macroSpans.push_back(macroSpan());
+		macroSpans[seq].lines = 0;
+	}
 
-	fseek(tmpFile, 0, SEEK_END);    // prepare tmpFile to receive next macro
+	fseek(tmpFile, macroEnd, SEEK_SET); // prepare tmpFile to receive next macro
 
 	if (pass == 0)
 		macroFP = ftell(tmpFile);          // save location of macro in tempFile
@@ -102,19 +228,38 @@ int macro(int size, char *label, char *op, int *errorPtr) {
 	if (pass2 && listFlag)
 		listLine(line);
 
+	// in pass 2 go to the ENDM found by pass 1
+	if (pass2 && seq < macroSpans.size() && macroSpans[seq].lines
+			&& macroSpans[seq].line == line1 && macroSpans[seq].name == label) {
+		macroSkip(macroSpans[seq]);
+		return (NORMAL);
+	}
+
 	// move file pointer past ENDM directive
-	while (fgets(line, 256, inFile)) {
-		if (pass == 0)
-			fprintf(tmpFile, line);           // write macro line to tmpFile
-		lineNum++;
+	while (unrollRead(line)) {        // next source line, or line of a REPT
+		lines++;
+		if (pass == 0) {
+			fputs(line, tmpFile);             // write macro line to tmpFile
+			macroEnd = ftell(tmpFile);
+		}
 		tokenize(line, " \t\n", token, tokens);
 		if (!(strcmp(token[1], "MACRO"))) { // if unexpected MACRO opcode
 			NEWERROR(*errorPtr, NO_ENDM);     // no ENDM found
 			noENDM = true;
 			return (NULL);
 		}
-		if (!(strcmp(token[1], "ENDM")))     // if ENDM opcode
+		if (!(strcmp(token[1], "ENDM"))) {   // if ENDM opcode
+			if (!pass2) {                     // note the definition for pass 2
+				macroSpan &span = macroSpans[seq];
+				span.name = label;
+				span.line = line1;
+				span.lines = lines;
+				span.end = (!unrollActive() && pipeDirect()) ? ftell(inFile) : -1;
+				span.tmpFP = macroFP;
+				span.endm = line;
+			}
 			return (NORMAL);
+		}
 		if (pass2 && listFlag)
 			listLine(line);
 	}
@@ -123,6 +268,161 @@ int macro(int size, char *label, char *op, int *errorPtr) {
 	return (0);
 }
 
+//--------------------------------------------------------
+// Note what the pre processing of macro commands needs from a line of a
+// macro. The arguments are put in later by macroSubst().
+static int macroScan(char *capLine, macroLine *m) {
+	const int MAXT = 128;           // maximum number of tokens
+	const int MAX_SIZE = 512;       // maximun size of input line
+	char *token[MAXT];              // pointers to tokens
+	char tokens[MAX_SIZE];          // place tokens here
+	char *capL;
+
+	m->text = capLine;
+	m->substituted = false;
+	m->lexed = false;
+	tokenize(capLine, ", \t\n", token, tokens); // tokenize line
+	m->labeled = (token[0] != empty);
+	m->kind = MAC_LINE;
+	if (!(strcmp(token[1], "ENDM")))
+		m->kind = MAC_ENDM;
+	else if (!(strcmp(token[1], "MEXIT")))
+		m->kind = MAC_MEXIT;
+	else if (!(strcmp(token[1], "IFARG"))) {
+		m->kind = MAC_IFARG;
+		m->ifarg = token[2];
+	}
+	capL = skipSpace(capLine);
+	m->comment = (*capL == '*');
+	return (NORMAL);
+}
+
+//--------------------------------------------------------
+// Substitute the arguments in a line of a macro that is not a comment.
+// The \@ label numbers are left out and their places noted in m->stamps.
+// Lines skipped by conditional assembly are not substituted.
+static int macroSubst(char arguments[][ARG_SIZE + 1], int argN, macroLine *m) {
+	char narg[16];
+	const char *capL;
+	int n;
+
+	m->sub.clear();
+	m->stamps.clear();
+	m->error = OK;
+	m->substituted = true;
+	capL = m->text.c_str();
+	while (*capL && isspace(*capL))              // copy spaces
+		m->sub += *capL++;
+
+	// do macro parameter substitution and label generation
+	while (*capL) {                         // while not empty
+		while (*capL && !(isspace(*capL))) { // while not empty and not space
+			if (*capL == '\\') {      // if macro label or parameter
+				capL++;
+				if (*capL == '@') {             // if \@ macro label
+					capL++;
+					m->sub += '_';                  // add '_'
+					m->stamps.push_back(m->sub.size()); // labelNum goes here
+				} else if (isalnum(*capL)) {     // if alpha numeric
+					n = -1;
+					if (isdigit(*capL))      // if parameter \0 - \9
+						n = *capL++ - '0'; // convert parameter to integer
+					else if (*capL >= 'A' && *capL <= 'Z') // if parameter \A - \Z
+						n = *capL++ - 'A' + 10; // convert parameter to integer
+					else
+						// invalid argument
+						NEWERROR(m->error, INVALID_ARG);
+					if (n >= 0 && n < MAX_ARGS) // if valid argument number
+						m->sub += arguments[n];
+					else
+						NEWERROR(m->error, INVALID_ARG);
+				} else
+					NEWERROR(m->error, SYNTAX);
+			} else if (!(strncmp(capL, "NARG", 4))
+					&& !(isalnum(*(capL + 4)))) {
+				sprintf(narg, "%d", argN);
+				m->sub += narg;
+				capL += 4;
+			} else {
+				m->sub += *capL++;        // copy macro line
+			}
+		}
+		while (*capL && isspace(*capL))  // copy spaces
+			m->sub += *capL++;
+	}
+	return (NORMAL);
+}
+
+//--------------------------------------------------------
+// Next line of the expansion r, or NULL after the last line of the macro
+static macroLine* macroNext(macroReader *r) {
+	char text[LINE_LENGTH];
+	char capLine[LINE_LENGTH];
+
+	if (r->cached) {                      // line of a kept expansion
+		if (r->lineN >= r->cached->size())
+			return (NULL);
+		return (&(*r->cached)[r->lineN++]);
+	}
+	fseek(tmpFile, r->tmpFP, SEEK_SET);  // nested macros move tmpFile
+	if (!fgets(text, 256, tmpFile))
+		return (NULL);
+	r->tmpFP = ftell(tmpFile);
+	strcap(capLine, text);
+	r->recorded->push_back(macroLine());
+	macroScan(capLine, &r->recorded->back());
+	return (&r->recorded->back());
+}
+
+// Put the arguments and the \@ label number of r in line m, leaving
+// the line in macLine. Returns the error from the substitution.
+static int macroText(macroReader *r, macroLine *m, char *macLine) {
+	std::string text;
+
+	if (!m->substituted)
+		macroSubst(r->arguments, r->argN, m); // same arguments in every call using m
+	text = m->sub;
+	for (int i = m->stamps.size() - 1; i >= 0; i--)
+		text.insert(m->stamps[i], r->labelNumA); // add labelNum to macro label
+	macLine[text.copy(macLine, MAC_SIZE - 1)] = '\0';
+	return (m->error);
+}
+
+//--------------------------------------------------------
+// Read the next line of the expansion being assembled into text, for
+// the body of a REPT, IRP, IRPC or unrolled FOR in the macro. Returns
+// false at the ENDM, which is left for asmMacro().
+bool macroRead(char *text) {
+	char macLine[MAC_SIZE];
+	macroReader *r;
+	macroLine *m;
+	size_t lineN;
+	long tmpFP;
+
+	if (macroReaders.empty())
+		return (false);
+	r = macroReaders.back();
+	lineN = r->lineN;
+	tmpFP = r->tmpFP;
+	m = macroNext(r);
+	if (!m)
+		return (false);
+	if (m->kind == MAC_ENDM) {            // read again by asmMacro()
+		if (!r->cached)
+			r->recorded->pop_back();
+		r->lineN = lineN;
+		r->tmpFP = tmpFP;
+		return (false);
+	}
+	if (m->comment)
+		strcpy(macLine, m->text.c_str());
+	else
+		macroText(r, m, macLine);         // errors are found when it is assembled
+	strncpy(text, macLine, LINE_LENGTH - 1);
+	text[LINE_LENGTH - 1] = '\0';
+	return (true);
+}
+
 //--------------------------------------------------------
 // Assemble macro
 // pre: macroFP contains file pointer to macro
@@ -136,18 +436,16 @@ int asmMacro(int size, char *label, char *arg, int *errorPtr) {
 	char macLine[MAC_SIZE];
 	char labelNumA[16];
 	char *capL;
-	char *macL;
 	char arguments[MAX_ARGS][ARG_SIZE + 1];
-	const int MAXT = 128;           // maximum number of tokens
-	const int MAX_SIZE = 512;       // maximun size of input line
-	char *token[MAXT];              // pointers to tokens
-	char tokens[MAX_SIZE];          // place tokens here
-	char *tokenEnd[MAXT];           // where tokens end in source line
 	int error;
 	int argN;
 	int i;
-	int n;
-	int tempFP;                           // temporary File Pointer
+	int defFP;                            // place of the macro in tmpFile
+	std::string key;                      // size and arguments of the call
+	macroExpansion *cached;               // kept expansion for this call
+	macroExpansion recorded;              // expansion read from tmpFile
+	macroReader reader;                   // lines of the call
+	macroLine *m;
 	int value;
 	bool backRef;
 	bool textArg;                         // true for 'text' argument
@@ -233,7 +531,7 @@ int asmMacro(int size, char *label, char *arg, int *errorPtr) {
 					}
 				}
 
-				if (fgets(line, 256, inFile) == NULL) {      // get next line
+				if (!pipeRead(line)) {      // get next line
 					NEWERROR(*errorPtr, INVALID_ARG);
 					macroNestLevel--;               // count nested macro calls
 					return (NORMAL);
@@ -274,86 +572,38 @@ int asmMacro(int size, char *label, char *arg, int *errorPtr) {
 		listLine(line, lineIdent);
 	}
 
-	// position tempFile to macro definition
-	fseek(tmpFile, macroFP, SEEK_SET);   // move to macro definition
+	// look for an expansion with the same size and arguments
+	key = arguments[0];
+	for (i = 1; i <= argN; i++)
+		key += '\n' + (std::string) arguments[i];
+	defFP = macroFP;
+	cached = NULL;
+	if (macroCache.count(defFP) && macroCache[defFP].count(key))
+		cached = &macroCache[defFP][key];
+	recorded.clear();
 
 	// send each line of macro to assembler
 	labelNum++;                           // increment macro label number
-	//TODO
-	//itoa(labelNum, labelNumA, 10);        // convert labelNum to string
+	sprintf(labelNumA, "%d", labelNum);   // convert labelNum to string
+	reader.cached = cached;
+	reader.recorded = &recorded;
+	reader.lineN = 0;
+	reader.tmpFP = macroFP;               // macro definition
+	reader.arguments = arguments;
+	reader.argN = argN;
+	reader.labelNumA = labelNumA;
+	macroReaders.push_back(&reader);
+	unrollEnter(UNROLL_MACRO);            // a REPT in the macro reads its lines
 	endmFlag = false;
-	while (!endmFlag && fgets(line, 256, tmpFile)) {
-		strcap(capLine, line);
-		tokenize(capLine, ", \t\n", token, tokens); // tokenize line
-
+	while (!endmFlag && (m = macroNext(&reader))) {
 		error = OK;
 		skipList = false;
 		printCond = false;
-		macL = macLine;
-		capL = capLine;
-		while (*capL && isspace(*capL))              // copy spaces
-			*macL++ = *capL++;
-		if (*capL == '*') {                         // if comment line
-			while (*capL)                              // copy rest of line
-				*macL++ = *capL++;
-		} else {                                    // else not comment line
-
-			if (skipCond)                     // if code conditionally skipped
-				while (*capL)
-					*macL++ = *capL++;       // just copy line to check for ENDC
-			else {                            // else, include code
-				// do macro parameter substitution and label generation
-				while (*capL) {                         // while not empty
-					while (*capL && !(isspace(*capL))) { // while not empty and not space
-						if (*capL == '\\') {      // if macro label or parameter
-							capL++;
-							if (*capL == '@') {             // if \@ macro label
-								capL++;
-								*macL++ = '_';                  // add '_'
-								i = 0;            // add labelNum to macro label
-								while (labelNumA[i]) {
-									*macL++ = labelNumA[i++];
-								}
-							} else if (isalnum(*capL)) {     // if alpha numeric
-								n = -1;
-								if (isdigit(*capL))      // if parameter \0 - \9
-									n = *capL++ - '0'; // convert parameter to integer
-								else if (*capL >= 'A' && *capL <= 'Z') // if parameter \A - \Z
-									n = *capL++ - 'A' + 10; // convert parameter to integer
-								else
-									// invalid argument
-									NEWERROR(error, INVALID_ARG);
-								if (n >= 0 && n < MAX_ARGS) { // if valid argument number
-									i = 0;
-									while (arguments[n][i]) {
-										*macL++ = arguments[n][i++];
-									}
-								} else
-									NEWERROR(error, INVALID_ARG);
-							} else
-								NEWERROR(error, SYNTAX);
-							// if NARG opcode
-							//} else if( !(stricmp(token[1], "NARG")) ) {
-						} else if (!(strncmp(capL, "NARG", 4))
-								&& !(isalnum(*(capL + 4)))) {
-							sprintf(macL, "%d", argN);
-							if (argN > 9)
-								macL++;
-							macL++;
-							capL += 4;
-						} else {
-							*macL++ = *capL++;        // copy macro line
-						}
-					}
-					while (*capL && isspace(*capL))  // copy spaces
-						*macL++ = *capL++;
-				}
-			} // end else, include code
-		} // end if comment, else not comment
-
-		*macL = '\0';
+		if (m->comment || skipCond)         // if comment or code conditionally skipped
+			strcpy(macLine, m->text.c_str()); // just copy line to check for ENDC
+		else
+			error = macroText(&reader, m, macLine);
 
-		tempFP = ftell(tmpFile); // save current file position to support nested macros *ck 12-1-2005
 		continuation = false;
 		strcpy(line, macLine);   // replace original source line with macro line
 		if (!MEXflag)
@@ -363,21 +613,22 @@ int asmMacro(int size, char *label, char *arg, int *errorPtr) {
 
 		// pre process macro commands
 		// ----- ENDM and MEXIT -----
-		if (!(strcmp(token[1], "ENDM")) ||         // if ENDM opcode or
-				(!strcmp(token[1], "MEXIT")) && !skipCond) { // MEXIT
-			if (token[0] != empty)                    // if label present
+		if (m->kind == MAC_ENDM ||         // if ENDM opcode or
+				(m->kind == MAC_MEXIT && !skipCond)) { // MEXIT
+			if (m->labeled)                    // if label present
 				NEWERROR(*errorPtr, LABEL_ERROR);
 			endmFlag = true;
 			skipCreateCode = true;
 
 			// ----- IFARG -----
-		} else if (!(strcmp(token[1], "IFARG"))) {  // if IFARG opcode
-			if (token[0] != empty)                    // if label present
+		} else if (m->kind == MAC_IFARG) {  // if IFARG opcode
+			if (m->labeled)                    // if label present
 				NEWERROR(*errorPtr, LABEL_ERROR);
-			if (token[2] == empty) {                // if IFARG argument missing
+			if (m->ifarg.empty()) {                // if IFARG argument missing
 				NEWERROR(*errorPtr, INVALID_ARG);
 			} else {
-				eval(token[2], &value, &backRef, &error);
+				strcpy(capLine, m->ifarg.c_str());
+				eval(capLine, &value, &backRef, &error);
 				//value--;
 				if (error < ERRORN && value > 0 && value < MAX_ARGS) { // if valid arg number
 					if (arguments[value][0] == '\0') { // if argument does not exist
@@ -392,13 +643,32 @@ int asmMacro(int size, char *label, char *arg, int *errorPtr) {
 			skipCreateCode = true;
 		}
 
-		if (!noENDM)                 // if no missing ENDM errors
+		if (!noENDM) {               // if no missing ENDM errors
+			if (!m->comment && !skipCond && m->stamps.empty()) {
+				if (!m->lexed && m->sub.size() < sizeof(m->lex.line)) {
+					strcpy(m->lex.line, m->sub.c_str());
+					pipeLex(&m->lex);
+					m->lexed = true;
+				}
+				if (m->lexed)
+					pipeReplay(&m->lex);    // lexed before, assemble() does not lex it
+			}
 			assemble(line, &error); // this supports structured statements in macros
+		}
 
-		macroFP = tempFP;       // restore macroFP
-		fseek(tmpFile, macroFP, SEEK_SET); // position tmpFile to previous spot *ck 12-1-2005
+		if (!cached)
+			macroFP = reader.tmpFP; // restore macroFP to support nested macros *ck 12-1-2005
 
 	} // end while more lines of macro remain
+	unrollLeave();
+	macroReaders.pop_back();
+
+	// keep an expansion that went to ENDM for the next call like this one
+	if (!cached && endmFlag && !noENDM && recorded.back().kind == MAC_ENDM
+			&& macroCacheLines + recorded.size() <= MAC_CACHE_LINES) {
+		macroCacheLines += recorded.size();
+		macroCache[defFP].insert(std::make_pair(key, recorded));
+	}
 
 	skipCreateCode = false;
 
@@ -51,6 +51,7 @@
 #include "../include/movem.h"
 #include "../include/listing.h"
 #include "../include/codegen.h"
+#include "../include/cycles.h"
 #include "../include/symbol.h"
 
 /* Define bit masks for the legal addressing modes of MOVEM */
@@ -59,7 +60,7 @@
 #define DestModes   (ControlAlt | AnIndPre)
 #define SourceModes (ControlAlt | AnIndPost | PCDisp | PCIndex)
 
-extern int loc;
+extern thread_local int loc;
 extern bool pass2;
 extern char buffer[256];  //ck used to form messages for display in windows
 
@@ -93,6 +94,7 @@ int movem(int size, char *label, char *op, int *errorPtr) {
 		/* Define the label attached to this instruction */
 		if (*label)
 			define(label, loc, pass2, true, errorPtr);
+		cycleCode();               // OPT CYCLES times the words output
 
 		/* See if the instruction is of the form MOVEM <reg_list>,<ea> */
 		status = OK;
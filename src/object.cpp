@@ -92,6 +92,7 @@
 
  ************************************************************************/
 #include <cstdio>
+#include <cstdlib>
 #include <cctype>
 #include "../include/asm.h"
 #include "../include/error.h"
@@ -103,6 +104,7 @@
 
 extern char line[256];
 extern FILE *objFile;
+extern char objName[256];      // name of S-Record file
 extern char buffer[256];  //ck used to form messages for display in windows
 extern char numBuf[20];
 extern unsigned int startAddress;     // starting address of program
@@ -139,6 +141,10 @@ int initObj(char *name) {
 //		Application->MessageBox(buffer, "Error", MB_OK);
 		return (MILD_ERROR);
 	}
+	if (name != objName) {
+		strncpy(objName, name, 255);
+		objName[255] = '\0';
+	}
 
 	/* Output S0-record file header
 	 S0 Record. The type of record is 'S0'. The address field is unused and will
@@ -238,7 +244,7 @@ int outputObj(int newAddr, int data, int size) {
 //------------------------------------------------------------
 int writeObj() {
 	char recLen[3];
-	wxString str = "0x";
+	char hex[3];
 	char *sRec = sRecord;
 
 	try {
@@ -249,12 +255,11 @@ int writeObj() {
 
 		// Calculate checksum and add to record
 		checksum = 0;
+		hex[2] = '\0';
 		for (int i = 0; i < byteCount; i++) {
-			str = "0x";
-			str += *sRec++;
-			str += *sRec++;
-			//TODO
-			//checksum += (char) (StrToInt(str) & 0xFF);
+			hex[0] = *sRec++;
+			hex[1] = *sRec++;
+			checksum += (char) (strtol(hex, NULL, 16) & 0xFF);
 		}
 		sprintf(sRec, "%02X\n", (~checksum & 0xFF)); // put checksum in sRecord
 
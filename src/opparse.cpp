@@ -30,6 +30,15 @@
  *		The argument errorPtr is used to return an error code
  *		via the standard mechanism.
  *
+ *		The result of each operand field is kept by its text.
+ *		A later operand with the same text gets the mode and
+ *		registers from the copy and only evaluates its
+ *		expression again, if it has one, at the same place.
+ *		The address mode of an absolute address is chosen
+ *		again from the value. Operands that contain a string,
+ *		or whose parse looks past the operand field, are
+ *		always read by opParseText().
+ *
  *	 Usage:	char *opParse(p, d, errorPtr)
  *		char *p;
  *		opDescriptor *d;
@@ -44,49 +53,86 @@
  ************************************************************************/
 #include <cstdio>
 #include <cctype>
+#include <cstring>
+#include <string>
+#include <unordered_map>
 #include "../include/asm.h"
+#include "../include/depend.h"
 #include "../include/eval.h"
+#include "../include/opparse.h"
 
 extern char buffer[256];  //ck used to form messages for display in windows
-extern int loc;
+extern thread_local int loc;
 
-char* opParse(char *p, opDescriptor *d, int *errorPtr) {
+const char OP_DATA_NONE = 0;      // where the data of an operand comes from
+const char OP_DATA_CONST = 1;
+const char OP_DATA_EXPR = 2;
+const size_t OP_CACHE = 4096;     // most operand fields kept
+const int OP_UNSET = 0x7FFFFFFF;  // data not set by the parse
+
+struct opTemplate {
+	int mode;
+	char reg;                     // -1 if not set
+	char index;                   // -1 if not set
+	char size;
+	char dataKind;                // OP_DATA_NONE, OP_DATA_CONST or OP_DATA_EXPR
+	bool dataLoc;                 // data replaced by loc after the expression
+	int data;                     // OP_DATA_CONST value
+	bool backRef;
+	int exprStart;                // offsets in the operand of the expression
+	int exprEnd;
+	int end;                      // offset of the character after the operand
+};
+
+struct opTraced {
+	int evals;                    // expressions evaluated
+	char *start;                  // the last one
+	char *end;
+	bool loc;                     // data set to loc
+};
+
+static std::unordered_map<std::string, opTemplate> opCache;
+static opTraced opTrace;
+
+// eval() for opParseText(), noting where the expression was
+static char* opEval(char *p, opDescriptor *d, int *errorPtr) {
+	opTrace.evals++;
+	opTrace.start = p;
+	opTrace.end = eval(p, &(d->data), &(d->backRef), errorPtr);
+	return (opTrace.end);
+}
+
+// Choose the size of an absolute address. p points after its expression.
+static char* opAbsolute(char *p, opDescriptor *d, int *errorPtr) {
+	// Determine size of absolute address
+	if (p[0] == '.' && p[1] == 'L') {
+		d->mode = AbsLong;
+		d->size = LONG_SIZE;      // explicit size kept by OPT EAOPT
+		p += 2;
+	} else if (p[0] == '.' && p[1] == 'W') {
+		d->data = short(d->data);   // force short addressing
+		d->mode = AbsShort;
+		p += 2;
+		NEWERROR(*errorPtr, FORCING_SHORT); // forcing short addressing warning
+	}
+	//(must be long if the symbol isn't defined or if the value is too big
+	else if (!d->backRef || d->data > 32767 || d->data < -32768)
+		d->mode = AbsLong;
+	else
+		d->mode = AbsShort;
+	return (p);
+}
+
+// Parse the operand at p, after spaces inside its parentheses are removed
+static char* opParseText(char *p, opDescriptor *d, int *errorPtr) {
 	char *n;
-	int parenCount;
 
 	try {
 		d->size = 0;
-		// if addressing mode in ( )
-		// remove spaces inside parenthesis       CK Oct-26-2008
-		if (p[0] == '(' || p[1] == '(') {
-			char *sr = p;
-			char *ds = p;
-			parenCount = 1;
-			*ds++ = *sr++;            // copy first char
-			if (*sr == '(')           // if second char is '('
-				*ds++ = *sr++;          // copy (
-			while (*sr && parenCount) {
-				if (*sr == '(')
-					parenCount++;
-				else if (*sr == ')')
-					parenCount--;
-				if (isspace(*sr))    // skip spaces
-					sr++;
-				else
-					*ds++ = *sr++;
-			}
-			if (!*sr && parenCount) {         // if no ')' found
-				NEWERROR(*errorPtr, SYNTAX);
-				return (NULL);
-			}
-
-			while ((*ds++ = *sr++) != 0)
-				;  // copy ')' and remaining text
-		}
 
 		// Check for immediate mode
 		if (p[0] == '#') {
-			p = eval(++p, &(d->data), &(d->backRef), errorPtr);
+			p = opEval(++p, d, errorPtr);
 			// If expression evaluates OK, then return
 			if (*errorPtr < SEVERE) {
 				if (isTerm(*p) || p[0] == '.') {
@@ -195,7 +241,7 @@ char* opParse(char *p, opDescriptor *d, int *errorPtr) {
 						|| (n[1] == 'S' && n[2] == 'P')) {
 					p++;                  // skip (
 					// evaluate displacement, p points to ','
-					p = eval(p, &(d->data), &(d->backRef), errorPtr);
+					p = opEval(p, d, errorPtr);
 				}
 			}
 
@@ -249,8 +295,9 @@ char* opParse(char *p, opDescriptor *d, int *errorPtr) {
 			if (n && n[1] == 'P' && n[2] == 'C') {
 				p++;                  // skip (
 				// evaluate displacement, p points to ','
-				p = eval(p, &(d->data), &(d->backRef), errorPtr);
-			}
+				p = opEval(p, d, errorPtr);
+			} else
+				n = NULL;             // ',' of another operand, or none
 
 			// Check for PC relative (PC) or (PC,Xi)
 			if (p[1] == 'P' && p[2] == 'C') {
@@ -269,6 +316,7 @@ char* opParse(char *p, opDescriptor *d, int *errorPtr) {
 					d->mode = PCIndex;
 					d->index = p[5] - '0';
 					d->data = loc;            // CK 3-8-2018
+					opTrace.loc = true;
 					if (p[4] == 'A')
 						d->index += 8;
 					if (p[6] == '.')
@@ -327,7 +375,7 @@ char* opParse(char *p, opDescriptor *d, int *errorPtr) {
 		}
 
 		// All other addressing modes start with a constant expression
-		p = eval(p, &(d->data), &(d->backRef), errorPtr);
+		p = opEval(p, d, errorPtr);
 		if (*errorPtr < SEVERE) {
 			// Check for address register indirect with displacement
 			if (p[0] == '('
@@ -410,24 +458,8 @@ char* opParse(char *p, opDescriptor *d, int *errorPtr) {
 			}
 			// Check for absolute   (check this last ck 12-11-2002)
 			if (isTerm(p[0]) || *errorPtr == INCOMPLETE || p[0] == '.'
-					|| p[0] == '{') {
-				// Determine size of absolute address
-				if (p[0] == '.' && p[1] == 'L') {
-					d->mode = AbsLong;
-					p += 2;
-				} else if (p[0] == '.' && p[1] == 'W') {
-					d->data = short(d->data);   // force short addressing
-					d->mode = AbsShort;
-					p += 2;
-					NEWERROR(*errorPtr, FORCING_SHORT); // forcing short addressing warning
-				}
-				//(must be long if the symbol isn't defined or if the value is too big
-				else if (!d->backRef || d->data > 32767 || d->data < -32768)
-					d->mode = AbsLong;
-				else
-					d->mode = AbsShort;
-				return (p);
-			}
+					|| p[0] == '{')
+				return (opAbsolute(p, d, errorPtr));
 		} // endif error not severe
 		  // If the operand doesn't match any pattern, return an error status
 		NEWERROR(*errorPtr, SYNTAX);
@@ -440,3 +472,151 @@ char* opParse(char *p, opDescriptor *d, int *errorPtr) {
 	}
 
 }
+
+// Returns the length of the operand field at p, up to a space outside
+// parentheses, or -1 if it holds a string
+static int opField(const char *p) {
+	int depth = 0;
+	int i;
+
+	for (i = 0; p[i] && !(isspace(p[i]) && depth <= 0); i++)
+		if (p[i] == '\'')
+			return (-1);
+		else if (p[i] == '(')
+			depth++;
+		else if (p[i] == ')')
+			depth--;
+	return (i);
+}
+
+// Parse the operand at p from a kept template. Returns NULL if the
+// expression did not end where it did before.
+static char* opReplay(char *p, opDescriptor *d, const opTemplate &t,
+		int *errorPtr) {
+	if (t.dataKind == OP_DATA_EXPR) {
+		if (eval(p + t.exprStart, &(d->data), &(d->backRef), errorPtr)
+				!= p + t.exprEnd || *errorPtr >= SEVERE)
+			return (NULL);
+	} else if (t.dataKind == OP_DATA_CONST) {
+		d->data = t.data;
+		d->backRef = t.backRef;
+	}
+	if (t.dataLoc)
+		d->data = loc;
+	if (t.reg >= 0)
+		d->reg = t.reg;
+	if (t.index >= 0)
+		d->index = t.index;
+	d->size = t.size;
+	if (t.mode == AbsShort || t.mode == AbsLong) {
+		d->size = 0;
+		return (opAbsolute(p + t.exprEnd, d, errorPtr));
+	}
+	d->mode = t.mode;
+	return (p + t.end);
+}
+
+// Parse the operand at p and keep the result as a template if it does
+// not depend on the text after the operand field of length len
+static char* opRecord(char *p, int len, opDescriptor *d, int *errorPtr) {
+	opDescriptor old = *d;
+	opTemplate t;
+	char *q;
+
+	d->data = OP_UNSET;
+	d->reg = -1;
+	d->index = -1;
+	opTrace.evals = 0;
+	opTrace.loc = false;
+	q = opParseText(p, d, errorPtr);
+	if (!opTrace.evals && d->data == OP_UNSET) {  // restore what it left alone
+		d->data = old.data;
+		d->backRef = old.backRef;
+	}
+	t.reg = d->reg;
+	t.index = d->index;
+	if (d->reg == -1)
+		d->reg = old.reg;
+	if (d->index == -1)
+		d->index = old.index;
+	if (!q || q > p + len || opTrace.evals > 1 || *errorPtr >= SEVERE)
+		return (q);
+	if (p[0] == '(' && !memchr(p, ',', len) && d->mode != AnInd
+			&& d->mode != AnIndPost)
+		return (q);                 // strchr() looked past the field
+	t.mode = d->mode;
+	t.size = d->size;
+	t.dataLoc = opTrace.loc;
+	t.end = q - p;
+	t.exprStart = t.exprEnd = -1;
+	if (opTrace.evals) {
+		t.dataKind = OP_DATA_EXPR;
+		t.exprStart = opTrace.start - p;
+		t.exprEnd = opTrace.end - p;
+		if ((t.mode == AbsShort || t.mode == AbsLong)
+				&& !(isTerm(p[t.exprEnd]) || p[t.exprEnd] == '.'))
+			return (q);               // taken only because of INCOMPLETE
+	} else if (d->data != old.data || d->backRef != old.backRef) {
+		t.dataKind = OP_DATA_CONST;
+		t.data = d->data;
+		t.backRef = d->backRef;
+	} else
+		t.dataKind = OP_DATA_NONE;
+	if (opCache.size() >= OP_CACHE)
+		opCache.clear();
+	opCache[std::string(p, len)] = t;
+	return (q);
+}
+
+char* opParse(char *p, opDescriptor *d, int *errorPtr) {
+	std::unordered_map<std::string, opTemplate>::iterator it;
+	int parenCount;
+	int len;
+	char *q;
+
+	try {
+		// if addressing mode in ( )
+		// remove spaces inside parenthesis       CK Oct-26-2008
+		if (p[0] == '(' || p[1] == '(') {
+			char *sr = p;
+			char *ds = p;
+			parenCount = 1;
+			*ds++ = *sr++;            // copy first char
+			if (*sr == '(')           // if second char is '('
+				*ds++ = *sr++;          // copy (
+			while (*sr && parenCount) {
+				if (*sr == '(')
+					parenCount++;
+				else if (*sr == ')')
+					parenCount--;
+				if (isspace(*sr))    // skip spaces
+					sr++;
+				else
+					*ds++ = *sr++;
+			}
+			if (!*sr && parenCount) {         // if no ')' found
+				NEWERROR(*errorPtr, SYNTAX);
+				return (NULL);
+			}
+
+			while ((*ds++ = *sr++) != 0)
+				;  // copy ')' and remaining text
+		}
+
+		len = opField(p);
+		if (len <= 0 || *errorPtr >= SEVERE)
+			q = opParseText(p, d, errorPtr);
+		else if ((it = opCache.find(std::string(p, len))) == opCache.end())
+			q = opRecord(p, len, d, errorPtr);
+		else if (!(q = opReplay(p, d, it->second, errorPtr))) // an error stopped
+			q = opParseText(p, d, errorPtr);                   //   the expression
+		if (q && (d->mode == PCDisp || d->mode == PCIndex))
+			depUseLoc();                  // the displacement depends on loc
+		return (q);
+	} catch (...) {
+		NEWERROR(*errorPtr, EXCEPTION);
+		sprintf(buffer,
+				"ERROR: An exception occurred in routine 'opParse'. \n");
+		return (NULL);
+	}
+}
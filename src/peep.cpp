@@ -0,0 +1,282 @@
+/***********************************************************************
+ *
+ *		PEEP.CPP
+ *		Peephole Optimizer for 68000 Assembler
+ *
+ *    Function: peepBuild()
+ *		Called by cacheBuild() with the selected flavor of every
+ *		instruction. With OPT PEEP the following forms are
+ *		replaced by faster equivalents that leave the condition
+ *		codes the same:
+ *
+ *		 CLR.L Dn              MOVEQ #0,Dn
+ *		 CMP #0,<ea>           TST <ea>
+ *		 LEA d(An),An          ADDQ.L #d,An or SUBQ.L #-d,An  (1 <= |d| <= 8)
+ *		 JSR <ea> + RTS        JMP <ea>  (the RTS is kept)
+ *		 MULU #2^n,Dn          SWAP Dn, CLR.W Dn, SWAP Dn, LSL.L #n,Dn
+ *
+ *		MULU leaves X alone and LSL sets it, so MULU is only
+ *		rewritten when the next instruction sets X itself.
+ *		JSR and MULU depend on the instruction that follows, so
+ *		pass 1 records the decision by candidate sequence number
+ *		and the next pass uses it. A MULU rewrite is longer, so
+ *		a new decision repeats pass 1 (see peepNext). When no
+ *		more pass 1 runs are allowed the new decisions are
+ *		dropped, so pass 2 keeps the sizes of the last pass 1.
+ *		     An immediate written as #n.L is never rewritten, as
+ *		for the MOVEQ, ADDQ and SUBQ forms chosen by build.cpp.
+ *		If the instruction was replaced the function returns
+ *		true after building it in pass 2 or sizing it in pass 1.
+ *
+ *		peepList()
+ *		Writes each rewrite and the cycles it saves to the
+ *		listing.
+ *
+ ************************************************************************/
+
+#include <cstdio>
+#include <vector>
+#include "../include/asm.h"
+#include "../include/build.h"
+#include "../include/codegen.h"
+#include "../include/cache.h"
+#include "../include/peep.h"
+
+extern thread_local int loc;
+extern bool pass2;
+extern bool PEEPflag;           // true replaces slow instruction forms
+extern int lineNumL68;          // listing line number
+
+struct peepSaving {
+	int line;                     // listing line number
+	int loc;                      // address of the instruction
+	const char *text;             // description of the rewrite
+	int cycles;                   // clock cycles saved
+};
+
+const int PEEP_NONE = 0;          // kinds of candidate waiting for the next
+const int PEEP_JSR = 1;           //   instruction
+const int PEEP_MULU = 2;
+
+static std::vector<char> peepTable;           // decision for each candidate
+static std::vector<peepSaving> peepSavings;   // rewrites made in pass 2
+static unsigned int peepSeq;                  // candidate sequence number
+static int peepKind;                          // candidate before this instruction
+static unsigned int peepPrev;                 // its sequence number
+static int peepEnd;                           // address following it
+static std::vector<unsigned int> peepGrew;     // MULU rewrites new in this pass
+static bool peepFlag;                         // PEEPflag at start of assembly
+
+//------------------------------------------------------------
+// Called at the start of an assembly
+int peepStart() {
+	peepTable.clear();
+	peepSavings.clear();
+	peepFlag = PEEPflag;
+	return (NORMAL);
+}
+
+// Called at the start of each pass
+int peepPass() {
+	PEEPflag = peepFlag;
+	peepSeq = 0;
+	peepKind = PEEP_NONE;
+	peepGrew.clear();
+	return (NORMAL);
+}
+
+static int peepNote(const char *text, int cycles) {
+	if (pass2)
+		peepSavings.push_back( { lineNumL68, loc, text, cycles });
+	return (NORMAL);
+}
+
+// true if the instruction sets X without reading it
+static bool peepSetsX(flavor *flavorPtr, int mask, opDescriptor *source,
+		opDescriptor *dest) {
+	int (*exec)(int, int, opDescriptor*, opDescriptor*, int*);
+	int type = mask & 0xF000;
+
+	exec = flavorPtr->exec;
+	if (exec == arithReg)               // ADD <ea>,Dn and SUB <ea>,Dn
+		return ((type == 0xD000 || type == 0x9000) && (mask & 0x00C0) != 0x00C0);
+	if (exec == arithAddr)              // ADD Dn,<ea> and SUB Dn,<ea>
+		return (type == 0xD000 || type == 0x9000);
+	if (exec == immedInst)              // ADDI and SUBI
+		return ((mask & 0xFF00) == 0x0600 || (mask & 0xFF00) == 0x0400);
+	if (exec == quickMath)              // ADDQ and SUBQ, except to An
+		return (dest->mode != AnDirect);
+	if (exec == oneOp)                  // NEG
+		return ((mask & 0xFF00) == 0x4400);
+	if (exec == shiftReg)               // ASd and LSd #n,Dn
+		return (source->mode == IMMEDIATE && (mask & 0x0010) == 0);
+	return (false);
+}
+
+// Returns n if value is 2^n with 1 <= n <= 8, otherwise 0
+static int peepPower(int value) {
+	for (int n = 1; n <= 8; n++)
+		if (value == (1 << n))
+			return (n);
+	return (0);
+}
+
+//------------------------------------------------------------
+// Replace the instruction with a faster form if there is one
+bool peepBuild(flavor *flavorPtr, int mask, int size, opDescriptor *source,
+		opDescriptor *dest, int *errorPtr) {
+	int (*exec)(int, int, opDescriptor*, opDescriptor*, int*);
+	opDescriptor quick;
+	unsigned int seq;
+	int n;
+
+	exec = flavorPtr->exec;
+
+	// decide the candidate before this instruction
+	if (!pass2 && peepKind != PEEP_NONE && loc == peepEnd) {
+		if (peepKind == PEEP_JSR)
+			peepTable[peepPrev] = (exec == zeroOp && mask == 0x4E75); // RTS
+		else if (peepKind == PEEP_MULU && !peepTable[peepPrev]
+				&& peepSetsX(flavorPtr, mask, source, dest)) {
+			peepTable[peepPrev] = true;
+			peepGrew.push_back(peepPrev);
+		}
+	}
+	peepKind = PEEP_NONE;
+	if (!PEEPflag)
+		return (false);
+
+	// CLR.L Dn -> MOVEQ #0,Dn
+	if (exec == oneOp && mask == 0x4280 && source->mode == DnDirect) {
+		if (pass2) {
+			quick.mode = IMMEDIATE;
+			quick.data = 0;
+			peepNote("CLR.L Dn -> MOVEQ #0,Dn", 2);
+			moveq(0x7000, LONG_SIZE, &quick, source, errorPtr);
+		} else
+			loc += 2;
+		return (true);
+	}
+
+	// CMP #0,<ea> -> TST <ea>
+	if (flavorPtr->source && source->mode == IMMEDIATE && source->backRef
+			&& source->data == 0 && source->size == 0
+			&& ((exec == arithReg && (mask & 0xF000) == 0xB000
+					&& (mask & 0x00C0) != 0x00C0)   // CMP #0,Dn
+			|| (exec == immedInst && (mask & 0xFF00) == 0x0C00))) { // CMPI #0,<ea>
+		if (pass2) {
+			if (dest->mode == DnDirect)
+				peepNote("CMP #0,Dn -> TST Dn", (size == LONG_SIZE) ? 10 : 4);
+			else
+				peepNote("CMPI #0,<ea> -> TST <ea>", (size == LONG_SIZE) ? 8 : 4);
+			oneOp(0x4A00 | (mask & 0x00C0), size, dest, source, errorPtr);
+		} else
+			loc += 2 + extSize(dest, size);
+		return (true);
+	}
+
+	// LEA d(An),An -> ADDQ.L #d,An or SUBQ.L #-d,An
+	if (exec == arithReg && mask == 0x41C0 && source->mode == AnIndDisp
+			&& source->backRef && source->reg == dest->reg
+			&& source->data >= -8 && source->data <= 8 && source->data) {
+		if (pass2) {
+			quick.mode = IMMEDIATE;
+			quick.data = (source->data > 0) ? source->data : -source->data;
+			peepNote("LEA d(An),An -> ADDQ/SUBQ (2 bytes)", 0);
+			quickMath((source->data > 0) ? 0x5080 : 0x5180, LONG_SIZE, &quick,
+					dest, errorPtr);
+		} else
+			loc += 2;
+		return (true);
+	}
+
+	// JSR <ea> followed by RTS -> JMP <ea>
+	if (exec == oneOp && mask == 0x4E80) {
+		seq = peepSeq++;
+		if (seq == peepTable.size())
+			peepTable.push_back(false);
+		cacheNoReplay();              // decided by the next instruction
+		if (!pass2) {
+			peepKind = PEEP_JSR;
+			peepPrev = seq;
+			peepTable[seq] = false;
+			peepEnd = loc + 2 + extSize(source, 0);
+			return (false);
+		}
+		if (seq >= peepTable.size() || !peepTable[seq])
+			return (false);
+		peepNote("JSR <ea> + RTS -> JMP <ea>", 24);
+		oneOp(0x4EC0, 0, source, dest, errorPtr);
+		return (true);
+	}
+
+	// MULU #2^n,Dn -> SWAP Dn, CLR.W Dn, SWAP Dn, LSL.L #n,Dn
+	if (exec == arithReg && mask == 0xC0C0 && source->mode == IMMEDIATE
+			&& source->backRef && source->size == 0
+			&& (n = peepPower(source->data)) != 0) {
+		seq = peepSeq++;
+		if (seq == peepTable.size())
+			peepTable.push_back(false);
+		cacheNoReplay();              // decided by the next instruction
+		if (!pass2) {
+			peepKind = PEEP_MULU;
+			peepPrev = seq;
+			if (!peepTable[seq]) {
+				peepEnd = loc + 4;
+				return (false);
+			}
+			peepEnd = loc + 8;
+			loc += 8;
+			return (true);
+		}
+		if (seq >= peepTable.size() || !peepTable[seq])
+			return (false);
+		peepNote("MULU #2^n,Dn -> SWAP, CLR.W, SWAP, LSL.L", 24 - 2 * n);
+		output(0x4840 | dest->reg, WORD_SIZE);      // SWAP Dn
+		loc += 2;
+		output(0x4240 | dest->reg, WORD_SIZE);      // CLR.W Dn
+		loc += 2;
+		output(0x4840 | dest->reg, WORD_SIZE);      // SWAP Dn
+		loc += 2;
+		output(0xE188 | ((n & 7) << 9) | dest->reg, WORD_SIZE); // LSL.L #n,Dn
+		loc += 2;
+		return (true);
+	}
+
+	return (false);
+}
+
+//------------------------------------------------------------
+// Called at the end of pass 1. Returns true if a MULU rewrite was
+// decided in this pass; its size was not known when it was assembled.
+// If last says pass 2 follows this pass the new rewrites are dropped.
+bool peepNext(bool last) {
+	if (last) {
+		for (size_t i = 0; i < peepGrew.size(); i++)
+			peepTable[peepGrew[i]] = false;
+		return (false);
+	}
+	return (!peepGrew.empty());
+}
+
+//------------------------------------------------------------
+// Write the rewrites to the listing file
+int peepList(FILE *listFile) {
+	int cycles = 0;
+
+	if (!PEEPflag && peepSavings.empty())
+		return (NORMAL);
+	for (size_t i = 0; i < peepSavings.size(); i++)
+		cycles += peepSavings[i].cycles;
+	fprintf(listFile, "Peephole: %d instruction%s rewritten, %d clock cycles saved\n",
+			(int) peepSavings.size(), (peepSavings.size() != 1) ? "s" : "", cycles);
+	if (peepSavings.empty())
+		return (NORMAL);
+	fprintf(listFile, "\n\nPEEPHOLE OPTIMIZATION INFORMATION\n");
+	fprintf(listFile, "Line    Address   Cycles  Rewrite\n");
+	fprintf(listFile, "-----------------------------------------------\n");
+	for (size_t i = 0; i < peepSavings.size(); i++)
+		fprintf(listFile, "%6d  %08X  %6d  %s\n", peepSavings[i].line,
+				peepSavings[i].loc, peepSavings[i].cycles, peepSavings[i].text);
+	return (NORMAL);
+}
@@ -0,0 +1,340 @@
+/***********************************************************************
+ *
+ *		PIPELINE.CPP
+ *		Pipelined Source Reading for 68000 Assembler
+ *
+ *    Function: pipeStart()
+ *		When PIPEflag is set, starts two threads for the pass.
+ *		The reader thread loads lines from the source file and
+ *		the lexer thread upper cases and tokenizes them the way
+ *		assemble() does and classifies each line. The stages
+ *		are connected by single producer / single consumer ring
+ *		buffers, so reading and lexing overlap with assembly.
+ *		A stage waiting on a full or empty ring sleeps until the
+ *		other stage moves it.
+ *
+ *		pipeRead()
+ *		Replaces fgets(line, 256, inFile) for the assembler. It
+ *		returns the next line of the source file from the
+ *		pipeline, or reads inFile directly when the pipeline is
+ *		off or an include file is being read.
+ *
+ *		pipeDirect()
+ *		True when pipeRead() reads inFile itself, so the caller
+ *		may move in it with fseek().
+ *
+ *		pipeLexed()
+ *		Called by assemble(). If the line is the one last
+ *		returned by pipeRead(), the capitalized line and tokens
+ *		made by the lexer are copied to the assembler's buffers
+ *		and true is returned.
+ *
+ *		pipeLex()
+ *		Lexes a line the way the lexer thread does. Used by
+ *		asmMacro() to keep the lexed lines of a macro expansion.
+ *
+ *		pipeReplay()
+ *		Makes the next pipeLexed() call for the same text use a
+ *		line lexed earlier by pipeLex().
+ *
+ *		pipeClass()
+ *		Classifies a line from its label and opcode columns only,
+ *		without strcap() and tokenize(). Used by assemble() to
+ *		pass over the lines skipped by conditional assembly.
+ *
+ *		pipeStop()
+ *		Stops the threads at the end of a pass so inFile can be
+ *		rewound.
+ *
+ ************************************************************************/
+
+#include <cstdio>
+#include <cctype>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include "../include/asm.h"
+#include "../include/assemble.h"
+#include "../include/pipeline.h"
+
+extern FILE *inFile;            // Input file
+extern bool PIPEflag;           // true reads and lexes source on other threads
+extern char *token[MAXT];       // pointers to tokens
+extern char tokens[MAX_SIZE];   // place tokens here
+extern char *tokenEnd[MAXT];    // where tokens end in source line
+extern char empty[];
+
+// Fixed size single producer / single consumer ring buffer. The
+// producer fills waitWrite() and calls commit(), the consumer reads
+// waitRead() and calls release(). A stage with no slot to use sleeps
+// on moved, which counts the commits and releases, until the other
+// stage moves or wake() is called. Both return NULL once stop is set.
+template<class T, size_t N>
+class spscRing {
+	T slot[N];
+	std::atomic<size_t> head;     // next slot to read
+	std::atomic<size_t> tail;     // next slot to write
+	std::atomic<unsigned> moved;  // commits, releases and wakes
+public:
+	spscRing() :
+			head(0), tail(0), moved(0) {
+	}
+	void reset() {
+		head.store(0);
+		tail.store(0);
+	}
+	void wake() {
+		moved.fetch_add(1, std::memory_order_release);
+		moved.notify_all();
+	}
+	T* waitWrite(const std::atomic<bool> &stop) {
+		size_t t = tail.load(std::memory_order_relaxed);
+		while (true) {
+			unsigned m = moved.load(std::memory_order_acquire);
+			if (t - head.load(std::memory_order_acquire) != N)
+				return (&slot[t % N]);
+			if (stop.load())
+				return (NULL);
+			moved.wait(m);
+		}
+	}
+	void commit() {
+		tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		wake();
+	}
+	T* waitRead(const std::atomic<bool> &stop) {
+		size_t h = head.load(std::memory_order_relaxed);
+		while (true) {
+			unsigned m = moved.load(std::memory_order_acquire);
+			if (h != tail.load(std::memory_order_acquire))
+				return (&slot[h % N]);
+			if (stop.load())
+				return (NULL);
+			moved.wait(m);
+		}
+	}
+	void release() {
+		head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		wake();
+	}
+};
+
+struct srcLine {
+	char line[256];
+	bool eof;
+};
+
+const size_t PIPE_DEPTH = 64;   // lines buffered between stages
+
+static spscRing<srcLine, PIPE_DEPTH> readRing;  // reader to lexer
+static spscRing<lexLine, PIPE_DEPTH> lexRing;   // lexer to assembler
+static std::thread readThread;
+static std::thread lexThread;
+static std::atomic<bool> stop(false);
+static bool active = false;     // true while the threads run
+static bool atEof;              // true after the last line was returned
+static FILE *pipeFile;          // file read by the pipeline
+static lexLine current;         // line last returned by pipeRead()
+static bool currentValid = false;
+static const lexLine *replayed; // line given to pipeReplay()
+
+static const char *condOps[] = { "IFC", "IFNC", "IFEQ", "IFNE", "IFLT", "IFLE",
+		"IFGT", "IFGE", "ENDC", NULL };
+
+//------------------------------------------------------------
+static void pipeReader(FILE *f) {
+	srcLine *s;
+
+	while (true) {
+		if (!(s = readRing.waitWrite(stop)))
+			return;
+		s->eof = !fgets(s->line, 256, f);
+		readRing.commit();
+		if (s->eof)
+			return;
+	}
+}
+
+// Lex l->line the way assemble() does
+void pipeLex(lexLine *l) {
+	char *tok[MAXT];
+	char *ends[MAXT];
+	char *p;
+
+	strcap(l->capLine, l->line);
+	tokenizeEnds(l->capLine, ", \t\n", tok, l->tokens, ends);
+	for (int i = 0; i < MAXT; i++) {
+		l->tokOff[i] = (tok[i] == empty) ? -1 : tok[i] - l->tokens;
+		l->endOff[i] = (ends[i]) ? ends[i] - l->capLine : -1;
+	}
+	p = skipSpace(l->capLine);
+	l->lexClass = LEX_OTHER;
+	if (*p == '*' || *p == ';')
+		l->lexClass = LEX_COMMENT;
+	else if (tok[1] != empty)
+		for (int i = 0; condOps[i]; i++)
+			if (!strcmp(tok[1], condOps[i])) {
+				l->lexClass = LEX_COND;
+				break;
+			}
+}
+
+static void pipeLexer() {
+	srcLine *s;
+	lexLine *l;
+
+	while (true) {
+		if (!(s = readRing.waitRead(stop)) || !(l = lexRing.waitWrite(stop)))
+			return;
+		l->eof = s->eof;
+		if (!s->eof) {
+			strcpy(l->line, s->line);
+			pipeLex(l);
+		}
+		lexRing.commit();
+		readRing.release();
+		if (l->eof)
+			return;
+	}
+}
+
+//------------------------------------------------------------
+// Returns LEX_COMMENT, LEX_COND or LEX_OTHER for line, as pipeLex()
+// would, reading only up to the end of the opcode. LEX_COND is also
+// returned when a quote or parenthesis makes the label unclear.
+int pipeClass(const char *line) {
+	char opcode[8];
+	const char *p = line;
+	int parenCount = 0;
+	bool quoted = false;
+	int i = 0;
+
+	while (*p && isspace(*p))       // skip leading spaces
+		p++;
+	if (*p == '*' || *p == ';')
+		return (LEX_COMMENT);
+	if (p == line) {                // skip label
+		while (*p && (!strchr(", \t\n", *p) || parenCount > 0 || quoted)) {
+			if (*p == '\'')
+				quoted = !quoted;
+			else if (*p == '(')
+				parenCount++;
+			else if (*p == ')')
+				parenCount--;
+			p++;
+		}
+		if (quoted || parenCount)
+			return (LEX_COND);
+		if (*p)
+			p++;                        // skip delimiter
+	}
+	while (*p && isspace(*p))
+		p++;
+	while (*p && !strchr(", \t\n", *p)) {
+		if (i == sizeof(opcode) - 1)
+			return (LEX_OTHER);         // longer than any conditional directive
+		opcode[i++] = toupper(*p++);
+	}
+	opcode[i] = '\0';
+	for (i = 0; condOps[i]; i++)
+		if (!strcmp(opcode, condOps[i]))
+			return (LEX_COND);
+	return (LEX_OTHER);
+}
+
+//------------------------------------------------------------
+// Start the pipeline on file f for one pass
+int pipeStart(FILE *f) {
+	if (!PIPEflag || active)
+		return (NORMAL);
+	try {
+		readRing.reset();
+		lexRing.reset();
+		stop.store(false);
+		atEof = false;
+		currentValid = false;
+		pipeFile = f;
+		readThread = std::thread(pipeReader, f);
+		lexThread = std::thread(pipeLexer);
+		active = true;
+	} catch (...) {
+		stop.store(true);
+		readRing.wake();
+		if (readThread.joinable())
+			readThread.join();
+		active = false;           // read the file directly
+	}
+	return (NORMAL);
+}
+
+// Stop the pipeline threads
+int pipeStop() {
+	if (!active)
+		return (NORMAL);
+	stop.store(true);
+	readRing.wake();
+	lexRing.wake();
+	readThread.join();
+	lexThread.join();
+	active = false;
+	currentValid = false;
+	return (NORMAL);
+}
+
+// Read the next source line into line
+bool pipeRead(char *line) {
+	lexLine *l;
+
+	if (!active || inFile != pipeFile)
+		return (fgets(line, 256, inFile) != NULL);
+	if (atEof)
+		return (false);
+	l = lexRing.waitRead(stop);       // the lexer always ends with eof
+	if (l->eof) {
+		lexRing.release();
+		atEof = true;
+		currentValid = false;
+		return (false);
+	}
+	current = *l;
+	lexRing.release();
+	strcpy(line, current.line);
+	currentValid = true;
+	return (true);
+}
+
+// true if pipeRead() reads inFile directly
+bool pipeDirect() {
+	return (!active || inFile != pipeFile);
+}
+
+// If text is the line last read from the pipeline, copy its lexed form
+// to capLine, token[], tokens and tokenEnd[].
+bool pipeLexed(char *text, char *capLine, int *lexClass) {
+	const lexLine *l;
+
+	if (replayed && !strcmp(text, replayed->line))
+		l = replayed;               // line of a macro expansion
+	else if (currentValid && !strcmp(text, current.line)) {
+		l = &current;
+		currentValid = false;
+	} else {
+		replayed = NULL;
+		return (false);
+	}
+	replayed = NULL;
+	strcpy(capLine, l->capLine);
+	memcpy(tokens, l->tokens, MAX_SIZE);
+	for (int i = 0; i < MAXT; i++) {
+		token[i] = (l->tokOff[i] < 0) ? empty : tokens + l->tokOff[i];
+		tokenEnd[i] = (l->endOff[i] < 0) ? NULL : capLine + l->endOff[i];
+	}
+	*lexClass = l->lexClass;
+	return (true);
+}
+
+// Use l, lexed by pipeLex(), for the next line given to pipeLexed()
+int pipeReplay(const lexLine *l) {
+	replayed = l;
+	return (NORMAL);
+}
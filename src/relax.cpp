@@ -0,0 +1,354 @@
+/***********************************************************************
+ *
+ *		RELAX.CPP
+ *		Branch Relaxation and Effective Address Sizing
+ *		for 68000 Assembler
+ *
+ *    Function: relaxBranch()
+ *		Called by instSize() in pass 1 and by branch() in pass 2
+ *		for every Bcc, BRA and BSR without a size code whose
+ *		target is a forward reference. Returns true if the
+ *		branch is to use the short (8 bit) displacement.
+ *		     Branches are matched between passes by their
+ *		sequence number in the pass. A branch starts long and,
+ *		with OPT RELAX, is made short in a pass 1 when the
+ *		addresses of the previous pass 1 show that it fits.
+ *		Once short a branch stays short, so code only ever
+ *		shrinks and the displacement of a forward branch can
+ *		only get smaller than the one that was checked. Pass 2
+ *		uses the sizes of the last pass 1 and cannot produce a
+ *		PHASE_ERROR.
+ *
+ *		relaxOperands()
+ *		Called by cacheBuild() in both passes with the operands
+ *		of the selected flavor. With OPT EAOPT a forward
+ *		reference is sized like a branch: an absolute long
+ *		operand becomes d16(PC) if the flavor accepts it and the
+ *		target is ahead in range, otherwise (xxx).W if the value
+ *		fits in a sign-extended word; d16(An) with a zero
+ *		displacement becomes (An). Operands with a known value
+ *		get the same shorter modes directly. An explicit .L
+ *		size is kept.
+ *
+ *		relaxDefine(), relaxValue()
+ *		Pass 1 records the value of every symbol it defines.
+ *		In the next pass 1, a forward reference evaluates to
+ *		the value the symbol had at the end of the previous
+ *		pass (it is still reported as INCOMPLETE).
+ *
+ *		relaxNext()
+ *		Called at the end of pass 1. Returns true if pass 1 must
+ *		be repeated because a branch or operand became shorter,
+ *		up to RELAX_PASSES times and not after the last pass 1
+ *		processFile() allows.
+ *
+ *		relaxForget()
+ *		Called when pass 1 is repeated for a reason that made
+ *		code longer or changed which branches are forward; the
+ *		next pass starts over without values or decisions.
+ *
+ *		relaxList()
+ *		Writes the number of bytes saved to the listing, with
+ *		one line for each operand made shorter.
+ *
+ ************************************************************************/
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+#include "../include/asm.h"
+#include "../include/build.h"
+#include "../include/cache.h"
+#include "../include/relax.h"
+
+extern thread_local int loc;
+extern bool pass2;
+extern bool RELAXflag;          // true shortens forward branches
+extern bool EAOPTflag;          // true picks the shortest operand modes
+extern int lineNumL68;          // listing line number
+
+struct relaxEntry {
+	int loc;                      // address of the branch in the last pass 1
+	bool isShort;                 // true if the branch uses the short form
+};
+
+struct relaxEA {
+	int loc;                      // address of the instruction in the last pass 1
+	int mode;                     // mode used, 0 if not shortened
+};
+
+struct relaxSaving {
+	int line;                     // listing line number
+	int loc;                      // address of the instruction
+	int mode;                     // mode used
+};
+
+static std::vector<relaxEntry> relaxTable;     // one entry per forward branch
+static std::vector<relaxEA> relaxEATable;    // one entry per forward operand
+static std::vector<relaxSaving> relaxSavings;  // operands shortened in pass 2
+static std::map<std::string, int> relaxDefs;   // symbols defined in this pass 1
+static std::map<std::string, int> relaxValues; // symbols of the previous pass 1
+static unsigned int relaxSeq;                  // branch sequence number
+static unsigned int relaxEASeq;                // operand sequence number
+static int relaxPasses;                        // number of pass 1 runs so far
+static int relaxShortened;                     // branches made short this pass
+static int relaxCandidates;                    // long forms that may shrink
+static bool relaxUnknown;                      // true if an operand has no value
+static bool relaxFresh;                        // true if no previous pass 1 values
+static bool relaxFlag;                         // RELAXflag at start of assembly
+static bool eaoptFlag;                         // EAOPTflag at start of assembly
+
+const int RELAX_PASSES = 8;       // most pass 1 runs for one assembly
+
+//------------------------------------------------------------
+// Called at the start of an assembly
+int relaxStart() {
+	relaxTable.clear();
+	relaxEATable.clear();
+	relaxSavings.clear();
+	relaxDefs.clear();
+	relaxValues.clear();
+	relaxPasses = 0;
+	relaxFresh = true;
+	relaxFlag = RELAXflag;
+	eaoptFlag = EAOPTflag;
+	return (NORMAL);
+}
+
+// Called at the start of each pass. The options are restored so that
+// OPT RELAX and OPT EAOPT apply to the same lines in every pass.
+int relaxPass() {
+	if (!pass2)
+		relaxPasses++;
+	RELAXflag = relaxFlag;
+	EAOPTflag = eaoptFlag;
+	relaxSeq = 0;
+	relaxEASeq = 0;
+	relaxShortened = 0;
+	relaxCandidates = 0;
+	relaxDefs.clear();
+	return (NORMAL);
+}
+
+// Called for every instruction before its operands are parsed
+int relaxLine() {
+	relaxUnknown = false;
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Called from define() in pass 1
+int relaxDefine(const char *sym, int value) {
+	relaxDefs[sym] = value;
+	return (NORMAL);
+}
+
+// Called from evalNumber() in pass 1 for an undefined symbol.
+// Returns true and the value from the previous pass 1 if known.
+bool relaxValue(const char *sym, int *valuePtr) {
+	std::map<std::string, int>::iterator it = relaxValues.find(sym);
+
+	if (it == relaxValues.end()) {
+		relaxUnknown = true;
+		return (false);
+	}
+	*valuePtr = it->second;
+	return (true);
+}
+
+//------------------------------------------------------------
+// Pre: loc is the address of the branch, target is its operand
+// Returns true if the branch uses the short form
+bool relaxBranch(int target) {
+	unsigned int seq = relaxSeq++;
+	int between;
+
+	if (pass2)
+		return (seq < relaxTable.size() && relaxTable[seq].isShort);
+
+	if (seq == relaxTable.size()) {
+		relaxEntry entry;
+		entry.loc = loc;
+		entry.isShort = false;
+		relaxTable.push_back(entry);
+		if (RELAXflag)
+			relaxCandidates++;
+		return (false);
+	}
+	if (seq > relaxTable.size())
+		return (false);
+	relaxEntry *entry = &relaxTable[seq];
+	if (!entry->isShort && RELAXflag)
+		relaxCandidates++;
+	if (!entry->isShort && RELAXflag && !relaxFresh && !relaxUnknown) {
+		// bytes between the end of the long branch and its target
+		// in the previous pass; never more than in this pass
+		between = target - entry->loc - 4;
+		if (between > 0 && between <= 127) {
+			entry->isShort = true;
+			relaxShortened++;
+		}
+	}
+	entry->loc = loc;
+	return (entry->isShort);
+}
+
+//------------------------------------------------------------
+// Returns the shorter mode for an operand whose value is known, or 0
+static int relaxKnown(opDescriptor *d, int modes) {
+	if (d->mode == AnIndDisp && d->data == 0 && (modes & AnInd))
+		return (AnInd);
+	if (d->mode == AbsLong && d->size == 0 && (modes & PCDisp)
+			&& d->data - (loc + 2) <= 32767 && d->data - (loc + 10) >= -32768)
+		return (PCDisp);   // extension word is 2 to 10 bytes into the instruction
+	return (0);
+}
+
+// Returns the shorter mode for a forward reference in pass 1, or 0.
+// prev is the address of the instruction in the previous pass 1; the
+// distance to a forward target and the addresses can only get smaller.
+static int relaxForward(opDescriptor *d, int modes, int prev) {
+	if (d->mode == AnIndDisp && d->data == 0 && (modes & AnInd))
+		return (AnInd);
+	if (d->mode == AbsLong && d->size == 0) {
+		if ((modes & PCDisp) && d->data > prev + 10 && d->data - (prev + 2) <= 32767)
+			return (PCDisp);
+		if ((modes & AbsShort) && d->data >= -32768 && d->data <= 32767)
+			return (AbsShort);
+	}
+	return (0);
+}
+
+// Pick the mode for one operand of an instruction
+static int relaxOperand(opDescriptor *d, int modes, int *errorPtr) {
+	unsigned int seq;
+	relaxEA *entry;
+	int mode;
+
+	if (!(d->mode == AnIndDisp || (d->mode == AbsLong && d->size == 0)))
+		return (NORMAL);
+	if (d->backRef) {                 // value is the same in both passes
+		if (EAOPTflag && (mode = relaxKnown(d, modes)) != 0) {
+			cacheNoReplay();          // assemble again in pass 2 to list it
+			if (pass2)
+				relaxSavings.push_back( { lineNumL68, loc, mode });
+			d->mode = mode;
+		}
+		return (NORMAL);
+	}
+
+	seq = relaxEASeq++;
+	if (pass2) {
+		if (seq >= relaxEATable.size() || !relaxEATable[seq].mode)
+			return (NORMAL);
+		mode = relaxEATable[seq].mode;
+		if (mode == AnInd && d->data != 0)
+			NEWERROR(*errorPtr, INV_DISP);
+		// AbsShort and PCDisp are range checked by extWords()
+		relaxSavings.push_back( { lineNumL68, loc, mode });
+		d->mode = mode;
+		return (NORMAL);
+	}
+
+	if (seq == relaxEATable.size()) {
+		relaxEA entry;
+		entry.loc = loc;
+		entry.mode = 0;
+		relaxEATable.push_back(entry);
+		if (EAOPTflag)
+			relaxCandidates++;
+		return (NORMAL);
+	}
+	if (seq > relaxEATable.size())
+		return (NORMAL);
+	entry = &relaxEATable[seq];
+	if (!entry->mode && EAOPTflag) {
+		relaxCandidates++;
+		if (!relaxFresh && !relaxUnknown) {
+			entry->mode = relaxForward(d, modes, entry->loc);
+			if (entry->mode)
+				relaxShortened++;
+		}
+	}
+	entry->loc = loc;
+	if (entry->mode)
+		d->mode = entry->mode;
+	return (NORMAL);
+}
+
+// Called by cacheBuild() before the instruction is sized or built
+int relaxOperands(flavor *flavorPtr, opDescriptor *source, opDescriptor *dest,
+		int *errorPtr) {
+	if (flavorPtr->exec == movep)     // MOVEP always has a displacement
+		return (NORMAL);
+	if (flavorPtr->source)
+		relaxOperand(source, flavorPtr->source, errorPtr);
+	if (flavorPtr->dest)
+		relaxOperand(dest, flavorPtr->dest, errorPtr);
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Called at the end of pass 1. Returns true to repeat pass 1, unless
+// last says pass 2 follows this pass.
+bool relaxNext(bool last) {
+	bool fresh = relaxFresh;
+
+	relaxValues.swap(relaxDefs);
+	relaxDefs.clear();
+	relaxFresh = false;
+	if (last || !relaxCandidates || relaxPasses >= RELAX_PASSES)
+		return (false);
+	// a pass without previous values could not shorten anything
+	return (fresh || relaxShortened > 0);
+}
+
+// Called instead of relaxNext() when pass 1 is repeated because code
+// grew or branches changed; neither the addresses of this pass nor the
+// decisions matched by sequence number can be used again
+int relaxForget() {
+	relaxTable.clear();
+	relaxEATable.clear();
+	relaxValues.clear();
+	relaxDefs.clear();
+	relaxFresh = true;
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Write the relaxation results to the listing file
+int relaxList(FILE *listFile) {
+	int count = 0;
+	const char *form;
+
+	for (size_t i = 0; i < relaxTable.size(); i++)
+		if (relaxTable[i].isShort)
+			count++;
+	if (RELAXflag || count)
+		fprintf(listFile, "Branch relaxation: %d of %d forward branch%s shortened, %d bytes saved in %d passes\n",
+				count, (int) relaxTable.size(), (relaxTable.size() != 1) ? "es" : "",
+				count * 2, relaxPasses + 1);
+
+	if (!EAOPTflag && relaxSavings.empty())
+		return (NORMAL);
+	fprintf(listFile, "Operand sizing: %d operand%s shortened, %d bytes saved\n",
+			(int) relaxSavings.size(), (relaxSavings.size() != 1) ? "s" : "",
+			(int) relaxSavings.size() * 2);
+	if (relaxSavings.empty())
+		return (NORMAL);
+	fprintf(listFile, "\n\nOPERAND SIZING INFORMATION\n");
+	fprintf(listFile, "Line    Address   Saved  Mode\n");
+	fprintf(listFile, "------------------------------\n");
+	for (size_t i = 0; i < relaxSavings.size(); i++) {
+		if (relaxSavings[i].mode == AnInd)
+			form = "(An)";
+		else if (relaxSavings[i].mode == PCDisp)
+			form = "d16(PC)";
+		else
+			form = "(xxx).W";
+		fprintf(listFile, "%6d  %08X  %5d  %s\n", relaxSavings[i].line,
+				relaxSavings[i].loc, 2, form);
+	}
+	return (NORMAL);
+}
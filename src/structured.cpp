@@ -10,23 +10,32 @@
  ************************************************************************/
 
 #include <algorithm>
+#include <map>
 #include <stack>
 #include <vector>
 #include <cstdio>
+#include <cstdlib>
 #include <cctype>
 #include <string>
 #include "../include/extern.h"
 #include "../include/asm.h"
 #include "../include/structured.h"
+#include "../include/chain.h"
+#include "../include/cycles.h"
+#include "../include/advise.h"
+#include "../include/unroll.h"
+#include "../include/hotpath.h"
 #include "../include/symbol.h"
 #include "../include/assemble.h"
+#include "../include/error.h"
+#include "../include/opparse.h"
 #include "../include/listing.h"
 
 
 extern char line[LINE_LENGTH];		// Source line
 extern bool listFlag;
 extern bool pass2;		// Flag set during second pass
-extern int loc;		// The assembler's location counter
+extern thread_local int loc;		// The assembler's location counter
 extern unsigned int stcLabelI;  // structured if label number
 extern unsigned int stcLabelW;  // structured while label number
 extern unsigned int stcLabelR;  // structured repeat label number
@@ -35,11 +44,14 @@ extern unsigned int stcLabelD;  // structured dbloop label number
 extern int errorCount;
 extern int warningCount;
 extern bool SEXflag;            // true expands structured listing
+extern bool LOOPflag;           // true tests structured loops at the bottom
 extern int lineNum;
 extern FILE *listFile;		// Listing file
 extern bool skipList;           // true to skip listing line in ASSEMBLE.CPP
 extern int macroNestLevel;     // used by macro processing
 extern char lineIdent[];        // "s" used to identify structure in listing
+extern instruction opcodeTable[];
+extern int opcodeCount;
 
 const unsigned int stcMask = 0xF0000000;
 const unsigned int stcMaskI = 0x00000000;
@@ -70,7 +82,9 @@ std::stack<int, std::vector<int> > stcStack;
 // Make a stack for saving dbloop register number
 std::stack<char, std::vector<char> > dbStack;
 // Make a stack for saving FOR arguments
-std::stack<std::string, std::vector<std::string> > forStack;
+std::stack<stcInst, std::vector<stcInst> > forStack;
+// Make a stack for saving the test of a WHILE tested at the bottom
+std::stack<std::vector<stcInst>, std::vector<std::vector<stcInst> > > whileStack;
 
 // This table contains the branch condition codes to use for the different
 // conditional expressions.
@@ -116,6 +130,59 @@ std::string getBcc(std::string cc, int mode, int orx) {
 	return ("B??");
 }
 
+//-------------------------------------------------------
+// an instruction of structured code, dest is empty if it has one operand
+stcInst stcOp(const std::string &mnemonic, const std::string &size,
+		const std::string &source, const std::string &dest) {
+	stcInst inst;
+
+	inst.mnemonic = mnemonic;
+	inst.size = size;
+	inst.source = source;
+	inst.dest = dest;
+	return (inst);
+}
+
+// a structured label
+static stcInst stcMark(const std::string &label) {
+	stcInst inst;
+
+	inst.label = label;
+	return (inst);
+}
+
+//-------------------------------------------------------
+// assemble a line of structured code, or add it to code for later
+static void stcCode(const stcInst &inst, std::vector<stcInst> *code) {
+	if (code)
+		code->push_back(inst);
+	else
+		assembleStc(inst);
+}
+
+//-------------------------------------------------------
+// true if FOR counts a data register down by one to #0 as a word, so that
+// DBRA can count it
+// token[n] is op1, see asmStructure()
+static bool stcDbra(char *token[], int n) {
+	if (token[2][0] == '.' && token[2][1] != 'W')
+		return (false);
+	return (token[n][0] == 'D' && isRegNum(token[n][1]) && token[n][2] == '\0'
+			&& !(strcmp(token[n + 3], "DOWNTO")) && !(strcmp(token[n + 4], "#0"))
+			&& (strcmp(token[n + 5], "BY") || !(strcmp(token[n + 6], "#1"))));
+}
+
+// true if op is #n with 0 <= n <= 32767 written in decimal
+static bool stcPositive(const char *op) {
+	int i;
+
+	if (op[0] != '#' || !op[1])
+		return (false);
+	for (i = 1; isdigit(op[i]); i++)
+		;
+	return (op[i] == '\0' && i <= 6 && atoi(&op[1]) <= 32767);
+}
+
 //-------------------------------------------------------
 // output a CMP and Branch to perform the specified expression
 // Pre: the code is in all caps
@@ -134,31 +201,33 @@ std::string getBcc(std::string cc, int mode, int orx) {
 //    .B   <cc>   AND   .B    D0   <cc>   D1   THEN
 //    .B    D0   <cc>   D1    AND   .B    D2   <cc>   D3   THEN
 
+// orx 1 branches when the expression is true, 0 when it is false, -1 picks
+// the sense from OR in the tokens. With code the lines are added to it to be
+// assembled later instead of being assembled now.
 //void outCmpBcc( char *size, char *op1, char *cc, char *op2, char *op3, char *last, std::string label, int &error) {
-void outCmpBcc(char *token[], char *last, std::string label, int &error) {
+void outCmpBcc(char *token[], char *last, std::string label, int &error,
+		int orx, std::vector<stcInst> *code) {
 
-	std::string stcLine;
 	std::string stcCmp;
 	std::string extent;
-	int orx = 0;
 	int n = 0;
 
 	try {
 		error = OK;
 		if (token[n][0] == '.') {
 			if (token[n][1] == 'B')
-				stcCmp = "\tCMP.B\t";
+				stcCmp = ".B\t";
 			else if (token[n][1] == 'W')
-				stcCmp = "\tCMP.W\t";
+				stcCmp = ".W\t";
 			else if (token[n][1] == 'L')
-				stcCmp = "\tCMP.L\t";
+				stcCmp = ".L\t";
 			else {
 				error = SYNTAX;
 				return;
 			}
 			n++;                        // token[n] at 1
 		} else
-			stcCmp = "\tCMP.W\t";
+			stcCmp = ".W\t";
 
 		// determine size of extent if present
 		if (last[0] == '.') {
@@ -173,56 +242,43 @@ void outCmpBcc(char *token[], char *last, std::string label, int &error) {
 		} else
 			extent = "\t";
 
-		if (!(strcmp(token[n + 1], "OR")) || !(strcmp(token[n + 3], "OR"))) {
-			orx = 1;
-			extent = ".S\t";       // first branch with OR logic is always short
+		if (orx < 0) {                // sense of the branch from the expression
+			orx = 0;
+			if (!(strcmp(token[n + 1], "OR")) || !(strcmp(token[n + 3], "OR"))) {
+				orx = 1;
+				extent = ".S\t";     // first branch with OR logic is always short
+			}
 		}
+		label = chainTarget(extent, label);  // OPT CHAIN final destination
 
 		if (token[n][0] == '<') {     // IF <cc> THEN
-			stcLine = "\t" + getBcc(token[n], IF_CC, orx) + extent + label
-					+ "\n";
-			assembleStc(stcLine.c_str());
+			stcCode(stcOp(getBcc(token[n], IF_CC, orx), extent, label), code);
 		} else if (token[n][0] == '#') {                    // #nn <cc> ea
-			stcLine = stcCmp + (std::string) token[n] + "," + token[n + 2]
-					+ "\n";
-			assembleStc(stcLine.c_str());
-			stcLine = "\t" + getBcc(token[n + 1], IM_EA, orx) + extent + label
-					+ "\n";
-			assembleStc(stcLine.c_str());
+			stcCode(stcOp("CMP", stcCmp, token[n], token[n + 2]), code);
+			stcCode(stcOp(getBcc(token[n + 1], IM_EA, orx), extent, label),
+					code);
 		} else if (token[n + 2][0] == '#') {                    // ea <cc> #nn
-			stcLine = stcCmp + (std::string) token[n + 2] + ","
-					+ (std::string) token[n] + "\n";
-			assembleStc(stcLine.c_str());
-			stcLine = "\t" + getBcc(token[n + 1], EA_IM, orx) + extent + label
-					+ "\n";
-			assembleStc(stcLine.c_str());
+			stcCode(stcOp("CMP", stcCmp, token[n + 2], token[n]), code);
+			stcCode(stcOp(getBcc(token[n + 1], EA_IM, orx), extent, label),
+					code);
 			// Rn <cc> ea
 		} else if ((token[n][0] == 'A' || token[n][0] == 'D')
 				&& isRegNum(token[n][1])) {
-			stcLine = stcCmp + (std::string) token[n + 2] + ","
-					+ (std::string) token[n] + "\n";
-			assembleStc(stcLine.c_str());
-			stcLine = "\t" + getBcc(token[n + 1], RN_EA, orx) + extent + label
-					+ "\n";
-			assembleStc(stcLine.c_str());
+			stcCode(stcOp("CMP", stcCmp, token[n + 2], token[n]), code);
+			stcCode(stcOp(getBcc(token[n + 1], RN_EA, orx), extent, label),
+					code);
 			// ea <cc> Rn
 		} else if ((token[n + 2][0] == 'A' || token[n + 2][0] == 'D')
 				&& isRegNum(token[n + 2][1])) {
-			stcLine = stcCmp + (std::string) token[n] + ","
-					+ (std::string) token[n + 2] + "\n";
-			assembleStc(stcLine.c_str());
-			stcLine = "\t" + getBcc(token[n + 1], EA_RN, orx) + extent + label
-					+ "\n";
-			assembleStc(stcLine.c_str());
+			stcCode(stcOp("CMP", stcCmp, token[n], token[n + 2]), code);
+			stcCode(stcOp(getBcc(token[n + 1], EA_RN, orx), extent, label),
+					code);
 			// (An)+ <cc> (An)+  also supports (SP)+ (MUST BE LAST IN IF-ELSE CHAIN)
 		} else if ((token[n][0] == '(' && token[n][3] == ')'
 				&& token[n][4] == '+')) {
-			stcLine = stcCmp + (std::string) token[n] + ","
-					+ (std::string) token[n + 2] + "\n";
-			assembleStc(stcLine.c_str());
-			stcLine = "\t" + getBcc(token[n + 1], RN_EA, orx) + extent + label
-					+ "\n";
-			assembleStc(stcLine.c_str());
+			stcCode(stcOp("CMP", stcCmp, token[n], token[n + 2]), code);
+			stcCode(stcOp(getBcc(token[n + 1], RN_EA, orx), extent, label),
+					code);
 		} else {
 			error = SYNTAX;
 		}
@@ -270,6 +326,13 @@ void outCmpBcc(char *token[], char *last, std::string label, int &error) {
 
  ENDF
 
+ UNROLL symbol = op1 TO     op2        (also with OPT UNROLL, FOR with
+ UNROLL symbol = op1 TO     op2 BY op3  constant bounds, see UNROLL.CPP)
+ UNROLL symbol = op1 DOWNTO op2
+ UNROLL symbol = op1 DOWNTO op2 BY op3
+
+ ENDU
+
  DBLOOP op1 = op2
  UNLESS
  UNLESS <F>
@@ -295,9 +358,11 @@ int asmStructure(int size, char *label, char *arg, int *errorPtr) {
 		char tokens[512];             // place tokens here
 		char capLine[256];
 		char tokenEnd[10];            // last token of structure goes here
+		char shortEnd[] = ".S";       // branch over the next test
 		std::string stcLabel;
 		std::string stcLabel2;
-		std::string stcLine;
+		std::vector<stcInst> stcTest;  // test of a WHILE tested at the bottom
+		stcInst inst;
 		std::string sizeStr;
 		std::string extent;
 		symbolDef *symbol;
@@ -306,6 +371,7 @@ int asmStructure(int size, char *label, char *arg, int *errorPtr) {
 		bool backRef;
 		int n = 2;                    // token index
 		int i;
+		long long trip;               // steps of a FOR with constant bounds
 
 		if (*label)                           // if label
 			define(label, loc, pass2, true, errorPtr); // define label
@@ -353,8 +419,7 @@ int asmStructure(int size, char *label, char *arg, int *errorPtr) {
 				//           .B/W/L       op3      <cc>      op4       THEN      THEN.?    label
 				outCmpBcc(&token[n + 2], tokenEnd, stcLabel, error);
 				NEWERROR(*errorPtr, error);
-				stcLine = stcLabel2 + "\n";
-				assembleStc(stcLine.c_str());
+				assembleStc(stcMark(stcLabel2));
 			} else if (!(strcmp(token[n + 3], "OR"))) { // IF ea <cc> ea OR
 				stcLabel2 = stcLabel;
 				stcLabelI++;
@@ -362,8 +427,7 @@ int asmStructure(int size, char *label, char *arg, int *errorPtr) {
 				//           .B/W/L       op3      <cc>      op4       THEN      THEN.?    label
 				outCmpBcc(&token[n + 4], tokenEnd, stcLabel, error);
 				NEWERROR(*errorPtr, error);
-				stcLine = stcLabel2 + "\n";
-				assembleStc(stcLine.c_str());
+				assembleStc(stcMark(stcLabel2));
 			} else if (!(strcmp(token[n + 1], "AND"))) { // IF <cc> AND
 				//            .B/W/L       op3       <cc>      op4       THEN     THEN.?    label
 				outCmpBcc(&token[n + 2], tokenEnd, stcLabel, error);
@@ -399,13 +463,10 @@ int asmStructure(int size, char *label, char *arg, int *errorPtr) {
 			}
 
 			stcLabel = std::string("_") + IntToHex(stcLabelI, 8);
-			stcLine = "\tBRA" + extent + stcLabel + "\n";
-			assembleStc(stcLine.c_str());
+			chainBranch(extent, stcLabel);      //   BRA _00000001
 			stcStack.push(stcLabelI);
 			stcLabelI++;
-			stcLine = std::string("_") + IntToHex(elseLbl, 8)
-					+ std::string("\n");
-			assembleStc(stcLine.c_str());
+			assembleStc(stcMark(std::string("_") + IntToHex(elseLbl, 8)));
 			skipList = true;          // don't display this line in ASSEMBLE.CPP
 		}
 
@@ -415,19 +476,73 @@ int asmStructure(int size, char *label, char *arg, int *errorPtr) {
 			stcStack.pop();
 			if ((endiLbl & stcMask) != stcMaskI)   // if label is not from an IF
 				NEWERROR(*errorPtr, NO_IF);
-			stcLine = std::string("_") + IntToHex(endiLbl, 8)
-					+ std::string("\n");
-			assembleStc(stcLine.c_str());
+			assembleStc(stcMark(std::string("_") + IntToHex(endiLbl, 8)));
 			skipList = true;          // don't display this line in ASSEMBLE.CPP
 		}
 
 		// -------------------- WHILE --------------------
 		// WHILE[.B|.W|.L] op1 <cc> op2 [OR/AND[.B|.W|.L]  op3 <cc> op4] DO
 		// WHILE <T> D0 create infinite loop
-		if (!(strcmp(token[1], "WHILE"))) {          // WHILE
+		// With OPT LOOP the test is moved to the bottom of the loop:
+		//   BRA _10000001   _10000000 body _10000001 test Bcc _10000000   _10000002
+		if (!(strcmp(token[1], "WHILE")) && LOOPflag && (strcmp(token[n], "<T>"))) {
+			tokenEnd[0] = '\0';
+			for (i = 3; i <= LAST_TOKEN; i++) {
+				if (!(strcmp(token[i], "DO"))) {     // if DO
+					strncpy(tokenEnd, token[i + 1], 3); // copy branch distance to tokenEnd
+					break;
+				}
+			}
+			if (i > LAST_TOKEN)                  // if DO not found
+				NEWERROR(*errorPtr, DO_EXPECTED);
+			if (tokenEnd[0] == '.') {
+				if (tokenEnd[1] == 'S')
+					extent = ".S\t";
+				else if (tokenEnd[1] == 'L')
+					extent = ".L\t";
+				else {
+					NEWERROR(*errorPtr, SYNTAX);
+				}
+			} else {
+				extent = "\t";
+			}
+
+			stcLabel = "_" + IntToHex(stcLabelW, 8);        // loop body
+			stcLabel2 = "_" + IntToHex(stcLabelW + 1, 8);   // loop test
+			chainBranch(extent, stcLabel2);     //   BRA _10000001
+			assembleStc(stcMark(stcLabel));       // _10000000
+
+			stcTest.assign(1, stcMark(stcLabel2)); // test assembled by ENDW
+			if (!(strcmp(token[n + 1], "OR"))) {      // WHILE <cc> OR
+				outCmpBcc(&token[2], tokenEnd, stcLabel, error, 1, &stcTest);
+				NEWERROR(*errorPtr, error);
+				outCmpBcc(&token[n + 2], tokenEnd, stcLabel, error, 1, &stcTest);
+			} else if (!(strcmp(token[n + 3], "OR"))) { // WHILE ea <cc> ea OR
+				outCmpBcc(&token[2], tokenEnd, stcLabel, error, 1, &stcTest);
+				NEWERROR(*errorPtr, error);
+				outCmpBcc(&token[n + 4], tokenEnd, stcLabel, error, 1, &stcTest);
+			} else if (!(strcmp(token[n + 1], "AND"))) { // WHILE <cc> AND
+				outCmpBcc(&token[2], shortEnd, "_" + IntToHex(stcLabelW + 2, 8),
+						error, 0, &stcTest);          // false leaves the loop
+				NEWERROR(*errorPtr, error);
+				outCmpBcc(&token[n + 2], tokenEnd, stcLabel, error, 1, &stcTest);
+			} else if (!(strcmp(token[n + 3], "AND"))) { // WHILE ea <cc> ea AND
+				outCmpBcc(&token[2], shortEnd, "_" + IntToHex(stcLabelW + 2, 8),
+						error, 0, &stcTest);          // false leaves the loop
+				NEWERROR(*errorPtr, error);
+				outCmpBcc(&token[n + 4], tokenEnd, stcLabel, error, 1, &stcTest);
+			} else
+				outCmpBcc(&token[2], tokenEnd, stcLabel, error, 1, &stcTest);
+			NEWERROR(*errorPtr, error);
+			whileStack.push(stcTest);
+
+			stcStack.push(stcLabelW);
+			stcStack.push(stcLabelW + 2);
+			stcLabelW += 3;
+			skipList = true;          // don't display this line in ASSEMBLE.CPP
+		} else if (!(strcmp(token[1], "WHILE"))) {   // WHILE
 			stcLabel = std::string("_") + IntToHex(stcLabelW, 8);
-			stcLine = stcLabel + "\n";
-			assembleStc(stcLine.c_str());
+			assembleStc(stcMark(stcLabel));
 			stcStack.push(stcLabelW);
 			stcLabelW++;
 
@@ -452,8 +567,7 @@ int asmStructure(int size, char *label, char *arg, int *errorPtr) {
 					//           .B/W/L        op3      <cc>      op4       DO       DO.?      label
 					outCmpBcc(&token[n + 2], tokenEnd, stcLabel, error);
 					NEWERROR(*errorPtr, error);
-					stcLine = stcLabel2 + "\n";
-					assembleStc(stcLine.c_str());
+					assembleStc(stcMark(stcLabel2));
 				} else if (!(strcmp(token[n + 3], "OR"))) { // WHILE ea <cc> ea OR
 					stcLabel2 = stcLabel;
 					stcLabelW++;
@@ -461,8 +575,7 @@ int asmStructure(int size, char *label, char *arg, int *errorPtr) {
 					//           .B/W/L        op3      <cc>      op4       DO       DO.?      label
 					outCmpBcc(&token[n + 4], tokenEnd, stcLabel, error);
 					NEWERROR(*errorPtr, error);
-					stcLine = stcLabel2 + "\n";
-					assembleStc(stcLine.c_str());
+					assembleStc(stcMark(stcLabel2));
 				} else if (!(strcmp(token[n + 1], "AND"))) { // WHILE <cc> AND
 					//           .B/W/L       op3       <cc>      op4       DO       DO.?      label
 					outCmpBcc(&token[n + 2], tokenEnd, stcLabel, error);
@@ -474,6 +587,7 @@ int asmStructure(int size, char *label, char *arg, int *errorPtr) {
 				}
 			}
 
+			whileStack.push(std::vector<stcInst>()); // test at the top
 			stcStack.push(stcLabelW);
 			stcLabelW++;
 			skipList = true;          // don't display this line in ASSEMBLE.CPP
@@ -487,18 +601,23 @@ int asmStructure(int size, char *label, char *arg, int *errorPtr) {
 				NEWERROR(*errorPtr, NO_WHILE);
 			unsigned int whileLbl = stcStack.top();
 			stcStack.pop();
-			stcLine = "\tBRA\t_" + IntToHex(whileLbl, 8) + "\n";
-			assembleStc(stcLine.c_str());
-			stcLine = "_" + IntToHex(endwLbl, 8) + "\n";
-			assembleStc(stcLine.c_str());
+			stcTest.clear();
+			if (!whileStack.empty()) {
+				stcTest = whileStack.top();
+				whileStack.pop();
+			}
+			if (stcTest.empty())                // test at the top
+				chainBranch("\t", "_" + IntToHex(whileLbl, 8));
+			for (size_t p = 0; p < stcTest.size(); p++)
+				assembleStc(stcTest[p]);          // test at the bottom
+			assembleStc(stcMark("_" + IntToHex(endwLbl, 8)));
 			skipList = true;          // don't display this line in ASSEMBLE.CPP
 		}
 
 		// -------------------- REPEAT --------------------
 		if (!(strcmp(token[1], "REPEAT"))) {
 			stcLabel = "_" + IntToHex(stcLabelR, 8);
-			stcLine = stcLabel + "\n";
-			assembleStc(stcLine.c_str());
+			assembleStc(stcMark(stcLabel));
 			stcStack.push(stcLabelR);
 			stcLabelR++;
 			skipList = true;          // don't display this line in ASSEMBLE.CPP
@@ -529,8 +648,7 @@ int asmStructure(int size, char *label, char *arg, int *errorPtr) {
 				NEWERROR(*errorPtr, error);
 				//           .B/W/L       op3      <cc>      op4       DO         DO.?     label
 				outCmpBcc(&token[n + 2], tokenEnd, stcLabel2, error);
-				stcLine = stcLabel + "\n";   // output label for first OR branch
-				assembleStc(stcLine.c_str());
+				assembleStc(stcMark(stcLabel)); // output label for first OR branch
 				stcLabelR++;
 				NEWERROR(*errorPtr, error);
 
@@ -540,8 +658,7 @@ int asmStructure(int size, char *label, char *arg, int *errorPtr) {
 				NEWERROR(*errorPtr, error);
 				//           .B/W/L       op3      <cc>      op4       DO         DO.?     label
 				outCmpBcc(&token[n + 4], tokenEnd, stcLabel2, error);
-				stcLine = stcLabel + "\n";   // output label for first OR branch
-				assembleStc(stcLine.c_str());
+				assembleStc(stcMark(stcLabel)); // output label for first OR branch
 				stcLabelR++;
 				NEWERROR(*errorPtr, error);
 
@@ -565,7 +682,60 @@ int asmStructure(int size, char *label, char *arg, int *errorPtr) {
 
 		// -------------------- FOR --------------------
 		// FOR[.<size>] op1 = op2 TO op3 [BY op4] DO
-		if (!(strcmp(token[1], "FOR"))) {
+		// With OPT LOOP, FOR[.W] Dn = op2 DOWNTO #0 [BY #1] DO uses DBRA:
+		//   MOVE.W op2,Dn  BMI _20000001  _40000000 body DBRA Dn,_40000000  _20000001
+		// The BMI is left out when op2 is a positive constant.
+		if (!(strcmp(token[1], "FOR")) && unrollFor(token, n, errorPtr)) {
+			skipList = true;          // don't display this line in ASSEMBLE.CPP
+		} else if (!(strcmp(token[1], "FOR")) && LOOPflag && stcDbra(token, n)) {
+			tokenEnd[0] = '\0';
+			for (i = 3; i <= LAST_TOKEN; i++) {
+				if (!(strcmp(token[i], "DO"))) {   // find DO
+					strncpy(tokenEnd, token[i + 1], 3); // copy branch distance to tokenEnd
+					break;
+				}
+			}
+			if (i > LAST_TOKEN)                   // if DO not found
+				NEWERROR(*errorPtr, DO_EXPECTED);
+			if (tokenEnd[0] == '.') {
+				if (tokenEnd[1] == 'S')
+					extent = ".S\t";
+				else if (tokenEnd[1] == 'L')
+					extent = ".L\t";
+				else {
+					NEWERROR(*errorPtr, SYNTAX);
+				}
+			} else {
+				extent = "\t";
+			}
+
+			if ((strcmp(token[n + 2], token[n]))) // if op1 != op2
+				inst = stcOp("MOVE", ".W\t", token[n + 2], token[n]);
+			else
+				inst = stcOp("TST", ".W\t", token[n]);
+			stcLabelF++;
+			stcLabel2 = "_" + IntToHex(stcLabelF, 8);
+			if (stcPositive(token[n + 2])) {
+				assembleStc(inst);                //   MOVE.W #n,Dn
+			} else {
+				assembleStc(inst);                //   MOVE.W op2,Dn  or  TST.W Dn
+				assembleStc(stcOp("BMI", extent, stcLabel2)); //   BMI _20000001
+			}
+			stcStack.push(stcLabelF);           // push _20000001
+
+			stcLabel = "_" + IntToHex(stcLabelD, 8);
+			stcLabelD++;
+			assembleStc(stcMark(stcLabel));       // _40000000
+			if (unrollCount(token, n, trip))
+				hotTrips(trip);                   // OPT HOT trips of the loop
+
+			forStack.push(stcInst());           // no Bcc
+			forStack.push(stcInst());           // no CMP
+			forStack.push(stcOp("DBRA", "\t", token[n], stcLabel)); // push DBRA Dn,_40000000
+
+			stcLabelF++;                       // ready for next For instruction
+			skipList = true;          // don't display this line in ASSEMBLE.CPP
+		} else if (!(strcmp(token[1], "FOR"))) {
 
 			// determine size of extent if present
 			tokenEnd[0] = '\0';
@@ -603,42 +773,36 @@ int asmStructure(int size, char *label, char *arg, int *errorPtr) {
 			} else
 				sizeStr = ".W\t";
 
-			stcLine = "\tMOVE" + sizeStr + (std::string) token[n + 2] + ","
-					+ (std::string) token[n] + "\n";
 			if ((strcmp(token[n + 2], token[n]))) // if op1 != op2 (FOR D1 = D1 TO ... skips move)
-				assembleStc(stcLine.c_str());     // MOVE op2,op1
+				assembleStc(stcOp("MOVE", sizeStr, token[n + 2], token[n])); // MOVE op2,op1
 
 			stcLabel = "_" + IntToHex(stcLabelF, 8);
 			stcLabelF++;
 			stcLabel2 = "_" + IntToHex(stcLabelF, 8);
-			stcLine = "\tBRA" + extent + stcLabel2 + "\n";
-			assembleStc(stcLine.c_str());       //   BRA _20000001
+			chainBranch(extent, stcLabel2);     //   BRA _20000001
 			stcStack.push(stcLabelF);           // push _20000001
 
-			stcLine = stcLabel + "\n";
-			assembleStc(stcLine.c_str());       // _20000000
+			assembleStc(stcMark(stcLabel));       // _20000000
+			if (unrollCount(token, n, trip))
+				hotTrips(trip);                   // OPT HOT trips of the loop
 
 			if (!(strcmp(token[n + 3], "DOWNTO")))
-				stcLine = "\tBGE" + extent + stcLabel + "\n";
+				forStack.push(stcOp("BGE", extent, stcLabel)); // push Bcc _20000000
 			else
-				stcLine = "\tBLE" + extent + stcLabel + "\n";
-			forStack.push(stcLine);             // push Bcc _20000000
+				forStack.push(stcOp("BLE", extent, stcLabel));
 
-			stcLine = "\tCMP" + sizeStr + token[n + 4] + "," + token[n] + "\n";
-			forStack.push(stcLine);             // push CMP instruction
+			forStack.push(stcOp("CMP", sizeStr, token[n + 4], token[n])); // push CMP instruction
 
 			if (!(strcmp(token[n + 5], "BY")))
 				if (!(strcmp(token[n + 3], "DOWNTO")))
-					stcLine = "\tSUB" + sizeStr + token[n + 6] + "," + token[n]
-							+ "\n";
+					inst = stcOp("SUB", sizeStr, token[n + 6], token[n]);
 				else
-					stcLine = "\tADD" + sizeStr + token[n + 6] + "," + token[n]
-							+ "\n";
+					inst = stcOp("ADD", sizeStr, token[n + 6], token[n]);
 			else if (!(strcmp(token[n + 3], "DOWNTO")))
-				stcLine = "\tSUB" + sizeStr + "#1," + token[n] + "\n";
+				inst = stcOp("SUB", sizeStr, "#1", token[n]);
 			else
-				stcLine = "\tADD" + sizeStr + "#1," + token[n] + "\n";
-			forStack.push(stcLine);             // push SUB/ADD instruction
+				inst = stcOp("ADD", sizeStr, "#1", token[n]);
+			forStack.push(inst);                // push SUB/ADD instruction
 
 			stcLabelF++;                       // ready for next For instruction
 			skipList = true;          // don't display this line in ASSEMBLE.CPP
@@ -651,24 +815,36 @@ int asmStructure(int size, char *label, char *arg, int *errorPtr) {
 			if ((endfLbl & stcMask) != stcMaskF)  // if label is not from a FOR
 				NEWERROR(*errorPtr, NO_FOR);
 			else {
-				stcLine = forStack.top();
-				assembleStc(stcLine.c_str()); //   ADD|SUB op4,op1  or  ADD|SUB #1,op1
+				assembleStc(forStack.top()); //   ADD|SUB op4,op1  or  ADD|SUB #1,op1  or  DBRA
 				forStack.pop();
 
-				stcLine = "_" + IntToHex(endfLbl, 8) + "\n";
-				assembleStc(stcLine.c_str());       // _20000001
+				assembleStc(stcMark("_" + IntToHex(endfLbl, 8)));       // _20000001
 
-				stcLine = forStack.top();
-				assembleStc(stcLine.c_str());       //   CMP op3,op1
+				if (!forStack.top().mnemonic.empty())
+					assembleStc(forStack.top());      //   CMP op3,op1
 				forStack.pop();
 
-				stcLine = forStack.top();
-				assembleStc(stcLine.c_str());       //   BLT .2  or  BGT .2
+				if (!forStack.top().mnemonic.empty())
+					assembleStc(forStack.top());      //   BLT .2  or  BGT .2
 				forStack.pop();
 			}
 			skipList = true;          // don't display this line in ASSEMBLE.CPP
 		}
 
+		// -------------------- UNROLL --------------------
+		// UNROLL symbol = op1 TO|DOWNTO op2 [BY op3]
+		if (!(strcmp(token[1], "UNROLL"))) {
+			unrollBlock(token, n, errorPtr);
+			skipList = true;          // don't display this line in ASSEMBLE.CPP
+		}
+
+		// -------------------- ENDU --------------------
+		// the lines up to ENDU are read by unrollBlock()
+		if (!(strcmp(token[1], "ENDU"))) {
+			NEWERROR(*errorPtr, NO_UNROLL);
+			skipList = true;          // don't display this line in ASSEMBLE.CPP
+		}
+
 		// -------------------- DBLOOP --------------------
 		// DBLOOP op1 = op2
 		if (!(strcmp(token[1], "DBLOOP"))) {
@@ -677,13 +853,10 @@ int asmStructure(int size, char *label, char *arg, int *errorPtr) {
 			if (token[2][1] < '0' || token[2][1] > '9' || token[3][0] != '=')
 				NEWERROR(*errorPtr, SYNTAX);      // syntax must be DBLOOP Dn =
 			dbStack.push(token[2][1]);          // push Dn number
-			stcLine = std::string("\tMOVE\t") + token[4] + std::string(",")
-					+ token[2] + std::string("\n");
 			if ((strcmp(token[2], token[4]))) // if op1 != op2 (DBLOOP D0 = D0 ... skips move)
-				assembleStc(stcLine.c_str());     //   MOVE op2,op1
+				assembleStc(stcOp("MOVE", "\t", token[4], token[2])); //   MOVE op2,op1
 			stcLabel = "_" + IntToHex(stcLabelD, 8);
-			stcLine = stcLabel + "\n";
-			assembleStc(stcLine.c_str());
+			assembleStc(stcMark(stcLabel));
 			stcStack.push(stcLabelD);
 			stcLabelD++;
 			skipList = true;          // don't display this line in ASSEMBLE.CPP
@@ -696,14 +869,13 @@ int asmStructure(int size, char *label, char *arg, int *errorPtr) {
 			stcStack.pop();
 			if ((unlessLbl & stcMask) != stcMaskD) // if label is not from a DBLOOP
 				NEWERROR(*errorPtr, NO_DBLOOP);
-			stcLabel = std::string("\tD") + dbStack.top() + std::string(",_")
-					+ IntToHex(unlessLbl, 8);
+			stcLabel2 = std::string("D") + dbStack.top();   // counter
+			stcLabel = std::string("_") + IntToHex(unlessLbl, 8);
 			dbStack.pop();
 
 			// UNLESS <F> and UNLESS use DBRA
 			if (!(strcmp(token[n], "<F>")) || token[2][0] == '\0') {
-				stcLine = "\tDBRA" + stcLabel + "\n";
-				assembleStc(stcLine.c_str());
+				assembleStc(stcOp("DBRA", "\t", stcLabel2, stcLabel));
 			} else {
 				// determine size of CMP
 				if (token[2][0] == '.') {
@@ -719,41 +891,28 @@ int asmStructure(int size, char *label, char *arg, int *errorPtr) {
 					sizeStr = ".W\t";
 
 				if (token[n][0] == '<') {                      // UNLESS <cc>
-					stcLine = "\tD" + getBcc(token[n], IF_CC, 0) + stcLabel
-							+ "\n";
-					assembleStc(stcLine.c_str());
+					assembleStc(stcOp("D" + getBcc(token[n], IF_CC, 0), "\t",
+							stcLabel2, stcLabel));
 				} else if (token[n][0] == '#') {           // UNLESS #nn <cc> ea
-					stcLine = "\tCMP" + sizeStr + (std::string) token[n] + ","
-							+ (std::string) token[n + 2] + "\n";
-					assembleStc(stcLine.c_str());
-					stcLine = "\tD" + getBcc(token[n + 1], IM_EA, 0) + stcLabel
-							+ "\n";
-					assembleStc(stcLine.c_str());
+					assembleStc(stcOp("CMP", sizeStr, token[n], token[n + 2]));
+					assembleStc(stcOp("D" + getBcc(token[n + 1], IM_EA, 0), "\t",
+							stcLabel2, stcLabel));
 				} else if (token[n + 2][0] == '#') {       // UNLESS ea <cc> #nn
-					stcLine = "\tCMP" + sizeStr + (std::string) token[n + 2]
-							+ "," + token[n] + "\n";
-					assembleStc(stcLine.c_str());
-					stcLine = "\tD" + getBcc(token[n + 1], EA_IM, 0) + stcLabel
-							+ "\n";
-					assembleStc(stcLine.c_str());
+					assembleStc(stcOp("CMP", sizeStr, token[n + 2], token[n]));
+					assembleStc(stcOp("D" + getBcc(token[n + 1], EA_IM, 0), "\t",
+							stcLabel2, stcLabel));
 					// UNLESS Rn <cc> ea
 				} else if ((token[n][0] == 'A' || token[n][0] == 'D')
 						&& isRegNum(token[n][1])) {
-					stcLine = "\tCMP" + sizeStr + (std::string) token[n + 2]
-							+ "," + token[n] + "\n";
-					assembleStc(stcLine.c_str());
-					stcLine = "\tD" + getBcc(token[n + 1], RN_EA, 0) + stcLabel
-							+ "\n";
-					assembleStc(stcLine.c_str());
+					assembleStc(stcOp("CMP", sizeStr, token[n + 2], token[n]));
+					assembleStc(stcOp("D" + getBcc(token[n + 1], RN_EA, 0), "\t",
+							stcLabel2, stcLabel));
 					// UNLESS ea <cc> Rn
 				} else if ((token[n + 2][0] == 'A' || token[n + 2][0] == 'D')
 						&& isRegNum(token[n + 2][1])) {
-					stcLine = "\tCMP" + sizeStr + (std::string) token[n] + ","
-							+ (std::string) token[n + 2] + "\n";
-					assembleStc(stcLine.c_str());
-					stcLine = "\tD" + getBcc(token[n + 1], EA_RN, 0) + stcLabel
-							+ "\n";
-					assembleStc(stcLine.c_str());
+					assembleStc(stcOp("CMP", sizeStr, token[n], token[n + 2]));
+					assembleStc(stcOp("D" + getBcc(token[n + 1], EA_RN, 0), "\t",
+							stcLabel2, stcLabel));
 				} else {
 					NEWERROR(*errorPtr, SYNTAX);
 				}
@@ -767,20 +926,126 @@ int asmStructure(int size, char *label, char *arg, int *errorPtr) {
 }
 
 
-void assembleStc(const char *line) {
-	// TODO fix, right now, just copy to temp line
-	char xline[256];
-	strncpy(&xline[0], line, strlen(line));
+//-------------------------------------------------------
+// Returns the instruction table entry of a mnemonic of structured code,
+// or NULL
+static instruction* stcTable(const std::string &mnemonic) {
+	static std::map<std::string, instruction*> table;
+
+	if (table.empty())
+		for (int i = 0; i < opcodeCount; i++)
+			table[opcodeTable[i].mnemonic] = &opcodeTable[i];
+	std::map<std::string, instruction*>::iterator it = table.find(mnemonic);
+	return ((it == table.end()) ? NULL : it->second);
+}
+
+// Returns the size of a size code ".B\t", or 0 if there is none
+static char stcSize(const std::string &size) {
+	if (size[0] != '.')
+		return (0);
+	if (size[1] == 'B')
+		return (BYTE_SIZE);
+	if (size[1] == 'L')
+		return (LONG_SIZE);
+	if (size[1] == 'S')
+		return (SHORT_SIZE);
+	return (WORD_SIZE);
+}
+
+// parse an operand of structured code
+static int stcOperand(const std::string &text, opDescriptor *d,
+		int *errorPtr) {
+	char operand[LINE_LENGTH];
+	char field[LINE_LENGTH];
+	char *p;
+
+	strncpy(field, (text + "\n").c_str(), LINE_LENGTH - 1); // ends like a line
+	field[LINE_LENGTH - 1] = '\0';
+	strcap(operand, field);              // structured labels are _0x...
+	p = opParse(operand, d, errorPtr);
+	if (*errorPtr <= SEVERE && *skipSpace(p))
+		NEWERROR(*errorPtr, SYNTAX);
+	return (NORMAL);
+}
+
+//-------------------------------------------------------
+// build one line of structured code. A label is defined, an instruction
+// is built with instBuild() from its instruction table entry and its
+// operands, without a source line to look them up in. text is the line
+// as it is listed, which the code cache checks the instruction by.
+static int stcBuild(const stcInst &inst, char *text, int *errorPtr) {
+	instruction *tablePtr;
+	opDescriptor source = { };
+	opDescriptor dest = { };
+	char label[SIGCHARS + 1];
+
+	label[0] = '\0';
+	if (!inst.label.empty()) {           // _0X10000000
+		strncpy(label, inst.label.c_str(), SIGCHARS);
+		label[SIGCHARS] = '\0';
+		for (int i = 0; label[i]; i++)
+			label[i] = toupper(label[i]);
+		define(label, loc, pass2, true, errorPtr);
+		return (NORMAL);
+	}
+	tablePtr = stcTable(inst.mnemonic);
+	if (!tablePtr) {                      // B?? from an unknown <cc>
+		NEWERROR(*errorPtr, SYNTAX);
+		return (NORMAL);
+	}
+	if (instStart(label, text, errorPtr))
+		return (NORMAL);
+	stcOperand(inst.source, &source, errorPtr);
+	if (*errorPtr > SEVERE)
+		return (NORMAL);
+	if (inst.dest.empty())
+		return (instBuild(tablePtr, stcSize(inst.size), &source, NULL,
+				errorPtr));
+	stcOperand(inst.dest, &dest, errorPtr);
+	if (*errorPtr > SEVERE)
+		return (NORMAL);
+	return (instBuild(tablePtr, stcSize(inst.size), &source, &dest, errorPtr));
+}
+
+//-------------------------------------------------------
+// assemble a line of structured code and list it with OPT SEX
+void assembleStc(const stcInst &inst) {
+	char stcLine[LINE_LENGTH];      // the line as it is listed
+	std::string text;
 	int error = OK;
 	int i = 0;
+
+	if (inst.label.empty()) {
+		text = "\t" + inst.mnemonic + inst.size + inst.source;
+		if (!inst.dest.empty())
+			text += "," + inst.dest;
+	} else
+		text = inst.label;
+	strncpy(stcLine, (text + "\n").c_str(), LINE_LENGTH - 1);
+	stcLine[LINE_LENGTH - 1] = '\0';
 	while (lineIdent[i] && i < MACRO_NEST_LIMIT)
 		i++;
 	lineIdent[i] = 's';     // line identifier for listing
 	lineIdent[i + 1] = '\0';
+	cycleLine();                    // OPT CYCLES times the generated line
+	adviseLine();                   // OPT ADVISE on the line above
 	if (!SEXflag)
 		skipList = true;
 	else if (!(macroNestLevel > 0 && skipList == true)) // if not called from macro with listing off
 		skipList = false;
-	assemble(xline, &error);
+	if (pass2 && listFlag)
+		listLoc();
+	stcBuild(inst, stcLine, &error);
+
+	// display and list errors and the generated line
+	if (pass2) {
+		if (error > MINOR)
+			errorCount++;
+		else if (error > WARNING)
+			warningCount++;
+		printError(listFile, error, lineNum);
+		if ((listFlag && !skipList) || error > WARNING)
+			listLine(stcLine, lineIdent);
+	}
 	lineIdent[i] = '\0';
 }
@@ -19,6 +19,10 @@
 #include "../include/asm.h"
 #include "../include/symbol.h"
 #include "../include/error.h"
+#include "../include/chain.h"
+#include "../include/cycles.h"
+#include "../include/depend.h"
+#include "../include/relax.h"
 
 extern FILE *listFile;
 extern char buffer[256];  //ck used to form messages for display in windows
@@ -31,6 +35,7 @@ extern char globalLabel[SIGCHARS + 1];
 
 symbolDef *htable[MAXHASH + 1];
 bool symbolInit = false;
+unsigned int symbolGeneration;  // changes when the symbol table is cleared
 
 //---------------------------------------------------
 // delete the symbol table memory
@@ -51,6 +56,7 @@ void clearSymbols() {
 			}
 		}
 		symbolInit = false;
+		symbolGeneration++;           // symbols kept by eval() are gone
 	} catch (...) {
 		sprintf(buffer,
 				"ERROR: An exception occurred in routine 'clearSymbols'. \n");
@@ -242,6 +248,8 @@ symbolDef* define(char *sym, int value, bool pass2, bool check, int *errorPtr) {
 			strncpy(globalLabel, sym, SIGCHARS); // set globalLabel for future use
 
 		if (pass2) {
+			depDefine(sym);                 // record definition for this line
+			cycleLabel(sym, value);         // OPT CYCLES subtotal
 			if (check) {      // if check for phase error
 				if (symbol->value != value) {
 					if (symbol->flags & BACKREF)  // if symbol already defined
@@ -256,6 +264,8 @@ symbolDef* define(char *sym, int value, bool pass2, bool check, int *errorPtr) {
 		} else {  // define the symbol
 			symbol->value = value;
 			symbol->flags = 0;
+			relaxDefine(sym, value);        // value for the next pass 1
+			chainDefine(sym, value);        // structured label before a BRA
 		}
 	}
 	return (symbol);
@@ -0,0 +1,871 @@
+/***********************************************************************
+ *
+ *		UNROLL.CPP
+ *		Loop Unrolling for Structured Code
+ *
+ *    Function: unrollFor()
+ *		Called by asmStructure() for FOR. With OPT UNROLL a loop
+ *		 FOR[.B|.W|.L] Dn = #a TO|DOWNTO #b [BY #s] DO[.S|.L]
+ *		whose bounds and step are known at this point is read up
+ *		to its ENDF and assembled without the test at each step:
+ *
+ *		 - If the number of steps times the instructions of the
+ *		   body is not more than unrollBudget, 64 or the n of
+ *		   OPT UNROLL=n, the loop becomes one copy of the body
+ *		   for each value of Dn, followed by MOVE #last,Dn. When Dn is only the whole source operand
+ *		   of MOVE, ADD, SUB, CMP, AND, OR, EOR, MUL or DIV of no
+ *		   larger size than the FOR, the value is put in place of
+ *		   Dn in each copy. Otherwise MOVE #value,Dn starts each
+ *		   copy.
+ *		 - Otherwise the body is repeated u times in the loop,
+ *		   with u the largest divisor of the number of steps that
+ *		   fits the budget, so the test is done once every u steps.
+ *
+ *		A body with labels, data, MOVEM or macro calls, or one
+ *		that changes Dn, is not copied. The loop is assembled as
+ *		FOR would, without the BRA to the first test since that
+ *		test is known to pass. The budget counts instructions as
+ *		their size is not known before they are assembled.
+ *		The function returns false if the FOR is left to
+ *		asmStructure().
+ *
+ *		unrollBlock()
+ *		Called by asmStructure() for
+ *		 UNROLL symbol = a TO|DOWNTO b [BY s]
+ *		 ENDU
+ *		The lines up to the matching ENDU are assembled once for
+ *		each value, with symbol SET to it. The bounds must be
+ *		known at this point.
+ *
+ *		rept(), irp(), irpc()
+ *		The REPT, IRP and IRPC directives
+ *		 REPT count
+ *		 IRP  symbol,<arg1,arg2,...>
+ *		 IRPC symbol,<text>
+ *		 ENDR
+ *		The lines up to the matching ENDR are kept in memory and
+ *		assembled count times, or once for each argument or each
+ *		character of text with the argument in place of the
+ *		word symbol. The copies are listed as macro expansions.
+ *
+ *		The body of each form is read from where the form is: the
+ *		source file, an included file, the expansion of a macro
+ *		or the body being copied by an enclosing one.
+ *
+ *		unrollRead()
+ *		Reads the next line of the source, or of the included
+ *		file, macro expansion or body being copied. Called by
+ *		macro() for the lines of a definition. unrollActive() is
+ *		true while the lines do not come from the source file.
+ *
+ *		unrollEnter(), unrollLeave()
+ *		Called by include() and asmMacro() around the lines they
+ *		assemble, so that unrollRead() reads from them.
+ *
+ ************************************************************************/
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../include/extern.h"
+#include "../include/asm.h"
+#include "../include/assemble.h"
+#include "../include/eval.h"
+#include "../include/hotpath.h"
+#include "../include/listing.h"
+#include "../include/macro.h"
+#include "../include/pipeline.h"
+#include "../include/structured.h"
+#include "../include/symbol.h"
+#include "../include/unroll.h"
+
+extern char line[LINE_LENGTH];  // Source line
+extern FILE *inFile;            // source file, or the included file
+extern bool listFlag;
+extern bool pass2;              // Flag set during second pass
+extern thread_local int loc;    // The assembler's location counter
+extern int lineNum;
+extern bool continuation;
+extern bool printCond;          // true to print condition on listing line
+extern bool skipCreateCode;     // true to skip calling createCode
+extern bool skipList;           // true to skip listing line in ASSEMBLE.CPP
+extern bool SEXflag;            // true expands structured listing
+extern bool MEXflag;            // true expands macro listing
+extern bool UNROLLflag;         // true unrolls FOR loops with constant bounds
+extern int unrollBudget;        // most instructions of an unrolled FOR
+extern char lineIdent[];        // "s" used to identify structure in listing
+extern unsigned int stcLabelF;  // structured for label number
+
+struct unrollReplay {
+	const std::vector<std::string> *body;
+	size_t next;                  // next line of body
+	const char *reg;              // Dn replaced by value, or NULL
+	long value;
+	const char *sym;              // word replaced by arg, or NULL
+	std::string arg;
+	int source;                   // UNROLL_BODY, UNROLL_MACRO or UNROLL_INCLUDE
+};
+
+const int UNROLL_BODY = 0;        // reader of a body being copied
+
+const int UNROLL_NONE = 0;        // body may not be copied
+const int UNROLL_SET = 1;         // copies need MOVE #value,Dn
+const int UNROLL_SUBST = 2;       // value may replace Dn in the copies
+
+const int UNROLL_COPIES = 65536;  // most copies made by UNROLL and REPT
+
+static std::vector<unrollReplay> unrollStack; // readers, innermost last
+static bool unrollFlag;                       // UNROLLflag at start of assembly
+static int unrollLimit;                       // unrollBudget at start of assembly
+
+// opcodes that may not be copied
+static const char *unrollData[] = { "DC", "DCB", "DS", "EQU", "SET", "REG",
+		"ORG", "SECTION", "OFFSET", "INCLUDE", "MACRO", "ENDM", "MEXIT", "END",
+		"MOVEM", NULL };
+// opcodes that only read their first operand
+static const char *unrollSource[] = { "MOVE", "MOVEA", "ADD", "ADDA", "SUB",
+		"SUBA", "CMP", "CMPA", "AND", "OR", "EOR", "MULU", "MULS", "DIVU",
+		"DIVS", NULL };
+// opcodes that only read their last operand
+static const char *unrollTest[] = { "CMP", "CMPA", "TST", "BTST", "CHK", NULL };
+// structured statements
+static const char *unrollStc[] = { "IF", "ELSE", "ENDI", "WHILE", "ENDW",
+		"REPEAT", "UNTIL", "FOR", "ENDF", "DBLOOP", "UNLESS", "UNROLL", "ENDU",
+		NULL };
+// statements that open a body
+static const char *unrollOpenFor[] = { "FOR", NULL };
+static const char *unrollOpenBlock[] = { "UNROLL", NULL };
+static const char *unrollOpenRept[] = { "REPT", "IRP", "IRPC", NULL };
+
+//------------------------------------------------------------
+// Called at the start of an assembly
+int unrollStart() {
+	unrollFlag = UNROLLflag;
+	unrollLimit = unrollBudget;
+	return (NORMAL);
+}
+
+// Called at the start of each pass
+int unrollPass() {
+	UNROLLflag = unrollFlag;
+	unrollBudget = unrollLimit;
+	unrollStack.clear();
+	return (NORMAL);
+}
+
+// true if opcode is in list
+static bool unrollIs(const std::string &opcode, const char *list[]) {
+	for (int i = 0; list[i]; i++)
+		if (opcode == list[i])
+			return (true);
+	return (false);
+}
+
+// Bytes of size code c, more than a long for anything else
+static int unrollBytes(char c) {
+	return ((c == 'B') ? 1 : (c == 'W') ? 2 : (c == 'L') ? 4 : 8);
+}
+
+// Immediate operand of value with size code c
+static std::string unrollImm(long value, char c) {
+	char text[16];
+
+	if (c == 'B')
+		value &= 0xFF;
+	else if (c == 'W')
+		value &= 0xFFFF;
+	sprintf(text, "#$%lX", value & 0xFFFFFFFFL);
+	return (text);
+}
+
+// Value of op sign extended from size code c. A # is required if
+// immediate is true. Returns OK or the reason there is no value.
+static int unrollValue(char *op, bool immediate, char c, long &value) {
+	char *end;
+	int n = 0;
+	int error = OK;
+	bool backRef;
+
+	if (*op == '#')
+		op++;
+	else if (immediate)
+		return (SYNTAX);
+	if (!*op)
+		return (SYNTAX);
+	end = eval(op, &n, &backRef, &error);
+	if (error >= MINOR)
+		return (error);
+	if (!backRef)
+		return (INV_FORWARD_REF);
+	if (error != OK || !end || *end)
+		return (SYNTAX);
+	value = (c == 'B') ? (long) (signed char) n :
+			(c == 'W') ? (long) (short) n : (long) n;
+	return (OK);
+}
+
+// Split the operand field at p into op[0] and op[1]. Returns the number
+// of operands.
+static int unrollOperands(const char *p, std::string op[2]) {
+	int count = 0;
+	int paren = 0;
+	bool quoted = false;
+
+	op[0] = op[1] = "";
+	while (*p && (!isspace(*p) || paren || quoted)) {
+		if (*p == '\'')
+			quoted = !quoted;
+		else if (!quoted && *p == '(')
+			paren++;
+		else if (!quoted && *p == ')')
+			paren--;
+		if (*p == ',' && !paren && !quoted && count == 0)
+			count = 1;
+		else
+			op[count] += *p;
+		p++;
+	}
+	return (op[0].empty() ? 0 : count + 1);
+}
+
+// true if reg appears in text as a register, such as D0 in (A0,D0.W)
+static bool unrollUses(const std::string &text, const char *reg) {
+	size_t len = strlen(reg);
+	size_t i;
+	char c;
+
+	for (i = text.find(reg); i != std::string::npos; i = text.find(reg, i + 1)) {
+		c = (i > 0) ? text[i - 1] : ' ';
+		if (isalnum(c) || c == '_' || c == '$' || c == '.' || c == '@' || c == '%')
+			continue;
+		c = (i + len < text.size()) ? text[i + len] : ' ';
+		if (!isalnum(c) && c != '_')
+			return (true);
+	}
+	return (false);
+}
+
+// Find the opcode, its size code and the operand field of text, which
+// is in all caps. Returns false for a comment or empty line.
+static bool unrollParse(const char *text, std::string &opcode, char &c,
+		const char **operands) {
+	const char *p = text;
+
+	while (*p && isspace(*p))
+		p++;
+	if (!*p || *p == '*' || *p == ';')
+		return (false);
+	opcode = "";
+	c = 'W';
+	while (*p && !isspace(*p) && *p != '.')
+		opcode += *p++;
+	if (*p == '.') {
+		c = *++p;
+		while (*p && !isspace(*p))
+			p++;
+	}
+	while (*p && isspace(*p))
+		p++;
+	*operands = p;
+	return (true);
+}
+
+// How a line of the body of FOR reg with size code c may be copied.
+// count is incremented for an instruction.
+static int unrollCheck(const std::string &text, const char *reg, char c,
+		int &count) {
+	char src[LINE_LENGTH];
+	char capText[LINE_LENGTH];
+	char name[SIGCHARS + 1];
+	std::string opcode;
+	std::string op[2];
+	const char *operands;
+	char opSize;
+	symbolDef *symbol;
+	int error = OK;
+	int kind;
+	int n;
+
+	strncpy(src, text.c_str(), LINE_LENGTH - 1);
+	src[LINE_LENGTH - 1] = '\0';
+	strcap(capText, src);
+	if (*capText && !isspace(*capText) && *capText != '*' && *capText != ';')
+		return (UNROLL_NONE);         // label
+	if (!unrollParse(capText, opcode, opSize, &operands))
+		return (UNROLL_SUBST);
+	count++;
+	if (unrollIs(opcode, unrollStc))
+		return (unrollUses(operands, reg) ? UNROLL_NONE : UNROLL_SUBST);
+	if (unrollIs(opcode, unrollData))
+		return (UNROLL_NONE);
+	strncpy(name, opcode.c_str(), SIGCHARS);
+	name[SIGCHARS] = '\0';
+	symbol = lookup(name, false, &error);
+	if (error < ERRORN && symbol && (symbol->flags & MACRO_SYM))
+		return (UNROLL_NONE);         // macro call
+
+	// the copies must set Dn if the code may leave the loop
+	if ((opcode[0] == 'B' && opcode.size() == 3) || opcode == "JMP"
+			|| opcode == "JSR" || opcode == "TRAP" || opcode == "TRAPV"
+			|| opcode == "RTS" || opcode == "RTE" || opcode == "RTR")
+		kind = UNROLL_SET;
+	else
+		kind = UNROLL_SUBST;
+
+	n = unrollOperands(operands, op);
+	if (n >= 1 && op[0] == reg) {
+		if (n == 2 && unrollIs(opcode, unrollSource)
+				&& unrollBytes(opSize) <= unrollBytes(c))
+			;                           // value may replace Dn
+		else if (n == 2 && opcode != "EXG"
+				&& !(opcode[0] == 'D' && opcode[1] == 'B' && opcode.size() == 4))
+			kind = UNROLL_SET;          // read as a count or bit number
+		else if (n == 1 && opcode == "TST")
+			kind = UNROLL_SET;
+		else
+			return (UNROLL_NONE);       // Dn changed
+	} else if (n >= 1 && unrollUses(op[0], reg))
+		kind = UNROLL_SET;            // index register
+	if (n == 2 && op[1] == reg) {
+		if (!unrollIs(opcode, unrollTest))
+			return (UNROLL_NONE);       // Dn changed
+		kind = UNROLL_SET;
+	} else if (n == 2 && unrollUses(op[1], reg))
+		kind = UNROLL_SET;
+	return (kind);
+}
+
+// text with value in place of the first operand if it is reg
+static std::string unrollSubst(const std::string &text, const char *reg,
+		long value) {
+	char src[LINE_LENGTH];
+	char capText[LINE_LENGTH];
+	std::string opcode;
+	std::string op[2];
+	const char *operands;
+	char opSize;
+	size_t at;
+
+	strncpy(src, text.c_str(), LINE_LENGTH - 1);
+	src[LINE_LENGTH - 1] = '\0';
+	strcap(capText, src);
+	if (!unrollParse(capText, opcode, opSize, &operands)
+			|| unrollIs(opcode, unrollStc)
+			|| unrollOperands(operands, op) != 2 || op[0] != reg)
+		return (text);
+	at = operands - capText;
+	return (text.substr(0, at) + unrollImm(value, opSize)
+			+ text.substr(at + op[0].size()));
+}
+
+// text with arg in place of the word sym, which is in all caps
+static std::string unrollArg(const std::string &text, const char *sym,
+		const std::string &arg) {
+	std::string copy;
+	size_t len = strlen(sym);
+	size_t i = 0;
+	size_t j;
+	char c;
+
+	while (i < text.size()) {
+		for (j = 0; j < len && toupper(text[i + j]) == sym[j]; j++)
+			;
+		if (j == len
+				&& (i == 0 || !(isalnum(c = text[i - 1]) || c == '_' || c == '$'
+						|| c == '.'))
+				&& !(isalnum(c = text[i + len]) || c == '_' || c == '$')) {
+			copy += arg;
+			i += len;
+		} else
+			copy += text[i++];
+	}
+	return (copy);
+}
+
+//------------------------------------------------------------
+// Read the next line of the source, or of the included file, macro
+// expansion or body being copied
+bool unrollRead(char *text) {
+	if (unrollStack.empty()) {
+		if (!pipeRead(text))
+			return (false);
+		lineNum++;
+		return (true);
+	}
+	unrollReplay &r = unrollStack.back();
+	if (r.source == UNROLL_MACRO)
+		return (macroRead(text));
+	if (r.source == UNROLL_INCLUDE) {
+		if (!fgets(text, 256, inFile))
+			return (false);
+		lineNum++;
+		return (true);
+	}
+	if (r.next >= r.body->size())
+		return (false);
+	std::string copy = (*r.body)[r.next++];
+	if (r.reg)
+		copy = unrollSubst(copy, r.reg, r.value);
+	if (r.sym)
+		copy = unrollArg(copy, r.sym, r.arg);
+	strncpy(text, copy.c_str(), LINE_LENGTH - 1);
+	text[LINE_LENGTH - 1] = '\0';
+	return (true);
+}
+
+// true while unrollRead() does not read the source file
+bool unrollActive() {
+	return (!unrollStack.empty());
+}
+
+// Read the lines of an included file or a macro expansion from here on
+int unrollEnter(int source) {
+	unrollStack.push_back( { NULL, 0, NULL, 0, NULL, "", source });
+	return (NORMAL);
+}
+
+// Called at the end of the lines given to unrollEnter()
+int unrollLeave() {
+	unrollStack.pop_back();
+	return (NORMAL);
+}
+
+// Read the lines up to the close statement that matches a statement of
+// open into body. Returns false if there is none.
+static bool unrollCapture(const char *open[], const char *close,
+		std::vector<std::string> &body) {
+	char text[LINE_LENGTH];
+	char capText[LINE_LENGTH];
+	char *token[MAXT];
+	char tokens[MAX_SIZE];
+	char delim[] = ". \t\n";
+	int source = unrollStack.empty() ? UNROLL_INCLUDE : unrollStack.back().source;
+	bool listing = pass2 && listFlag && (source == UNROLL_INCLUDE
+			|| (source == UNROLL_MACRO && MEXflag));
+	int nest = 0;
+
+	while (unrollRead(text)) {
+		if (listing && source == UNROLL_MACRO)
+			listLine(text, lineIdent);
+		else if (listing)
+			listLine(text);
+		strcap(capText, text);
+		tokenize(capText, delim, token, tokens);
+		if (unrollIs(token[1], open))
+			nest++;
+		else if (!(strcmp(token[1], close)) && nest-- == 0)
+			return (true);
+		body.push_back(text);
+	}
+	return (false);
+}
+
+// Assemble a line of unrolled code, listed as structured code or, with
+// ident 'm', as a macro expansion
+static void unrollAsm(const std::string &text, char ident = 's') {
+	int error = OK;
+	int i = 0;
+
+	strncpy(line, text.c_str(), LINE_LENGTH - 1);
+	line[LINE_LENGTH - 1] = '\0';
+	while (lineIdent[i] && i < MACRO_NEST_LIMIT)
+		i++;
+	lineIdent[i] = ident;           // line identifier for listing
+	lineIdent[i + 1] = '\0';
+	continuation = false;
+	printCond = false;
+	skipCreateCode = false;
+	skipList = (ident == 'm') ? !MEXflag : !SEXflag;
+	assemble(line, &error);
+	lineIdent[i] = '\0';
+}
+
+// Assemble a copy of body, with value in place of reg if reg is not NULL
+static void unrollCopy(const std::vector<std::string> &body, const char *reg,
+		long value) {
+	char text[LINE_LENGTH];
+
+	unrollStack.push_back( { &body, 0, reg, value, NULL, "", UNROLL_BODY });
+	while (unrollRead(text))
+		unrollAsm(text);
+	unrollStack.pop_back();
+}
+
+// Assemble the body of REPT count times, or of IRP and IRPC once for each
+// of args with the argument in place of sym
+static void unrollRepeat(const std::vector<std::string> &body,
+		const char *sym, const std::vector<std::string> &args, int count) {
+	char text[LINE_LENGTH];
+	char saveLine[LINE_LENGTH];
+
+	strcpy(saveLine, line);
+	if (sym)
+		count = args.size();
+	for (int i = 0; i < count; i++) {
+		unrollStack.push_back( { &body, 0, NULL, 0, sym,
+				(sym) ? args[i] : "", UNROLL_BODY });
+		while (unrollRead(text))
+			unrollAsm(text, 'm');
+		unrollStack.pop_back();
+	}
+	strcpy(line, saveLine);
+	skipList = true;                      // don't display this line twice
+}
+
+// Bounds of FOR[.<size>] op1 = #a TO|DOWNTO #b [BY #s] DO with size code
+// c. Sets first, step, down, by to the token of DO and trip to the number
+// of steps. Returns false if a bound is not known or op1 would wrap around.
+static bool unrollBounds(char *token[], int n, char c, long &first,
+		long &step, bool &down, int &by, long long &trip) {
+	long last;
+	long long after;
+	long long low;
+	long long high;
+
+	step = 1;
+	by = n + 5;                   // BY or DO
+	if (unrollBytes(c) > 4 || strcmp(token[n + 1], "="))
+		return (false);
+	down = !(strcmp(token[n + 3], "DOWNTO"));
+	if (!down && strcmp(token[n + 3], "TO"))
+		return (false);
+	if (unrollValue(token[n + 2], true, c, first) != OK
+			|| unrollValue(token[n + 4], true, c, last) != OK)
+		return (false);
+	if (!(strcmp(token[by], "BY"))) {
+		if (unrollValue(token[n + 6], true, c, step) != OK)
+			return (false);
+		by = n + 7;
+	}
+	if (strcmp(token[by], "DO") || step <= 0)
+		return (false);
+
+	// the loop must end without op1 wrapping around
+	low = (c == 'B') ? -0x80 : (c == 'W') ? -0x8000 : -0x80000000LL;
+	high = -low - 1;
+	if (down)
+		trip = (first < last) ? 0 : ((long long) first - last) / step + 1;
+	else
+		trip = (first > last) ? 0 : ((long long) last - first) / step + 1;
+	after = (down) ? first - trip * step : first + trip * step;
+	return (after >= low && after <= high);
+}
+
+//------------------------------------------------------------
+// Number of steps of a FOR with constant bounds. token[n] is op1, see
+// asmStructure(). Returns false if the count is not known.
+bool unrollCount(char *token[], int n, long long &trip) {
+	char c = 'W';
+	long first;
+	long step;
+	bool down;
+	int by;
+
+	if (token[2][0] == '.')
+		c = token[2][1];
+	return (unrollBounds(token, n, c, first, step, down, by, trip));
+}
+
+//------------------------------------------------------------
+// Unroll FOR with constant bounds. token[n] is op1, see asmStructure().
+// Returns false to assemble the FOR as usual.
+bool unrollFor(char *token[], int n, int *errorPtr) {
+	std::vector<std::string> body;
+	std::string sizeStr;
+	std::string extent;
+	std::string stcLabel;
+	char saveLine[LINE_LENGTH];
+	char reg[3];
+	char c = 'W';
+	long first;
+	long step;
+	long long trip;
+	long long after;
+	bool down;
+	int by;                       // DO
+	int kind = UNROLL_SUBST;
+	int count = 0;
+	int copies;
+
+	if (!UNROLLflag)
+		return (false);
+	if (token[2][0] == '.')
+		c = token[2][1];
+	if (token[n][0] != 'D' || !isRegNum(token[n][1]) || token[n][2] != '\0'
+			|| !unrollBounds(token, n, c, first, step, down, by, trip))
+		return (false);
+	after = (down) ? first - trip * step : first + trip * step;
+
+	strcpy(reg, token[n]);
+	strcpy(saveLine, line);
+	if (!unrollCapture(unrollOpenFor, "ENDF", body)) {
+		NEWERROR(*errorPtr, ENDF_EXPECTED);
+		return (true);
+	}
+	for (size_t i = 0; i < body.size() && kind != UNROLL_NONE; i++)
+		kind = std::min(kind, unrollCheck(body[i], reg, c, count));
+	sizeStr = std::string(".") + c + "\t";
+
+	if (trip == 0 || (kind != UNROLL_NONE
+			&& trip * (count + (kind == UNROLL_SET)) <= unrollBudget)) {
+		for (long long k = 0; k < trip; k++) {      // one copy for each value
+			long value = (down) ? first - k * step : first + k * step;
+			if (kind == UNROLL_SET)
+				unrollAsm("\tMOVE" + sizeStr + unrollImm(value, c) + "," + reg + "\n");
+			unrollCopy(body, (kind == UNROLL_SUBST) ? reg : NULL, value);
+		}
+		unrollAsm("\tMOVE" + sizeStr + unrollImm(after, c) + "," + reg + "\n");
+		strcpy(line, saveLine);
+		return (true);
+	}
+
+	copies = 1;                   // copies in the loop, a divisor of trip
+	if (kind != UNROLL_NONE)
+		for (copies = trip - 1; copies > 1; copies--)
+			if (trip % copies == 0 && copies * (count + 1) <= unrollBudget)
+				break;
+	extent = "\t";
+	if (!(strcmp(token[by + 1], ".L")) || (copies == 1 && !(strcmp(token[by + 1], ".S"))))
+		extent = std::string(token[by + 1]) + "\t";
+
+	stcLabel = "_" + IntToHex(stcLabelF, 8);
+	stcLabelF += 2;               // as many labels as FOR
+	unrollAsm("\tMOVE" + sizeStr + token[n + 2] + "," + reg + "\n");
+	unrollAsm(stcLabel + "\n");
+	hotTrips(trip / copies);      // OPT HOT trips of the loop
+	for (int k = 0; k < copies; k++) {
+		unrollCopy(body, NULL, 0);
+		unrollAsm("\t" + std::string((down) ? "SUB" : "ADD") + sizeStr
+				+ ((by == n + 7) ? token[n + 6] : "#1") + "," + reg + "\n");
+	}
+	unrollAsm("\tCMP" + sizeStr + token[n + 4] + "," + reg + "\n");
+	unrollAsm("\t" + std::string((down) ? "BGE" : "BLE") + extent + stcLabel + "\n");
+	strcpy(line, saveLine);
+	return (true);
+}
+
+//------------------------------------------------------------
+// UNROLL symbol = op1 TO|DOWNTO op2 [BY op3] ... ENDU
+// token[n] is symbol, see asmStructure()
+int unrollBlock(char *token[], int n, int *errorPtr) {
+	std::vector<std::string> body;
+	char saveLine[LINE_LENGTH];
+	long first;
+	long last;
+	long step = 1;
+	long long trip;
+	bool down;
+	int error;
+
+	if (n != 2 || !(isalpha(token[n][0]) || token[n][0] == '_')
+			|| strcmp(token[n + 1], "=")) {
+		NEWERROR(*errorPtr, SYNTAX);
+		return (NORMAL);
+	}
+	down = !(strcmp(token[n + 3], "DOWNTO"));
+	if (!down && strcmp(token[n + 3], "TO")) {
+		NEWERROR(*errorPtr, SYNTAX);
+		return (NORMAL);
+	}
+	strcpy(saveLine, line);
+	if (!unrollCapture(unrollOpenBlock, "ENDU", body)) {
+		NEWERROR(*errorPtr, ENDU_EXPECTED);
+		return (NORMAL);
+	}
+	error = unrollValue(token[n + 2], false, 'L', first);
+	if (error == OK)
+		error = unrollValue(token[n + 4], false, 'L', last);
+	if (error == OK && !(strcmp(token[n + 5], "BY")))
+		error = unrollValue(token[n + 6], false, 'L', step);
+	if (error != OK) {
+		NEWERROR(*errorPtr, error);
+		return (NORMAL);
+	}
+	if (step <= 0) {
+		NEWERROR(*errorPtr, INVALID_ARG);
+		return (NORMAL);
+	}
+	if (down)
+		trip = (first < last) ? 0 : ((long long) first - last) / step + 1;
+	else
+		trip = (first > last) ? 0 : ((long long) last - first) / step + 1;
+	if (trip > UNROLL_COPIES) {
+		NEWERROR(*errorPtr, INVALID_ARG);
+		return (NORMAL);
+	}
+
+	for (long long k = 0; k < trip; k++) {
+		unrollAsm(std::string(token[n]) + "\tSET\t"
+				+ std::to_string((down) ? first - k * step : first + k * step) + "\n");
+		unrollCopy(body, NULL, 0);
+	}
+	strcpy(line, saveLine);
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// Read the body of REPT, IRP or IRPC. The statement is listed first.
+// Returns false if there is no body.
+static bool unrollBody(char *label, std::vector<std::string> &body,
+		int *errorPtr) {
+	if (*label)                           // if label
+		define(label, loc, pass2, true, errorPtr); // define label
+	if (pass2 && listFlag && !skipList) {
+		listLoc();
+		listLine(line, lineIdent);
+	}
+	skipList = true;                      // don't display this line twice
+	if (!unrollCapture(unrollOpenRept, "ENDR", body)) {
+		NEWERROR(*errorPtr, ENDR_EXPECTED);
+		return (false);
+	}
+	return (true);
+}
+
+// Read the symbol of IRP or IRPC at *op followed by a comma into sym
+static bool unrollSymbol(char **op, char *sym) {
+	char *p = skipSpace(*op);
+	int i = 0;
+
+	if (!isalpha(*p) && *p != '_')
+		return (false);
+	while (isalnum(*p) || *p == '_' || *p == '$') {
+		if (i < SIGCHARS)
+			sym[i++] = *p;
+		p++;
+	}
+	sym[i] = '\0';
+	p = skipSpace(p);
+	if (*p != ',')
+		return (false);
+	*op = skipSpace(p + 1);
+	return (true);
+}
+
+// Read the text at *op, either <text> or up to white space
+static bool unrollText(char **op, std::string &text) {
+	char *p = *op;
+	bool quoted = false;
+
+	text = "";
+	if (*p == '<') {
+		for (p++; *p && (*p != '>' || quoted); p++) {
+			if (*p == '\'')
+				quoted = !quoted;
+			text += *p;
+		}
+		if (*p != '>')
+			return (false);
+		p++;
+	} else
+		for (; *p && (!isspace(*p) || quoted); p++) {
+			if (*p == '\'')
+				quoted = !quoted;
+			text += *p;
+		}
+	*op = p;
+	return (true);
+}
+
+//------------------------------------------------------------
+// REPT count
+int rept(int size, char *label, char *op, int *errorPtr) {
+	std::vector<std::string> body;
+	char *end;
+	int count = 0;
+	int error = OK;
+	bool backRef;
+
+	if (size)
+		NEWERROR(*errorPtr, INV_SIZE_CODE);
+	if (!unrollBody(label, body, errorPtr))
+		return (NORMAL);
+	end = eval(op, &count, &backRef, &error);
+	if (error >= MINOR) {
+		NEWERROR(*errorPtr, error);
+		return (NORMAL);
+	}
+	if (!backRef) {
+		NEWERROR(*errorPtr, INV_FORWARD_REF);
+		return (NORMAL);
+	}
+	if (!end || (*end && !isspace(*end))) {
+		NEWERROR(*errorPtr, SYNTAX);
+		return (NORMAL);
+	}
+	if (count < 0 || count > UNROLL_COPIES) {
+		NEWERROR(*errorPtr, INVALID_ARG);
+		return (NORMAL);
+	}
+	unrollRepeat(body, NULL, std::vector<std::string>(), count);
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// IRP symbol,<arg1,arg2,...>
+int irp(int size, char *label, char *op, int *errorPtr) {
+	std::vector<std::string> body;
+	std::vector<std::string> args;
+	std::string list;
+	std::string arg;
+	char sym[SIGCHARS + 1];
+	bool quoted = false;
+
+	if (size)
+		NEWERROR(*errorPtr, INV_SIZE_CODE);
+	if (!unrollBody(label, body, errorPtr))
+		return (NORMAL);
+	if (!unrollSymbol(&op, sym) || !unrollText(&op, list)) {
+		NEWERROR(*errorPtr, SYNTAX);
+		return (NORMAL);
+	}
+	for (size_t i = 0; i < list.size(); i++) {  // split at commas
+		if (list[i] == '\'')
+			quoted = !quoted;
+		if (list[i] == ',' && !quoted) {
+			args.push_back(arg);
+			arg = "";
+		} else
+			arg += list[i];
+	}
+	if (!list.empty())
+		args.push_back(arg);
+	if (args.size() > (size_t) UNROLL_COPIES) {
+		NEWERROR(*errorPtr, INVALID_ARG);
+		return (NORMAL);
+	}
+	unrollRepeat(body, sym, args, 0);
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// IRPC symbol,<text>
+int irpc(int size, char *label, char *op, int *errorPtr) {
+	std::vector<std::string> body;
+	std::vector<std::string> args;
+	std::string text;
+	char sym[SIGCHARS + 1];
+
+	if (size)
+		NEWERROR(*errorPtr, INV_SIZE_CODE);
+	if (!unrollBody(label, body, errorPtr))
+		return (NORMAL);
+	if (!unrollSymbol(&op, sym) || !unrollText(&op, text)) {
+		NEWERROR(*errorPtr, SYNTAX);
+		return (NORMAL);
+	}
+	for (size_t i = 0; i < text.size(); i++)
+		args.push_back(std::string(1, text[i]));
+	unrollRepeat(body, sym, args, 0);
+	return (NORMAL);
+}
+
+//------------------------------------------------------------
+// ENDR without REPT, IRP or IRPC
+int endr(int, char*, char*, int *errorPtr) {
+	NEWERROR(*errorPtr, NO_ENDR);
+	return (NORMAL);
+}
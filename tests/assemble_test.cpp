@@ -0,0 +1,329 @@
+// Assembles small sources with assembleFile() and compares the bytes of
+// the S-record file with the code each one must give, with every option
+// that changes the code on and off. The options that only add to the
+// listing must not change the code at all.
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "../include/asm.h"
+#include "../include/assemble.h"
+#include "../include/disasm.h"
+#include "../include/object.h"
+#include "srecord.h"
+
+extern bool listFlag;
+extern bool objFlag;
+extern bool PIPEflag;
+extern bool RELAXflag;
+extern bool EAOPTflag;
+extern bool PEEPflag;
+extern bool CHAINflag;
+extern bool LOOPflag;
+extern bool UNROLLflag;
+extern bool CYCLEflag;
+extern bool HOTflag;
+extern bool ADVISEflag;
+extern int errorCount;
+
+namespace {
+
+typedef std::vector<unsigned char> bytes;
+
+const int ORIGIN = 0x1000;      // ORG of every source
+
+// Write text to the source file name and assemble it to the S-record
+// file objName, of at least 32 chars
+bool assembleObj(const char *name, const std::string &text, char *objName) {
+	char tempName[32];
+
+	sprintf(objName, "%.26s.s68", name);
+	sprintf(tempName, "%.26s.tmp", name);
+	FILE *f = fopen(name, "w");
+	if (!f)
+		return (false);
+	fputs(text.c_str(), f);
+	fclose(f);
+
+	PIPEflag = RELAXflag = EAOPTflag = PEEPflag = CHAINflag = false;
+	LOOPflag = UNROLLflag = CYCLEflag = HOTflag = ADVISEflag = false;
+	listFlag = false;
+	objFlag = true;
+	if (initObj(objName) != NORMAL)
+		return (false);
+	assembleFile(name, tempName, name);
+	objFlag = false;
+	remove(tempName);
+	EXPECT_EQ(errorCount, 0) << text;
+	return (true);
+}
+
+// Write text to the source file name and assemble it. Returns the bytes
+// from ORIGIN up to the first address with no code.
+bytes assembleText(const char *name, const std::string &text) {
+	char objName[32];
+	bytes code;
+
+	if (!assembleObj(name, text, objName))
+		return (code);
+	std::map<int, unsigned char> memory = srecordLoad(objName);
+	for (int a = ORIGIN; memory.count(a); a++)
+		code.push_back(memory[a]);
+	remove(objName);
+	return (code);
+}
+
+// Source of the lines after ORG ORIGIN and OPT options
+std::string sourceText(const std::string &options, const std::string &source) {
+	char org[32];
+
+	sprintf(org, "\tORG\t$%X\n", ORIGIN);
+	return (org + ((options.empty()) ? "" : "\tOPT\t" + options + "\n")
+			+ "START\n" + source + "\tEND\tSTART\n");
+}
+
+// Assemble the lines of source after ORG ORIGIN and OPT options, as a
+// new file
+bytes assembleBytes(const std::string &options, const std::string &source) {
+	static int count = 0;       // a new file name for each assembly
+	char name[32];
+
+	sprintf(name, "assemble_test%d.x68", count++);
+	bytes code = assembleText(name, sourceText(options, source));
+	remove(name);
+	return (code);
+}
+
+struct optionCase {
+	const char *options;          // OPT operand, empty for none
+	bytes code;                   // code of the source with the options
+};
+
+// Assemble source with each of the options and expect its code
+void expectCode(const std::string &source, const std::vector<optionCase> &cases) {
+	for (const optionCase &c : cases)
+		EXPECT_EQ(assembleBytes(c.options, source), c.code)
+				<< "OPT " << c.options << "\n" << source;
+}
+
+// WHILE / IF THEN.S / RTS / ENDI / ENDW. OPT CHAIN must keep the BRA of
+// ENDW, as the BNE.S of the IF still goes to the label in front of it.
+TEST(Assemble, ChainKeepsBranchAfterReturn) {
+	const std::string source =
+			"\tMOVEQ\t#0,D0\n"
+			"\tWHILE.W D0 <LT> #10 DO\n"
+			"\t ADDQ.W\t#1,D0\n"
+			"\t IF.W D0 <EQ> #5 THEN.S\n"
+			"\t  RTS\n"
+			"\t ENDI\n"
+			"\tENDW\n"
+			"\tRTS\n";
+	const bytes code = {
+			0x70, 0x00,                 // MOVEQ #0,D0
+			0xB0, 0x7C, 0x00, 0x0A,     // CMP.W #10,D0
+			0x6C, 0x00, 0x00, 0x0E,     // BGE the RTS after ENDW
+			0x52, 0x40,                 // ADDQ.W #1,D0
+			0xB0, 0x7C, 0x00, 0x05,     // CMP.W #5,D0
+			0x66, 0x02,                 // BNE.S the BRA of ENDW
+			0x4E, 0x75,                 // RTS
+			0x60, 0xEC,                 // BRA the CMP of WHILE
+			0x4E, 0x75 };               // RTS
+
+	expectCode(source, { { "", code }, { "CHAIN", code }, { "NOCHAIN", code } });
+}
+
+// A BLS is assembled with its condition and disassembled as BLS
+TEST(Assemble, BranchLowOrSameDecodes) {
+	const std::string source =
+			"\tBLS.S\tLBL\n"
+			"\tNOP\n"
+			"LBL\tRTS\n";
+	const bytes code = { 0x63, 0x02, 0x4E, 0x71, 0x4E, 0x75 };
+	char text[DISASM_TEXT];
+
+	bytes out = assembleBytes("", source);
+	ASSERT_EQ(out, code);
+	EXPECT_EQ(disasmInst(out.data(), out.size(), ORIGIN, text), 2);
+	EXPECT_EQ(strncmp(text, "BLS", 3), 0) << text;
+}
+
+// (PC) is address 0 as 0(PC) is, whatever the operand before it was
+TEST(Assemble, PCRelativeWithoutDisplacement) {
+	const std::string source =
+			"\tMOVE.L\t#$1234,D0\n"
+			"\tLEA\t(PC),A0\n"
+			"\tRTS\n";
+	const bytes code = {
+			0x20, 0x3C, 0x00, 0x00, 0x12, 0x34, // MOVE.L #$1234,D0
+			0x41, 0xFA, 0xEF, 0xF8,     // LEA 0-$1008(PC),A0
+			0x4E, 0x75 };               // RTS
+
+	expectCode(source, { { "", code } });
+}
+
+// OPT RELAX shortens a forward branch that was assembled as a word
+TEST(Assemble, RelaxShortensForwardBranch) {
+	const std::string source =
+			"\tBRA\tFWD\n"
+			"\tNOP\n"
+			"FWD\tRTS\n";
+
+	expectCode(source, {
+			{ "", { 0x60, 0x00, 0x00, 0x04, 0x4E, 0x71, 0x4E, 0x75 } },
+			{ "NORELAX", { 0x60, 0x00, 0x00, 0x04, 0x4E, 0x71, 0x4E, 0x75 } },
+			{ "RELAX", { 0x60, 0x02, 0x4E, 0x71, 0x4E, 0x75 } } });
+}
+
+// OPT EAOPT uses absolute short for a forward address that fits
+TEST(Assemble, EaoptPicksAbsoluteShort) {
+	const std::string source =
+			"\tMOVE.W\tVAR,D0\n"
+			"\tRTS\n"
+			"VAR\tEQU\t$2000\n";
+
+	expectCode(source, {
+			{ "", { 0x30, 0x39, 0x00, 0x00, 0x20, 0x00, 0x4E, 0x75 } },
+			{ "NOEAOPT", { 0x30, 0x39, 0x00, 0x00, 0x20, 0x00, 0x4E, 0x75 } },
+			{ "EAOPT", { 0x30, 0x38, 0x20, 0x00, 0x4E, 0x75 } } });
+}
+
+// OPT PEEP rewrites CLR.L Dn as MOVEQ #0,Dn and CMP #0 as TST
+TEST(Assemble, PeepRewritesSlowForms) {
+	const std::string source =
+			"\tCLR.L\tD1\n"
+			"\tCMP.W\t#0,D2\n"
+			"\tRTS\n";
+
+	expectCode(source, {
+			{ "", { 0x42, 0x81, 0xB4, 0x7C, 0x00, 0x00, 0x4E, 0x75 } },
+			{ "NOPEEP", { 0x42, 0x81, 0xB4, 0x7C, 0x00, 0x00, 0x4E, 0x75 } },
+			{ "PEEP", { 0x72, 0x00, 0x4A, 0x42, 0x4E, 0x75 } } });
+}
+
+// OPT LOOP tests a WHILE loop at the bottom
+TEST(Assemble, LoopTestsAtTheBottom) {
+	const std::string source =
+			"\tWHILE.W D0 <NE> #0 DO\n"
+			"\t SUBQ.W\t#1,D0\n"
+			"\tENDW\n"
+			"\tRTS\n";
+	const bytes top = {
+			0xB0, 0x7C, 0x00, 0x00,     // CMP.W #0,D0
+			0x67, 0x00, 0x00, 0x06,     // BEQ past the loop
+			0x53, 0x40,                 // SUBQ.W #1,D0
+			0x60, 0xF4,                 // BRA the CMP
+			0x4E, 0x75 };               // RTS
+	const bytes bottom = {
+			0x60, 0x00, 0x00, 0x04,     // BRA the CMP
+			0x53, 0x40,                 // SUBQ.W #1,D0
+			0xB0, 0x7C, 0x00, 0x00,     // CMP.W #0,D0
+			0x66, 0xF8,                 // BNE.S the SUBQ
+			0x4E, 0x75 };               // RTS
+
+	expectCode(source, { { "", top }, { "NOLOOP", top }, { "LOOP", bottom } });
+}
+
+// OPT UNROLL writes out a FOR loop with constant bounds, with the value
+// of the counter put in for each pass
+TEST(Assemble, UnrollWritesOutConstantLoop) {
+	const std::string source =
+			"\tFOR.W D1 = #1 TO #3 DO\n"
+			"\t ADD.W\tD1,D2\n"
+			"\tENDF\n"
+			"\tRTS\n";
+	const bytes unrolled = {
+			0x52, 0x42,                 // ADDQ.W #1,D2
+			0x54, 0x42,                 // ADDQ.W #2,D2
+			0x56, 0x42,                 // ADDQ.W #3,D2
+			0x32, 0x3C, 0x00, 0x04,     // MOVE.W #4,D1, D1 after the loop
+			0x4E, 0x75 };               // RTS
+
+	bytes loop = assembleBytes("", source);
+	EXPECT_NE(loop, unrolled);
+	EXPECT_EQ(assembleBytes("NOUNROLL", source), loop);
+	EXPECT_EQ(assembleBytes("UNROLL", source), unrolled);
+}
+
+// The options that add to the listing or change how the source is read
+// leave the code as it is
+TEST(Assemble, ListingOptionsKeepCode) {
+	const std::string source =
+			"\tMOVEQ\t#3,D0\n"
+			"LOOP\tADD.L\t#$12345,D1\n"
+			"\tMOVE.L\t#1,D2\n"
+			"\tDBRA\tD0,LOOP\n"
+			"\tJSR\tSUB\n"
+			"\tRTS\n"
+			"SUB\tMULU\t#4,D3\n"
+			"\tRTS\n";
+	bytes code = assembleBytes("", source);
+
+	ASSERT_FALSE(code.empty());
+	for (const char *options : { "CYCLES", "HOT", "ADVISE", "PIPE",
+			"CYCLES,HOT,ADVISE,PIPE" })
+		EXPECT_EQ(assembleBytes(options, source), code) << "OPT " << options;
+}
+
+// Assembling a file again re-encodes only the lines that changed and
+// the lines that depend on them, and must give the code of a full
+// assembly. A line that uses * depends on where it is.
+TEST(Assemble, ReassemblyMatchesFullAssembly) {
+	const char *name = "assemble_dep.x68";
+	const std::string before =
+			"\tMOVEQ\t#1,D1\n"
+			"\tMOVE.L\t#*,D0\n"
+			"\tJMP\t*+6\n"
+			"\tLEA\t(PC),A0\n"
+			"\tRTS\n";
+	const std::string after =
+			"\tMOVE.W\t#1,D1\n"         // 2 bytes longer
+			"\tMOVE.L\t#*,D0\n"
+			"\tJMP\t*+6\n"
+			"\tLEA\t(PC),A0\n"
+			"\tRTS\n";
+
+	bytes first = assembleText(name, sourceText("", before));
+	ASSERT_FALSE(first.empty());
+	EXPECT_EQ(assembleText(name, sourceText("", before)), first);
+	bytes grown = assembleText(name, sourceText("", after));
+	remove(name);
+	EXPECT_EQ(grown, assembleBytes("", after));
+}
+
+// disasmSRec() reads back every record of an assembled file, and
+// decodes MOVEM with its register list word
+TEST(Assemble, DisassembleObjectFile) {
+	const char *name = "assemble_srec.x68";
+	const std::string source =
+			"\tMOVEM.L\t(SP)+,D0/D3-D5/A3\n"
+			"\tNOP\n"
+			"\tMOVEM.W\tD1/A0-A2,-(SP)\n"
+			"\tNOP\n"
+			"\tRTS\n";
+	const char *text =
+			"00001000  4CDF 0839                     MOVEM.L (A7)+,D0/D3-D5/A3\n"
+			"00001004  4E71                          NOP\n"
+			"00001006  48A7 40E0                     MOVEM.W D1/A0-A2,-(A7)\n"
+			"0000100A  4E71                          NOP\n"
+			"0000100C  4E75                          RTS\n";
+	char objName[32];
+	char line[256];
+	std::string out;
+
+	ASSERT_TRUE(assembleObj(name, sourceText("", source), objName));
+	remove(name);
+	FILE *f = tmpfile();
+	ASSERT_TRUE(f != NULL);
+	EXPECT_EQ(disasmSRec(objName, f), NORMAL);
+	remove(objName);
+	rewind(f);
+	while (fgets(line, sizeof(line), f))
+		out += line;
+	fclose(f);
+	EXPECT_EQ(out, text);
+}
+
+}
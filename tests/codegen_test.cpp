@@ -0,0 +1,300 @@
+// Compares the builders of BUILD.CPP with the code they had before their
+// classes were built by encodeEA() and effAddr() took its fields from a
+// table. The builders write S-records that are read back and compared,
+// bit for bit, with the words of the reference code below.
+
+#include <cstdio>
+#include <map>
+#include <vector>
+#include "gtest/gtest.h"
+#include "../include/asm.h"
+#include "../include/build.h"
+#include "../include/codegen.h"
+#include "../include/object.h"
+#include "srecord.h"
+
+extern thread_local int loc;
+extern bool pass2;
+extern bool listFlag;
+extern bool objFlag;
+
+namespace {
+
+typedef int (*builder)(int, int, opDescriptor*, opDescriptor*, int*);
+
+const int modes[] = { DnDirect, AnDirect, AnInd, AnIndPost, AnIndPre,
+		AnIndDisp, AnIndIndex, AbsShort, AbsLong, PCDisp, PCIndex, IMMEDIATE };
+const int sizes[] = { 0, BYTE_SIZE, WORD_SIZE, LONG_SIZE };
+const int values[] = { -40000, -129, -1, 0, 1, 5, 8, 9, 200, 70000 };
+const int SPACING = 0x20;       // bytes between instructions in the S-records
+
+std::vector<unsigned char> refBytes;   // words output by the reference code
+
+int refOutput(int data, int size) {
+	for (int shift = (size - 1) * 8; shift >= 0; shift -= 8)
+		refBytes.push_back((data >> shift) & 0xFF);
+	return (NORMAL);
+}
+
+// effAddr(), extWords() and the builders before the change
+int refEffAddr(opDescriptor *operand) {
+	if (operand->mode == DnDirect)
+		return (0x00 | operand->reg);
+	if (operand->mode == AnDirect)
+		return (0x08 | operand->reg);
+	if (operand->mode == AnInd)
+		return (0x10 | operand->reg);
+	if (operand->mode == AnIndPost)
+		return (0x18 | operand->reg);
+	if (operand->mode == AnIndPre)
+		return (0x20 | operand->reg);
+	if (operand->mode == AnIndDisp)
+		return (0x28 | operand->reg);
+	if (operand->mode == AnIndIndex)
+		return (0x30 | operand->reg);
+	if (operand->mode == AbsShort)
+		return (0x38);
+	if (operand->mode == AbsLong)
+		return (0x39);
+	if (operand->mode == PCDisp)
+		return (0x3A);
+	if (operand->mode == PCIndex)
+		return (0x3B);
+	return (0x3C);
+}
+
+int refExtWords(opDescriptor *op, int size, int *errorPtr) {
+	int disp;
+
+	if (op->mode == DnDirect || op->mode == AnDirect || op->mode == AnInd
+			|| op->mode == AnIndPost || op->mode == AnIndPre)
+		;
+	else if (op->mode == AnIndDisp || op->mode == PCDisp) {
+		if (pass2) {
+			disp = op->data;
+			if (op->mode == PCDisp)
+				disp -= loc;
+			refOutput(disp & 0xFFFF, WORD_SIZE);
+			if (disp < -32768 || disp > 32767)
+				NEWERROR(*errorPtr, INV_DISP);
+		}
+		loc += 2;
+	} else if (op->mode == AnIndIndex || op->mode == PCIndex) {
+		if (pass2) {
+			disp = op->data;
+			if (op->mode == PCIndex)
+				disp -= loc;
+			refOutput((((int) (op->size) == LONG_SIZE) ? 0x800 : 0)
+					| (op->index << 12) | (disp & 0xFF), WORD_SIZE);
+			if (disp < -128 || disp > 127)
+				NEWERROR(*errorPtr, INV_DISP);
+		}
+		loc += 2;
+	} else if (op->mode == AbsShort) {
+		if (pass2) {
+			refOutput(op->data & 0xFFFF, WORD_SIZE);
+			if (op->data < -32768 || op->data > 32767)
+				NEWERROR(*errorPtr, INV_ABS_ADDRESS);
+		}
+		loc += 2;
+	} else if (op->mode == AbsLong) {
+		if (pass2)
+			refOutput(op->data, LONG_SIZE);
+		loc += 4;
+	} else if (op->mode == IMMEDIATE) {
+		if (!size || size == WORD_SIZE) {
+			if (pass2) {
+				refOutput(op->data & 0xFFFF, WORD_SIZE);
+				if (op->data < -32768 || op->data > 65535)
+					NEWERROR(*errorPtr, INV_16_BIT_DATA);
+			}
+			loc += 2;
+		} else if (size == BYTE_SIZE) {
+			if (pass2) {
+				refOutput(op->data & 0xFF, WORD_SIZE);
+				if (op->data < -128 || op->data > 255)
+					NEWERROR(*errorPtr, INV_8_BIT_DATA);
+			}
+			loc += 2;
+		} else if (size == LONG_SIZE) {
+			if (pass2)
+				refOutput(op->data, LONG_SIZE);
+			loc += 4;
+		}
+	}
+	return (NORMAL);
+}
+
+int refOneOp(int mask, int size, opDescriptor *source, opDescriptor *,
+		int *errorPtr) {
+	if (pass2)
+		refOutput(mask | refEffAddr(source), WORD_SIZE);
+	loc += 2;
+	refExtWords(source, size, errorPtr);
+	return (NORMAL);
+}
+
+int refQuickMath(int mask, int size, opDescriptor *source, opDescriptor *dest,
+		int *errorPtr) {
+	if (pass2) {
+		refOutput(mask | refEffAddr(dest) | ((source->data & 7) << 9),
+				WORD_SIZE);
+		if (source->data < 1 || source->data > 8)
+			NEWERROR(*errorPtr, INV_QUICK_CONST);
+	}
+	loc += 2;
+	refExtWords(dest, size, errorPtr);
+	return (NORMAL);
+}
+
+int refArithReg(int mask, int size, opDescriptor *source, opDescriptor *dest,
+		int *errorPtr) {
+	unsigned short type = mask & 0xF000;
+
+	if ((type == 0xD000 || type == 0x9000) && source->mode == IMMEDIATE
+			&& size != BYTE_SIZE && source->backRef && source->data >= 1
+			&& source->data <= 8 && source->size == 0)
+		return (refQuickMath(((type == 0xD000) ? 0x5000 : 0x5100)
+				| ((size == LONG_SIZE) ? 0x80 : 0x40), size, source, dest,
+				errorPtr));
+	if (pass2)
+		refOutput(mask | refEffAddr(source) | (dest->reg << 9), WORD_SIZE);
+	loc += 2;
+	refExtWords(source, size, errorPtr);
+	return (NORMAL);
+}
+
+int refArithAddr(int mask, int size, opDescriptor *source, opDescriptor *dest,
+		int *errorPtr) {
+	if (pass2)
+		refOutput(mask | refEffAddr(dest) | (source->reg << 9), WORD_SIZE);
+	loc += 2;
+	refExtWords(dest, size, errorPtr);
+	return (NORMAL);
+}
+
+int refImmedInst(int mask, int size, opDescriptor *source, opDescriptor *dest,
+		int *errorPtr) {
+	unsigned short type = mask & 0xFF00;
+
+	if ((type == 0x0600 || type == 0x0400) && source->backRef
+			&& source->data >= 1 && source->data <= 8 && source->size == 0)
+		return (refQuickMath(((type == 0x0600) ? 0x5000 : 0x5100)
+				| (mask & 0x00C0), size, source, dest, errorPtr));
+	if (pass2)
+		refOutput(mask | refEffAddr(dest), WORD_SIZE);
+	loc += 2;
+	refExtWords(source, size, errorPtr);
+	refExtWords(dest, size, errorPtr);
+	return (NORMAL);
+}
+
+int refMoveReg(int mask, int size, opDescriptor *, opDescriptor *dest,
+		int *errorPtr) {
+	if (pass2)
+		refOutput(mask | refEffAddr(dest), WORD_SIZE);
+	loc += 2;
+	refExtWords(dest, size, errorPtr);
+	return (NORMAL);
+}
+
+struct encoderClass {
+	builder exec;
+	builder ref;
+	std::vector<int> masks;
+};
+
+const encoderClass classes[] = {
+	{ oneOp, refOneOp, { 0x4200, 0x4A80, 0x4EC0 } },   // CLR.B TST.L JMP
+	{ scc, refOneOp, { 0x57C0 } },                     // SEQ
+	{ arithReg, refArithReg, { 0xD040, 0xD1C0, 0x9080, 0xB040, 0x41C0 } },
+	{ arithAddr, refArithAddr, { 0xD140, 0xB180 } },   // ADD Dn,<ea> EOR
+	{ immedInst, refImmedInst, { 0x0600, 0x0480, 0x0C40 } },
+	{ quickMath, refQuickMath, { 0x5040, 0x5180 } },
+	{ moveReg, refMoveReg, { 0x40C0 } },               // MOVE SR,<ea>
+};
+
+opDescriptor makeOp(int mode, int reg, int data, bool backRef, int size) {
+	opDescriptor op = { };
+
+	op.mode = mode;
+	op.reg = reg;
+	op.data = data;
+	op.backRef = backRef;
+	op.size = size;
+	op.index = reg ^ 9;
+	return (op);
+}
+
+// Runs every class over every pair of modes, the sizes and the values
+// shown, with the builder writing S-records and the reference code
+// writing refBytes at the same address.
+TEST(Codegen, EncodersMatchBuilders) {
+	char name[] = "codegen_test.s68";
+	std::vector<std::vector<unsigned char>> expected;
+	std::vector<int> lengths;
+	int addr = 0x1000;
+
+	ASSERT_EQ(initObj(name), NORMAL);
+	pass2 = true;
+	listFlag = false;
+	objFlag = true;
+	for (const encoderClass &c : classes)
+		for (int mask : c.masks)
+			for (int size : sizes)
+				for (int sMode : modes)
+					for (int dMode : modes)
+						for (int value : values) {
+							opDescriptor source = makeOp(sMode, 3, value, value != 9,
+									(value == 5) ? LONG_SIZE : 0);
+							opDescriptor dest = makeOp(dMode, 6, addr - value, true, 0);
+							opDescriptor refSource = source;
+							opDescriptor refDest = dest;
+							int error = OK;
+							int refError = OK;
+
+							loc = addr;
+							c.exec(mask, size, &source, &dest, &error);
+							int length = loc - addr;
+							refBytes.clear();
+							loc = addr;
+							c.ref(mask, size, &refSource, &refDest, &refError);
+							ASSERT_EQ(loc - addr, length) << "mask " << std::hex << mask;
+							ASSERT_EQ(error, refError) << "mask " << std::hex << mask;
+							expected.push_back(refBytes);
+							lengths.push_back(length);
+							addr += SPACING;
+						}
+	finishObj();
+	objFlag = false;
+
+	std::map<int, unsigned char> memory = srecordLoad(name);
+	remove(name);
+	addr = 0x1000;
+	for (size_t i = 0; i < expected.size(); i++, addr += SPACING) {
+		std::vector<unsigned char> bytes;
+		for (int a = addr; a < addr + lengths[i]; a++)
+			if (memory.count(a))
+				bytes.push_back(memory[a]);
+		ASSERT_EQ(bytes, expected[i]) << "instruction at " << std::hex << addr;
+	}
+}
+
+// effAddr() and extSize() against the reference code for every mode,
+// register and size
+TEST(Codegen, EffectiveAddressTable) {
+	for (int mode : modes)
+		for (int reg = 0; reg < 8; reg++)
+			for (int size : sizes) {
+				opDescriptor op = makeOp(mode, reg, 0, true, 0);
+				int error = OK;
+
+				EXPECT_EQ(effAddr(&op), refEffAddr(&op));
+				pass2 = false;
+				loc = 0;
+				refExtWords(&op, size, &error);
+				EXPECT_EQ(extSize(&op, size), loc) << "mode " << mode;
+			}
+}
+
+}
@@ -0,0 +1,41 @@
+#ifndef SRECORD_H_
+#define SRECORD_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+// Memory loaded by the S1, S2 and S3 records of the file name, by address
+inline std::map<int, unsigned char> srecordLoad(const char *name) {
+	std::map<int, unsigned char> memory;
+	char text[256];
+	char hex[9];
+	FILE *f = fopen(name, "r");
+	int addrLen;
+	int count;
+	int addr;
+
+	if (!f)
+		return (memory);
+	while (fgets(text, sizeof(text), f)) {
+		if (text[0] != 'S' || text[1] < '1' || text[1] > '3')
+			continue;
+		addrLen = (text[1] - '0' + 1) * 2;   // hex digits of the address
+		strncpy(hex, text + 2, 2);
+		hex[2] = '\0';
+		count = strtol(hex, NULL, 16) - addrLen / 2 - 1; // data bytes
+		strncpy(hex, text + 4, addrLen);
+		hex[addrLen] = '\0';
+		addr = strtol(hex, NULL, 16);
+		for (int i = 0; i < count; i++) {
+			strncpy(hex, text + 4 + addrLen + i * 2, 2);
+			hex[2] = '\0';
+			memory[addr + i] = (unsigned char) strtol(hex, NULL, 16);
+		}
+	}
+	fclose(f);
+	return (memory);
+}
+
+#endif